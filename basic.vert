@@ -5,7 +5,12 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+//compact meshes store positions as 0..1 across their bounding box, standard ones get offset 0 scale 1
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 position = positionOffset + positionScale * aPos;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
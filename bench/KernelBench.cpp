@@ -0,0 +1,126 @@
+// Scalar vs SSE vs AVX2 throughput of the per body physics kernels.
+// Only needs glm, build from the repo root with e.g.
+//   g++ -std=c++17 -O2 -Iheader -ILibraries/include bench/KernelBench.cpp source/PhysicsKernels.cpp -o kernel_bench
+//   cl /std:c++17 /O2 /EHsc /Iheader /ILibraries\include bench\KernelBench.cpp source\PhysicsKernels.cpp
+// usage: kernel_bench [bodyCount] [steps]
+
+#include "PhysicsKernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace PhysicsKernels;
+
+struct BenchBodies {
+    std::vector<float> posX, posY, posZ, velX, velY, velZ, forceX, forceY, forceZ, inverseMass;
+    std::vector<float> rotW, rotX, rotY, rotZ, angVelX, angVelY, angVelZ, torqueX, torqueY, torqueZ;
+    std::vector<float> invInertiaX, invInertiaY, invInertiaZ;
+    std::vector<float> invInertiaXX, invInertiaXY, invInertiaXZ, invInertiaYY, invInertiaYZ, invInertiaZZ;
+    std::vector<float> radius, halfX, halfY, halfZ, extentX, extentY, extentZ, planeSeparation;
+    std::vector<EquilibriumState> state;
+
+    explicit BenchBodies(size_t count)
+    {
+        for (auto* array : { &posX, &posY, &posZ, &velX, &velY, &velZ, &forceX, &forceY, &forceZ, &inverseMass,
+                             &rotW, &rotX, &rotY, &rotZ, &angVelX, &angVelY, &angVelZ, &torqueX, &torqueY, &torqueZ,
+                             &invInertiaX, &invInertiaY, &invInertiaZ,
+                             &invInertiaXX, &invInertiaXY, &invInertiaXZ, &invInertiaYY, &invInertiaYZ, &invInertiaZZ,
+                             &radius, &halfX, &halfY, &halfZ, &extentX, &extentY, &extentZ, &planeSeparation }) {
+            array->resize(count, 0.0f);
+        }
+        state.resize(count, EquilibriumState::AWAKE);
+
+        //half spheres half boxes, a few static and a few asleep so every mask path gets used. everything
+        //spins a little and gets a torque so the angular kernel has real work
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> height(0.0f, 20.0f);
+        std::uniform_real_distribution<float> spin(-3.0f, 3.0f);
+        for (size_t i = 0; i < count; i++) {
+            posX[i] = spread(rng);
+            posY[i] = height(rng);
+            posZ[i] = spread(rng);
+            inverseMass[i] = (i % 17 == 0) ? 0.0f : 1.0f / (1.0f + (i % 5));
+            rotW[i] = 1.0f;
+            angVelX[i] = spin(rng);
+            angVelY[i] = spin(rng);
+            angVelZ[i] = spin(rng);
+            torqueX[i] = spin(rng);
+            if (i % 2 == 0) radius[i] = 0.5f;
+            else halfX[i] = halfY[i] = halfZ[i] = 0.4f;
+            invInertiaX[i] = invInertiaY[i] = invInertiaZ[i] = inverseMass[i] * 6.0f;
+            invInertiaXX[i] = invInertiaYY[i] = invInertiaZZ[i] = invInertiaX[i];
+            extentX[i] = extentY[i] = extentZ[i] = radius[i] + halfX[i];
+            if (i % 13 == 0) state[i] = EquilibriumState::SLEEPING;
+        }
+    }
+
+    BodyArrays arrays()
+    {
+        return { posX.data(), posY.data(), posZ.data(), velX.data(), velY.data(), velZ.data(),
+                 forceX.data(), forceY.data(), forceZ.data(), inverseMass.data(),
+                 rotW.data(), rotX.data(), rotY.data(), rotZ.data(), angVelX.data(), angVelY.data(), angVelZ.data(),
+                 torqueX.data(), torqueY.data(), torqueZ.data(), invInertiaX.data(), invInertiaY.data(), invInertiaZ.data(),
+                 invInertiaXX.data(), invInertiaXY.data(), invInertiaXZ.data(),
+                 invInertiaYY.data(), invInertiaYZ.data(), invInertiaZZ.data(),
+                 radius.data(), halfX.data(), halfY.data(), halfZ.data(), extentX.data(), extentY.data(), extentZ.data(),
+                 state.data(), planeSeparation.data(), posX.size() };
+    }
+};
+
+static double run(Backend backend, BenchBodies& bodies, int steps)
+{
+    PlaneParams plane{ glm::vec3(0.0f, 1.0f, 0.0f), -1.0f };
+    BodyArrays arrays = bodies.arrays();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        integrate(backend, arrays, 0, arrays.count, -9.8f, 1.0f / 120.0f);
+        integrateAngular(backend, arrays, 0, arrays.count, 1.0f / 120.0f);
+        planeSeparation(backend, arrays, 0, arrays.count, plane);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int steps = argc > 2 ? std::atoi(argv[2]) : 500;
+
+    Backend best = detectBackend();
+    std::vector<Backend> backends = { Backend::SCALAR };
+    if (best != Backend::SCALAR) backends.push_back(Backend::SSE);
+    if (best == Backend::AVX2) backends.push_back(Backend::AVX2);
+
+    std::printf("%zu bodies, %d steps (integrate + angular + plane), detected backend: %s\n", count, steps, backendName(best));
+
+    BenchBodies reference(count);
+    double scalarRate = 0.0;
+    for (Backend backend : backends) {
+        BenchBodies bodies(count);
+        run(backend, bodies, 10); //warm up
+
+        BenchBodies timed(count);
+        double seconds = run(backend, timed, steps);
+        double rate = double(count) * steps / seconds;
+        if (backend == Backend::SCALAR) {
+            scalarRate = rate;
+            reference = timed;
+        }
+
+        //every backend has to land on the exact same bits as the scalar one
+        bool identical = true;
+        for (auto array : { &BenchBodies::posY, &BenchBodies::velY, &BenchBodies::rotW, &BenchBodies::rotX,
+                            &BenchBodies::angVelX, &BenchBodies::invInertiaXY, &BenchBodies::extentY, &BenchBodies::planeSeparation }) {
+            identical &= std::memcmp((timed.*array).data(), (reference.*array).data(), count * sizeof(float)) == 0;
+        }
+
+        std::printf("  %-6s %8.2f M bodies/s  %5.2fx  %s\n", backendName(backend), rate / 1e6,
+                    rate / scalarRate, identical ? "matches scalar" : "MISMATCH vs scalar");
+    }
+    return 0;
+}
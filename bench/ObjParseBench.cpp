@@ -0,0 +1,165 @@
+// Throughput (MB/s) of the obj loader: the old getline + stringstream parser against parseObj on one
+// thread and on the job system, and a check that all of them produce the same triangle soup.
+// No window or GL, build from the repo root with e.g.
+//   g++ -std=c++17 -O2 -pthread -Iheader -ILibraries/include bench/ObjParseBench.cpp source/FileParser.cpp
+//       source/MappedFile.cpp source/JobSystem.cpp -o obj_parse_bench
+//   cl /std:c++17 /O2 /EHsc /Iheader /ILibraries\include bench\ObjParseBench.cpp source\FileParser.cpp
+//       source\MappedFile.cpp source\JobSystem.cpp
+// usage: obj_parse_bench [file.obj] [--segments N] [--runs R]
+//   without a file it writes a uv sphere with N x N quads (default 1024) to a temp file and parses that
+
+#include "FileParser.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//the parser this replaced, kept as it was so the numbers stay comparable. triangles with v/vt/vn only
+static void legacyParseObj(const std::string& filePath, std::vector<Primitives::Vertex>& out_vertices)
+{
+    std::vector<glm::vec3> temp_positions;
+    std::vector<glm::vec2> temp_tex_coords;
+    std::vector<glm::vec3> temp_normals;
+
+    out_vertices.clear();
+
+    std::ifstream fileStream(filePath);
+    std::string line;
+    while (std::getline(fileStream, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        std::stringstream ss(line);
+        std::string prefix;
+        ss >> prefix;
+
+        if (prefix == "v") {
+            glm::vec3 position;
+            ss >> position.x >> position.y >> position.z;
+            temp_positions.push_back(position);
+        }
+        else if (prefix == "vt") {
+            glm::vec2 tex_coords;
+            ss >> tex_coords.x >> tex_coords.y;
+            temp_tex_coords.push_back(tex_coords);
+        }
+        else if (prefix == "vn") {
+            glm::vec3 normals;
+            ss >> normals.x >> normals.y >> normals.z;
+            temp_normals.push_back(normals);
+        }
+        else if (prefix == "f") {
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int vIndex, vtIndex, vnIndex;
+                char slash;
+                ss >> vIndex >> slash >> vtIndex >> slash >> vnIndex;
+
+                Primitives::Vertex vertex;
+                vertex.position = temp_positions[vIndex - 1];
+                vertex.texCoord = temp_tex_coords[vtIndex - 1];
+                vertex.normal = temp_normals[vnIndex - 1];
+                out_vertices.push_back(vertex);
+            }
+        }
+    }
+}
+
+//triangulated uv sphere in the same shape blender exports ours: "v x y z", "vt u v", "vn x y z", "f a/b/c ..."
+static void writeSphere(const std::string& path, int segments)
+{
+    std::ofstream out(path);
+    char line[128];
+    const float pi = 3.14159265f;
+
+    for (int ring = 0; ring <= segments; ring++) {
+        float theta = pi * ring / segments;
+        for (int slice = 0; slice <= segments; slice++) {
+            float phi = 2.0f * pi * slice / segments;
+            glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", n.x, n.y, n.z);
+            out << line;
+            std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", float(slice) / segments, float(ring) / segments);
+            out << line;
+            std::snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", n.x, n.y, n.z);
+            out << line;
+        }
+    }
+
+    for (int ring = 0; ring < segments; ring++) {
+        for (int slice = 0; slice < segments; slice++) {
+            int a = ring * (segments + 1) + slice + 1;
+            int b = a + segments + 1;
+            std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+            out << line;
+            std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+            out << line;
+        }
+    }
+}
+
+static bool sameVertices(const std::vector<Primitives::Vertex>& a, const std::vector<Primitives::Vertex>& b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(Primitives::Vertex)) == 0;
+}
+
+//best of runs, in seconds
+static double best(int runs, const std::function<void()>& fn)
+{
+    double result = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        result = std::min(result, elapsed.count());
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    int segments = 1024;
+    int runs = 3;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--segments") && i + 1 < argc) segments = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--runs") && i + 1 < argc) runs = std::max(1, std::atoi(argv[++i]));
+        else path = argv[i];
+    }
+
+    bool generated = path.empty();
+    if (generated) {
+        path = "obj_parse_bench.obj";
+        writeSphere(path, segments);
+    }
+
+    std::ifstream sizeProbe(path, std::ios::binary | std::ios::ate);
+    double megabytes = static_cast<double>(sizeProbe.tellg()) / (1024.0 * 1024.0);
+    sizeProbe.close();
+
+    JobSystem jobs;
+    std::vector<Primitives::Vertex> legacy, serial, threaded;
+
+    double legacyTime = best(runs, [&] { legacyParseObj(path, legacy); });
+    double serialTime = best(runs, [&] { parseObj(path, serial); });
+    double threadedTime = best(runs, [&] { parseObj(path, threaded, &jobs); });
+
+    std::printf("%s: %.1f MB, %zu triangles, %u threads\n", path.c_str(), megabytes, serial.size() / 3, jobs.getThreadCount());
+    std::printf("  stringstream   %8.1f MB/s\n", megabytes / legacyTime);
+    std::printf("  from_chars x1  %8.1f MB/s  (%.1fx)\n", megabytes / serialTime, legacyTime / serialTime);
+    std::printf("  from_chars x%-2u %8.1f MB/s  (%.1fx)\n", jobs.getThreadCount(), megabytes / threadedTime, legacyTime / threadedTime);
+
+    bool match = sameVertices(legacy, serial) && sameVertices(serial, threaded);
+    std::printf("  output %s\n", match ? "identical" : "DIFFERS");
+
+    if (generated) std::remove(path.c_str());
+    return match ? 0 : 1;
+}
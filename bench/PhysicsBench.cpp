@@ -0,0 +1,295 @@
+// Headless stress test of the whole physics step. No window or GL, so it runs anywhere (CI included)
+// and is the number to compare before and after every physics change. Prints one JSON document.
+// build from the repo root with e.g.
+//   g++ -std=c++17 -O2 -pthread -Iheader -ILibraries/include bench/PhysicsBench.cpp source/Physics.cpp
+//       source/RigidBodyStore.cpp source/PhysicsKernels.cpp source/Collision.cpp source/CollisionDispatch.cpp
+//       source/Gjk.cpp source/ConvexHull.cpp source/SpatialHashGrid.cpp source/DynamicAABBTree.cpp
+//       source/JobSystem.cpp source/Islands.cpp source/ContactSolver.cpp source/Registry.cpp -o physics_bench
+//   cl /std:c++17 /O2 /EHsc /Iheader /ILibraries\include bench\PhysicsBench.cpp source\Physics.cpp (same list)
+// usage: physics_bench [--scene rain|stacks|mixed|all] [--bodies N] [--steps K] [--warmup W]
+//                      [--workers T] [--broadphase grid|bvh] [--backend scalar|sse|avx2] [--no-sleep]
+//   --workers 0 runs every stage on the calling thread, the default is one per spare hardware thread
+
+#include "Physics.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    const float STEP = 1.0f / 120.0f;   //same fixed step the app runs at
+
+    struct Options {
+        std::string scene = "all";
+        size_t bodies = 10000;
+        int steps = 600;
+        int warmup = 60;
+        int workers = -1;               //-1 = JobSystem::defaultWorkerCount()
+        BroadphaseType broadphase = BroadphaseType::GRID;
+        PhysicsKernels::Backend backend = PhysicsKernels::detectBackend();
+        bool sleeping = true;
+    };
+
+    struct Result {
+        std::string scene;
+        size_t bodies = 0;
+        double nsPerStep = 0.0;
+        double nsPerStepMax = 0.0;
+        double contactsPerStep = 0.0;
+        size_t awakeAtEnd = 0;
+        uint64_t hash = 0;
+    };
+
+    size_t peakMemoryKb()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss) / 1024;    //bytes there, kilobytes on linux
+#else
+        return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+    }
+
+    std::vector<glm::vec3> boxPoints(const glm::vec3& half)
+    {
+        std::vector<glm::vec3> points;
+        for (int corner = 0; corner < 8; corner++) {
+            points.push_back({ (corner & 1) ? half.x : -half.x, (corner & 2) ? half.y : -half.y, (corner & 4) ? half.z : -half.z });
+        }
+        return points;
+    }
+
+    //unit spheres falling onto the plane from a column about as wide as it is tall, they pile up over the run
+    void spawnRain(RigidBodyStore& bodies, size_t count)
+    {
+        Collider sphere;
+        sphere.type = ShapeType::SPHERE;
+        sphere.radius = 0.5f;
+        uint32_t collider = bodies.addCollider(sphere);
+
+        float side = std::sqrt(static_cast<float>(count)) * 1.2f;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> spread(-side * 0.5f, side * 0.5f);
+        std::uniform_real_distribution<float> height(0.0f, 30.0f);
+        for (size_t i = 0; i < count; i++) {
+            BodyDesc desc;
+            desc.collider = collider;
+            desc.position = glm::vec3(spread(rng), height(rng), spread(rng));
+            desc.velocity = glm::vec3(0.0f, -5.0f, 0.0f);
+            bodies.add(desc);
+        }
+    }
+
+    //towers of 8 rotating boxes on a grid, the solver and sleeping do most of the work here
+    void spawnStacks(RigidBodyStore& bodies, size_t count)
+    {
+        const int height = 8;
+        Collider box;
+        box.type = ShapeType::OBB;
+        box.baseHalfExtents = glm::vec3(0.5f);
+        uint32_t collider = bodies.addCollider(box);
+
+        size_t towers = (count + height - 1) / height;
+        int perRow = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(towers))));
+        size_t spawned = 0;
+        for (size_t t = 0; t < towers; t++) {
+            float x = (static_cast<int>(t) % perRow - perRow * 0.5f) * 3.0f;
+            float z = (static_cast<int>(t) / perRow - perRow * 0.5f) * 3.0f;
+            for (int level = 0; level < height && spawned < count; level++, spawned++) {
+                BodyDesc desc;
+                desc.collider = collider;
+                desc.position = glm::vec3(x, -0.5f + level * 1.0f, z);
+                bodies.add(desc);
+            }
+        }
+    }
+
+    //every shape type in a few sizes, tumbling onto the plane together
+    void spawnMixed(RigidBodyStore& bodies, size_t count)
+    {
+        std::vector<uint32_t> colliders;
+        for (float size : { 0.25f, 0.5f, 0.8f, 1.2f }) {
+            Collider sphere;
+            sphere.type = ShapeType::SPHERE;
+            sphere.radius = size;
+            colliders.push_back(bodies.addCollider(sphere));
+
+            Collider box;
+            box.type = ShapeType::OBB;
+            box.baseHalfExtents = glm::vec3(size, size * 0.6f, size * 0.8f);
+            colliders.push_back(bodies.addCollider(box));
+
+            Collider capsule;
+            capsule.type = ShapeType::CAPSULE;
+            capsule.radius = size * 0.5f;
+            capsule.halfHeight = size;
+            colliders.push_back(bodies.addCollider(capsule));
+
+            Collider hull;
+            hull.type = ShapeType::CONVEX_HULL;
+            hull.hullVertices = boxPoints(glm::vec3(size * 0.7f, size * 0.5f, size * 0.6f));
+            hull.hullVertices.push_back(glm::vec3(0.0f, size * 0.9f, 0.0f));
+            colliders.push_back(bodies.addCollider(hull));
+        }
+
+        float side = std::sqrt(static_cast<float>(count)) * 2.0f;
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<float> spread(-side * 0.5f, side * 0.5f);
+        std::uniform_real_distribution<float> height(0.0f, 40.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (size_t i = 0; i < count; i++) {
+            BodyDesc desc;
+            desc.collider = colliders[i % colliders.size()];
+            desc.position = glm::vec3(spread(rng), height(rng), spread(rng));
+            desc.orientation = glm::normalize(glm::quat(1.0f + unit(rng), unit(rng), unit(rng), unit(rng)));
+            desc.angularVelocity = glm::vec3(unit(rng), unit(rng), unit(rng));
+            desc.mass = 1.0f + static_cast<float>(i % 4);
+            bodies.add(desc);
+        }
+    }
+
+    Result run(const std::string& scene, const Options& options, JobSystem* jobs)
+    {
+        RigidBodyStore bodies;
+        bodies.reserve(options.bodies);
+        if (scene == "rain") spawnRain(bodies, options.bodies);
+        else if (scene == "stacks") spawnStacks(bodies, options.bodies);
+        else spawnMixed(bodies, options.bodies);
+
+        Plane plane;
+        plane.init();
+
+        Physics physics;
+        physics.setGravity(true);
+        physics.setDeterministic(true);
+        physics.setJobSystem(jobs);
+        physics.setBroadphase(options.broadphase);
+        physics.setKernelBackend(options.backend);
+        physics.setSleepingEnabled(options.sleeping);
+
+        for (int step = 0; step < options.warmup; step++) {
+            bodies.storePrevious();
+            physics.update(bodies, plane, STEP);
+        }
+
+        Result result;
+        result.scene = scene;
+        result.bodies = bodies.size();
+        double totalNs = 0.0;
+        double contacts = 0.0;
+        for (int step = 0; step < options.steps; step++) {
+            auto start = std::chrono::steady_clock::now();
+            bodies.storePrevious();
+            physics.update(bodies, plane, STEP);
+            double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+            totalNs += ns;
+            result.nsPerStepMax = std::max(result.nsPerStepMax, ns);
+            contacts += static_cast<double>(physics.getContacts().size());
+        }
+
+        int steps = std::max(options.steps, 1);
+        result.nsPerStep = totalNs / steps;
+        result.contactsPerStep = contacts / steps;
+        for (uint32_t i = 0; i < bodies.size(); i++) {
+            if (bodies.isActive(i)) result.awakeAtEnd++;
+        }
+        result.hash = physics.getStateHash();
+        return result;
+    }
+
+    bool parse(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (std::strcmp(arg, "--no-sleep") == 0) { options.sleeping = false; continue; }
+            if (!value) return false;
+            i++;
+
+            if (std::strcmp(arg, "--scene") == 0) options.scene = value;
+            else if (std::strcmp(arg, "--bodies") == 0) options.bodies = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--steps") == 0) options.steps = std::atoi(value);
+            else if (std::strcmp(arg, "--warmup") == 0) options.warmup = std::atoi(value);
+            else if (std::strcmp(arg, "--workers") == 0) options.workers = std::atoi(value);
+            else if (std::strcmp(arg, "--broadphase") == 0) {
+                if (std::strcmp(value, "bvh") == 0) options.broadphase = BroadphaseType::BVH;
+                else if (std::strcmp(value, "grid") == 0) options.broadphase = BroadphaseType::GRID;
+                else return false;
+            }
+            else if (std::strcmp(arg, "--backend") == 0) {
+                if (std::strcmp(value, "scalar") == 0) options.backend = PhysicsKernels::Backend::SCALAR;
+                else if (std::strcmp(value, "sse") == 0) options.backend = PhysicsKernels::Backend::SSE;
+                else if (std::strcmp(value, "avx2") == 0) options.backend = PhysicsKernels::Backend::AVX2;
+                else return false;
+            }
+            else return false;
+        }
+        return options.scene == "all" || options.scene == "rain" || options.scene == "stacks" || options.scene == "mixed";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::fprintf(stderr, "usage: physics_bench [--scene rain|stacks|mixed|all] [--bodies N] [--steps K] [--warmup W]\n"
+                             "                     [--workers T] [--broadphase grid|bvh] [--backend scalar|sse|avx2] [--no-sleep]\n");
+        return 1;
+    }
+
+    std::unique_ptr<JobSystem> jobs;
+    unsigned workers = options.workers < 0 ? JobSystem::defaultWorkerCount() : static_cast<unsigned>(options.workers);
+    if (workers > 0) jobs = std::make_unique<JobSystem>(workers);
+
+    std::vector<std::string> scenes;
+    if (options.scene == "all") scenes = { "rain", "stacks", "mixed" };
+    else scenes = { options.scene };
+
+    std::vector<Result> results;
+    for (const std::string& scene : scenes) results.push_back(run(scene, options, jobs.get()));
+
+    std::printf("{\n");
+    std::printf("  \"steps\": %d,\n  \"warmup\": %d,\n  \"step_seconds\": %.9g,\n", options.steps, options.warmup, STEP);
+    std::printf("  \"workers\": %u,\n  \"broadphase\": \"%s\",\n  \"backend\": \"%s\",\n  \"sleeping\": %s,\n", workers,
+                options.broadphase == BroadphaseType::BVH ? "bvh" : "grid", PhysicsKernels::backendName(options.backend),
+                options.sleeping ? "true" : "false");
+    std::printf("  \"scenes\": [\n");
+    for (size_t k = 0; k < results.size(); k++) {
+        const Result& r = results[k];
+        double stepsPerSecond = r.nsPerStep > 0.0 ? 1e9 / r.nsPerStep : 0.0;
+        std::printf("    {\n");
+        std::printf("      \"scene\": \"%s\",\n      \"bodies\": %zu,\n", r.scene.c_str(), r.bodies);
+        std::printf("      \"ns_per_step\": %.0f,\n      \"ns_per_step_max\": %.0f,\n", r.nsPerStep, r.nsPerStepMax);
+        std::printf("      \"bodies_per_second\": %.0f,\n", static_cast<double>(r.bodies) * stepsPerSecond);
+        std::printf("      \"contacts_per_step\": %.1f,\n      \"contacts_per_second\": %.0f,\n", r.contactsPerStep, r.contactsPerStep * stepsPerSecond);
+        std::printf("      \"awake_at_end\": %zu,\n", r.awakeAtEnd);
+        std::printf("      \"state_hash\": \"%016llx\"\n", static_cast<unsigned long long>(r.hash));
+        std::printf("    }%s\n", k + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+    //for the whole process, so with several scenes it is the biggest of them
+    std::printf("  \"peak_memory_kb\": %zu\n}\n", peakMemoryKb());
+    return 0;
+}
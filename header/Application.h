@@ -4,13 +4,21 @@
 #include "Camera.h"
 #include "InputManager.h"
 #include "Physics.h"
+#include "RigidBodyStore.h"
 #include "Serializer.h"
 #include "Components.h"
+#include "SimulationClock.h"
+#include "JobSystem.h"
+#include "Registry.h"
+#include "SceneComponents.h"
+#include "SystemScheduler.h"
+#include "CommandBuffer.h"
 #include <memory> 
 
 
 #include "Shader.h"
 #include "Mesh.h"
+#include "MeshRegistry.h"
 #include "Renderer.h"
 
 
@@ -23,8 +31,6 @@ public:
 
 private:
 
-    bool shouldSpawnCube = false;
-    
     const char* BASIC_VERT_PATH = "basic.vert";
     const char* BASIC_FRAG_PATH = "basic.frag";
 
@@ -36,6 +42,18 @@ private:
     const int SCR_HEIGHT = 800;
     const char* JSON_PATH = "entity_state.json";
 
+    //physics runs on its own fixed clock, rendering interpolates between the last two steps
+    const float PHYSICS_HZ = 120.0f;
+    const int MAX_PHYSICS_SUBSTEPS = 8;
+    const float MAX_FRAME_TIME = 0.25f;
+
+    const float INTERACT_RANGE = 50.0f;
+    const float CUBE_SPAWN_DISTANCE = 3.0f;   //in front of the camera
+    const float CUBE_SCALE = 0.2f;
+
+    //command sort keys, one per system that records any
+    const uint64_t GAMEPLAY_COMMANDS = 0;
+
     
     const char* ORB_MODEL_PATH = "sphere.txt";
     const char* PLANE_MODEL_PATH = "plane.txt"; 
@@ -46,21 +64,57 @@ private:
     std::unique_ptr<Window> m_window;
     std::unique_ptr<InputManager> m_input;
     std::unique_ptr<Renderer> m_renderer;
+    std::unique_ptr<JobSystem> m_jobs;
+    std::unique_ptr<CommandQueue> m_commands;   //structural changes recorded by the systems
     Physics m_physics;
+    RigidBodyStore m_bodies;
     Serializer m_serializer;
     Camera m_camera;
-
-    //entity
-    GlowingOrb m_orb;
-    Plane m_plane;
-    Cube m_cube;
-
-
-    //entity descriptors
-    std::unique_ptr<Mesh> m_orbMesh;
+    SimulationClock m_clock;
+
+    //every entity in the scene, the orb and the plane always exist, cubes come and go at runtime
+    Registry m_registry;
+    Entity m_orb = NULL_ENTITY;
+    Entity m_plane = NULL_ENTITY;
+    uint32_t m_cubeCollider = 0;    //shared by every spawned cube
+    uint32_t m_orbCollider = 0;
+    StringTable m_strings;          //entity names and states, EntityInfo points in here
+
+    //the frame as systems, m_systems.run does everything up to the gl calls
+    SystemScheduler m_systems;
+    void buildSystems();
+
+    //what the systems hand each other within a frame
+    struct InteractionTarget {
+        BodyId body = INVALID_BODY;     //the orb the crosshair is charging, if any
+    };
+    float m_frameTime = 0.0f;
+    InputState m_inputState;
+    InteractionTarget m_interaction;
+    int m_steps = 0;                            //fixed steps this frame
+    std::vector<ImpactEvent> m_frameImpacts;    //from every one of those steps
+    std::vector<DrawItem> m_drawList;
+
+    Entity spawnOrb(const GlowingOrb& orb, const EntityInfo& info);
+    //records the cube, it exists (body and all) after the next playback
+    void spawnCube(CommandRecorder& commands, const glm::vec3& position);
+    //playback calls this for every entity it destroys, the body has to go with it
+    void removeBody(Entity entity);
+    //entities spawned with a BodyDesc get their body in m_bodies and a RigidBody for it
+    void attachBodies();
+
+    //copies interpolated body state into the Transform of every simulated entity
+    void syncTransforms(float alpha);
+    //pulls the simulated state back into every GlowingOrb so it can be serialized
+    void syncOrbFromBody();
+
+
+    //entity descriptors, the handles keep alive the meshes the Renderables point at
+    std::unique_ptr<MeshRegistry> m_meshes;
+    MeshHandle m_orbMesh;
     std::unique_ptr<Shader> m_orbShader;
-    std::unique_ptr<Mesh> m_planeMesh;
+    MeshHandle m_planeMesh;
     std::unique_ptr<Shader> m_planeShader;
-    std::unique_ptr<Mesh> m_cubeMesh;
+    MeshHandle m_cubeMesh;
     std::unique_ptr<Shader> m_cubeShader;
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "RigidBodyStore.h"
+#include "ConvexHull.h"
+#include <glm/glm.hpp>
+
+// axis aligned box given by its corners
+struct AABB {
+    glm::vec3 lower{ 0.0f };
+    glm::vec3 upper{ 0.0f };
+
+    bool overlaps(const AABB& other) const
+    {
+        return lower.x <= other.upper.x && other.lower.x <= upper.x &&
+               lower.y <= other.upper.y && other.lower.y <= upper.y &&
+               lower.z <= other.upper.z && other.lower.z <= upper.z;
+    }
+
+    bool contains(const AABB& other) const
+    {
+        return lower.x <= other.lower.x && lower.y <= other.lower.y && lower.z <= other.lower.z &&
+               other.upper.x <= upper.x && other.upper.y <= upper.y && other.upper.z <= upper.z;
+    }
+
+    float surfaceArea() const
+    {
+        glm::vec3 d = upper - lower;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static AABB merge(const AABB& a, const AABB& b)
+    {
+        return { glm::min(a.lower, b.lower), glm::max(a.upper, b.upper) };
+    }
+};
+
+// world space bounds of body i (dense index) straight from the store arrays
+inline AABB bodyBounds(const RigidBodyStore& bodies, uint32_t i)
+{
+    glm::vec3 center(bodies.posX[i], bodies.posY[i], bodies.posZ[i]);
+    glm::vec3 extent(bodies.extentX[i], bodies.extentY[i], bodies.extentZ[i]);
+    return { center - extent, center + extent };
+}
+
+// two bodies the broadphase thinks might be touching, always stored with a < b
+struct BodyPair {
+    BodyId a;
+    BodyId b;
+};
+
+// narrowphase result, normal points from body a towards body b
+struct Contact {
+    BodyId a;
+    BodyId b;
+    glm::vec3 normal;
+    glm::vec3 point;
+    float penetration;
+    uint32_t feature = 0;   //which corner/edge of the pair this is, stays the same while the bodies keep touching the same way
+};
+
+// most contacts one body pair produces, a box lying flat on another needs 4 to not rock
+constexpr int MAX_MANIFOLD = 4;
+
+// one side of a pair as the narrowphase sees it, gathered from the store (or the world plane) once so
+// every test takes the same thing. only the fields of its type mean anything
+struct ShapeInstance {
+    ShapeType type = ShapeType::NONE;
+    glm::vec3 position{ 0.0f };
+    glm::mat3 rotation{ 1.0f };
+    float radius = 0.0f;                //sphere, capsule
+    float halfHeight = 0.0f;            //capsule, along the local y axis
+    glm::vec3 halfExtents{ 0.0f };      //AABB, OBB
+    const ConvexHull* hull = nullptr;   //CONVEX_HULL
+    glm::vec3 normal{ 0.0f };           //PLANE, dot(normal, p) = distance on it
+    float distance = 0.0f;
+};
+
+// a body hit something hard enough to bounce this step
+struct ImpactEvent {
+    BodyId body;
+    float speed;
+};
+
+// body vs body overlap tests, each returns false when the shapes dont touch.
+// positions are centers, boxes are given by their half extents (and a rotation for oriented ones)
+namespace Narrowphase
+{
+    bool sphereSphere(const glm::vec3& posA, float radiusA, const glm::vec3& posB, float radiusB, Contact& out);
+    bool sphereAABB(const glm::vec3& spherePos, float radius, const glm::vec3& boxPos, const glm::vec3& halfExtents, Contact& out);
+    bool aabbAABB(const glm::vec3& posA, const glm::vec3& halfA, const glm::vec3& posB, const glm::vec3& halfB, Contact& out);
+    // sphereAABB done in the box's own frame
+    bool sphereOBB(const glm::vec3& spherePos, float radius, const glm::vec3& boxPos, const glm::mat3& rotation,
+                   const glm::vec3& halfExtents, Contact& out);
+    // separating axis test over the 15 axes of two oriented boxes. touching faces are clipped against
+    // each other into up to MAX_MANIFOLD points, crossing edges give a single point. returns how many
+    // contacts were written to out (0 when apart), a and b of those are left for the caller to fill
+    int boxBox(const glm::vec3& posA, const glm::mat3& rotationA, const glm::vec3& halfA,
+               const glm::vec3& posB, const glm::mat3& rotationB, const glm::vec3& halfB, Contact* out);
+
+    // cuts a manifold down to MAX_MANIFOLD, keeping the 4 points that cover the most area: the deepest,
+    // the one furthest from it, then the furthest to either side of the line between those two
+    int reduceManifold(Contact* contacts, int count, const glm::vec3& normal);
+
+    // capsules are given by their two segment end points
+    bool sphereCapsule(const glm::vec3& spherePos, float radiusA, const glm::vec3& capsuleA, const glm::vec3& capsuleB, float radiusB,
+                       Contact& out);
+    // a capsule lying along another one gets a contact at both ends of the overlap
+    int capsuleCapsule(const glm::vec3& a0, const glm::vec3& a1, float radiusA, const glm::vec3& b0, const glm::vec3& b1, float radiusB,
+                       Contact* out);
+
+    // ray vs shape, direction has to be normalized. on a hit t is the distance along the ray (0 when
+    // the origin starts inside the shape)
+    bool raySphere(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& center, float radius, float maxT, float& t);
+    bool rayAABB(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& lower, const glm::vec3& upper, float maxT, float& t);
+    bool rayCapsule(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& a, const glm::vec3& b, float radius, float maxT, float& t);
+    // origin and dir in the hull's own frame
+    bool rayConvexHull(const glm::vec3& origin, const glm::vec3& dir, const ConvexHull& hull, float maxT, float& t);
+
+    // sphere moving from start to start + motion against a box that holds still. on a hit toi is the
+    // fraction of motion travelled before touching and normal points out of the box at that spot.
+    // a sphere that already overlaps the box at start is left to the discrete tests
+    bool sweepSphereAABB(const glm::vec3& start, const glm::vec3& motion, float radius, const glm::vec3& boxPos,
+                         const glm::vec3& halfExtents, float& toi, glm::vec3& normal);
+}
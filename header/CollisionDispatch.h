@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Collision.h"
+#include "RigidBodyStore.h"
+
+// narrowphase test for one combination of shape types. writes up to MAX_MANIFOLD contacts with the
+// normal running from a to b and returns how many, the body ids of the contacts are left to the caller.
+// tests with a plane on one side work a little differently: they hand back the deepest points of the
+// other shape even while it is still above the plane (negative penetration), the solver decides how
+// close is close enough for a speculative contact
+using CollideFunction = int (*)(const ShapeInstance& a, const ShapeInstance& b, Contact* out);
+
+// ShapeType x ShapeType table of narrowphase tests. adding a shape means filling in its row here,
+// nothing in Physics or the solver has to learn about it
+namespace CollisionDispatch
+{
+    // NONE gets a row and column too, all empty
+    constexpr int SHAPE_SLOTS = SHAPE_TYPE_COUNT + 1;
+    constexpr int PAIR_TYPE_COUNT = SHAPE_SLOTS * SHAPE_SLOTS;
+
+    // every ordered combination of two types gets a number, the narrowphase batches pairs by it
+    inline int pairType(ShapeType a, ShapeType b) { return static_cast<int>(a) * SHAPE_SLOTS + static_cast<int>(b); }
+
+    // nullptr for combinations that never touch (plane vs plane, anything vs NONE)
+    CollideFunction get(int pairType);
+    inline CollideFunction get(ShapeType a, ShapeType b) { return get(pairType(a, b)); }
+
+    // body i (dense index) as the tests want it
+    ShapeInstance bodyShape(const RigidBodyStore& bodies, uint32_t index);
+    ShapeInstance planeShape(const glm::vec3& normal, float distance);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Registry.h"
+#include "JobSystem.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class CommandRecorder;
+
+// Structural changes recorded now and applied later. Systems run while others are querying the
+// registry, so none of them may spawn, destroy, add or remove anything directly; they record it
+// through a CommandRecorder and CommandQueue::playback applies it at the next sync point, when
+// nothing is running. every command carries the sort key of the recorder that made it
+class CommandBuffer
+{
+public:
+    CommandBuffer() = default;
+    ~CommandBuffer() { clear(); }
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    size_t size() const { return m_commands.size(); }
+    bool empty() const { return m_commands.empty(); }
+
+    // drops every command without applying it
+    void clear();
+
+    // placeholders use the one slot index the registry never hands out
+    static bool isPlaceholder(Entity entity) { return entity != NULL_ENTITY && entityIndex(entity) == MAX_ENTITIES; }
+
+private:
+    friend class CommandQueue;
+    friend class CommandRecorder;
+
+    enum class CommandType : uint8_t { SPAWN, DESTROY, ADD, SET, REMOVE };
+
+    struct Command {
+        uint64_t sortKey;
+        CommandType type;
+        Entity entity;                                  //placeholder, real entity or NULL_ENTITY
+        void* payload;                                  //the component for ADD and SET, in m_blocks
+        void (*apply)(Registry& registry, Entity entity, void* payload);
+        void (*destroyPayload)(void* payload);
+    };
+
+    //payloads go into fixed blocks so they never move once recorded, non trivial components included
+    static constexpr size_t BLOCK_BYTES = 4096;
+
+    Entity spawn(uint64_t sortKey);
+
+    template<typename T>
+    void push(uint64_t sortKey, CommandType type, Entity entity, T component)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over aligned components can't be recorded");
+        void* payload = allocate(sizeof(T));
+        new (payload) T(std::move(component));
+
+        if (type == CommandType::ADD) {
+            push(sortKey, type, entity, payload, [](Registry& registry, Entity target, void* data) {
+                T& value = *static_cast<T*>(data);
+                if (T* existing = registry.tryGet<T>(target)) *existing = std::move(value);
+                else registry.emplace<T>(target, std::move(value));
+            });
+        }
+        else {
+            push(sortKey, type, entity, payload, [](Registry& registry, Entity target, void* data) {
+                if (T* existing = registry.tryGet<T>(target)) *existing = std::move(*static_cast<T*>(data));
+            });
+        }
+        m_commands.back().destroyPayload = [](void* data) { static_cast<T*>(data)->~T(); };
+    }
+
+    void push(uint64_t sortKey, CommandType type, Entity entity, void* payload, void (*apply)(Registry&, Entity, void*));
+    void* allocate(size_t size);
+
+    std::vector<Command> m_commands;
+    std::vector<std::unique_ptr<std::max_align_t[]>> m_blocks;
+    size_t m_blockUsed = BLOCK_BYTES;           //bytes taken in m_blocks.back()
+    uint32_t m_placeholders = 0;                //spawns recorded so far
+    std::vector<Entity> m_spawned;              //placeholder n -> real entity, filled during playback
+};
+
+// Records into one thread's CommandBuffer under its own sort key. the key travels with every command,
+// so two recorders sharing a buffer (a system that blocked in parallelFor and ran another system's job
+// meanwhile) never get their commands mixed up. small, take a fresh one from CommandQueue::record on
+// the thread that records and don't keep it past playback.
+// spawn hands out a placeholder handle that only means something to later commands recorded on the
+// same thread, the real entity only exists after playback
+class CommandRecorder
+{
+public:
+    CommandRecorder(CommandBuffer& buffer, uint64_t sortKey) : m_buffer(&buffer), m_sortKey(sortKey) {}
+
+    // NULL_ENTITY once this thread recorded ENTITY_GENERATION_MASK spawns since the last playback
+    Entity spawn() { return m_buffer->spawn(m_sortKey); }
+    void destroy(Entity entity) { m_buffer->push(m_sortKey, CommandBuffer::CommandType::DESTROY, entity, nullptr, nullptr); }
+
+    // adds the component, or overwrites it if the entity already has one by then
+    template<typename T>
+    void add(Entity entity, T component) { m_buffer->push(m_sortKey, CommandBuffer::CommandType::ADD, entity, std::move(component)); }
+
+    template<typename T>
+    void remove(Entity entity)
+    {
+        m_buffer->push(m_sortKey, CommandBuffer::CommandType::REMOVE, entity, nullptr,
+                       [](Registry& registry, Entity target, void*) { registry.remove<T>(target); });
+    }
+
+    // new value for a component the entity has by the time this is played back, skipped if it has none
+    template<typename T>
+    void set(Entity entity, T component) { m_buffer->push(m_sortKey, CommandBuffer::CommandType::SET, entity, std::move(component)); }
+
+    uint64_t getSortKey() const { return m_sortKey; }
+
+private:
+    CommandBuffer* m_buffer;
+    uint64_t m_sortKey;
+};
+
+// One CommandBuffer per job system thread, so recording never takes a lock.
+// playback runs the commands of every buffer ordered by sort key, and a recorder's own commands in
+// the order it made them. which thread a system happened to run on never changes the result, as long
+// as every recorder (a system, or one range of a parallelFor) uses a key no other recorder uses
+class CommandQueue
+{
+public:
+    // one buffer per thread of jobs, or a single one without
+    explicit CommandQueue(JobSystem* jobs = nullptr);
+
+    // a recorder into the calling thread's buffer, its commands play back in sortKey's position
+    CommandRecorder record(uint64_t sortKey);
+
+    // applies everything recorded since the last playback, then empties the buffers. onDestroy runs
+    // right before each entity is destroyed, while its components can still be read.
+    // must not overlap with anything else using the registry
+    void playback(Registry& registry, const std::function<void(Entity)>& onDestroy = nullptr);
+
+    size_t size() const;
+
+private:
+    JobSystem* m_jobs;
+    std::vector<std::unique_ptr<CommandBuffer>> m_buffers;
+
+    struct Entry {
+        uint64_t sortKey;
+        uint32_t buffer;
+        uint32_t command;
+    };
+    std::vector<Entry> m_order;     //scratch
+};
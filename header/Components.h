@@ -2,16 +2,23 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
-#include <string>
+#include <type_traits>
+#include <vector>
 
 
 enum class ShapeType {
     SPHERE,
     PLANE,
-    AABB,
+    AABB,   //box that never rotates
+    OBB,    //box with full rotation
+    CAPSULE,        //segment along the local y axis with a radius around it
+    CONVEX_HULL,    //convex point cloud around the body's center
     NONE
 };
 
+//how many real shape types there are, NONE doubles as the count
+constexpr int SHAPE_TYPE_COUNT = static_cast<int>(ShapeType::NONE);
+
 enum class EquilibriumState {
     AWAKE,
     SLEEPING
@@ -22,37 +29,31 @@ struct Collider {
     float radius;
     glm::vec3 normal;
     glm::vec3 baseHalfExtents = glm::vec3(0.5f);
+    float halfHeight = 0.5f;                //capsule, half the length of its inner segment
+    std::vector<glm::vec3> hullVertices;    //convex hull, local space, interior points get dropped
 };
 
 
 
 
 
+//spawn/gameplay descriptions, once spawned the simulated state (velocity, forces, sleeping)
+//lives in RigidBodyStore and these only get synced back for saving
+
+// the orb's own data, also its component. plain data on purpose: thousands of them can be memcpy'd,
+// snapshotted or run through simd loops. its name and state strings live in the StringTable (EntityInfo)
+// and gravity is a Physics setting, the collider is always a sphere of ORB_RADIUS
 struct GlowingOrb {
-    std::string id = "entity_01";
     glm::vec3 position = glm::vec3(0.0f, 5.0f, 0.0f);
     glm::vec3 velocity = glm::vec3(0.0f, 0.0f, 0.0f);
     float energy = 0.5f;
-    std::string state = "active";
-    bool isGravityOn = false;
-
     float mass = 1.0f;           
-    float inverseMass = 1.0f / mass; 
-    glm::vec3 forceAccumulator{ 0.0f };
-
-    Collider collider;
-    EquilibriumState eq_state = EquilibriumState::AWAKE;
-    
-    float sleepTimer = 0.0f;
+};
 
-    void init() {
-        position = glm::vec3(0.0f, 5.0f, 0.0f);
-        
+static_assert(std::is_trivially_copyable<GlowingOrb>::value, "GlowingOrb has to stay plain data");
+static_assert(sizeof(GlowingOrb) <= 32, "GlowingOrb should fit in half a cache line");
 
-        collider.type = ShapeType::SPHERE;
-        collider.radius = 1.0f; 
-    }
-};
+constexpr float ORB_RADIUS = 1.0f;
 
 
 struct Plane  {
@@ -74,21 +75,15 @@ struct Cube {
     glm::vec3 scale = glm::vec3(1.0f);
 
 
-    /*glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); 
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); 
     glm::vec3 angularVelocity = glm::vec3(0.0f);
-    glm::vec3 torque = glm::vec3(0.0f);*/
 
     float mass = 10.0f;
-    float inverseMass = 1.0f/mass; 
-    glm::vec3 forceAccumulator = glm::vec3(0.0f);
-
-    float sleepTimer = 0.0f;
 
     Collider collider;
-    EquilibriumState state = EquilibriumState::AWAKE;
 
     void init() {
-        collider.type = ShapeType::AABB;
+        collider.type = ShapeType::OBB;
         collider.baseHalfExtents = glm::vec3(1.0f); 
 
     }
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Collision.h"
+#include "Islands.h"
+#include "RigidBodyStore.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+enum class PositionCorrection {
+    BAUMGARTE,      //penetration feeds a bias velocity into the contact itself, cheap but adds energy
+    SPLIT_IMPULSE   //penetration is fixed with separate pseudo velocities that never become real motion
+};
+
+struct SolverSettings {
+    int iterations = 8;             //quality/speed knob, with warm starting stacks settle in 4-8
+    bool warmStarting = true;
+    PositionCorrection positionCorrection = PositionCorrection::SPLIT_IMPULSE;
+    float friction = 0.3f;
+    float restitution = 0.6f;
+    float restitutionThreshold = 0.5f;  //slower hits than this dont bounce, keeps resting contacts resting
+    float planeRestitution = 0.6f;      //the ground gets its own, it used to be handled apart from bodies
+    float planeRestitutionThreshold = 0.1f;
+};
+
+// Sequential impulse contact solver. Each contact gets an accumulated normal impulse clamped to stay
+// pushing, and a friction impulse clamped to the friction cone of it. Impulses act at the contact
+// point, so off center hits spin bodies through their world inverse inertia. The impulses a contact
+// ended a step with are cached by body pair and feature and applied up front next step (warm
+// starting), so a stack starts every step already close to the answer instead of rebuilding it from zero.
+// Islands are solved independently, solveIsland for different islands can run in parallel
+class ContactSolver
+{
+public:
+    // sizes the scratch for this step. the plane is solved as a static body under every island,
+    // planeSeparation is the per body gap from PhysicsKernels::planeSeparation
+    void begin(const RigidBodyStore& bodies, const IslandBuilder& islands, const glm::vec3& planeNormal, float planeDistance,
+               const std::vector<float>& planeSeparation);
+    // solves the contacts of island islandIndex and moves its bodies out of penetration. bounces are
+    // added to impacts
+    void solveIsland(RigidBodyStore& bodies, const std::vector<Contact>& contacts, const IslandBuilder& islands,
+                     uint32_t islandIndex, float deltaTime, std::vector<ImpactEvent>& impacts);
+    // keeps this step's impulses around for warm starting the next one
+    void end(const RigidBodyStore& bodies);
+    // drops the cached impulses of removed bodies, before a new body reusing the id is warm started with them
+    void forgetBodies(const std::vector<BodyId>& removed);
+
+    // the warm start cache carries over into the next step, so it is part of the simulation state
+    void hashState(StateHasher& hasher) const;
+
+    SolverSettings& getSettings() { return m_settings; }
+    const SolverSettings& getSettings() const { return m_settings; }
+
+private:
+    //no body on the a side, the contact is against the plane
+    static constexpr uint32_t PLANE = 0xFFFFFFFFu;
+
+    struct SolverContact {
+        uint64_t key;
+        uint32_t feature;
+        uint32_t ia, ib;            //dense indices, ia is PLANE for plane contacts
+        glm::vec3 normal;           //a -> b
+        glm::vec3 tangent1, tangent2;
+        glm::vec3 armA, armB;       //contact point relative to each body's center
+        float invMassA, invMassB;
+        float normalMass;           //effective mass along each direction, rotation makes them differ
+        float tangentMass1, tangentMass2;
+        float velocityTarget;       //lowest normal velocity the contact allows
+        float positionBias;         //pseudo velocity split impulse pushes apart with
+        float normalImpulse;
+        float tangentImpulse1, tangentImpulse2;
+        float pseudoImpulse;
+    };
+
+    // what a contact finished last step with
+    struct CachedImpulse {
+        uint64_t key;
+        uint32_t feature;
+        glm::vec3 normal;
+        float normalImpulse;
+        glm::vec3 frictionImpulse;  //world space, the tangent basis may not survive a change in normal
+    };
+
+    static uint64_t pairKey(BodyId a, BodyId b) { return (uint64_t(a) << 32) | b; }
+
+    const CachedImpulse* findCached(uint64_t key, uint32_t feature) const;
+    // fills in everything but key/feature/bodies/normal, returns the approach speed if the contact bounces, 0 otherwise
+    float prepare(RigidBodyStore& bodies, SolverContact& c, const glm::vec3& point, float penetration, float restitution,
+                  float restitutionThreshold, float deltaTime) const;
+    float effectiveMass(const RigidBodyStore& bodies, const SolverContact& c, const glm::vec3& direction) const;
+    void applyImpulse(RigidBodyStore& bodies, const SolverContact& c, const glm::vec3& impulse) const;
+    glm::vec3 relativeVelocity(const RigidBodyStore& bodies, const SolverContact& c) const;
+    // plane contacts of body i into out, returns how many (at most MAX_MANIFOLD)
+    // bounce is the fastest approach speed among them that bounced, 0 if none did
+    uint32_t addPlaneContacts(RigidBodyStore& bodies, uint32_t i, float deltaTime, SolverContact* out, float& bounce) const;
+
+    SolverSettings m_settings;
+    glm::vec3 m_planeNormal{ 0.0f, 1.0f, 0.0f };
+    float m_planeDistance = 0.0f;
+    const float* m_planeSeparation = nullptr;
+
+    //island k owns the slots starting at contactBegin + MAX_MANIFOLD * bodyBegin: its body contacts,
+    //then up to MAX_MANIFOLD plane contacts per body. sized once in begin() so islands never allocate
+    std::vector<SolverContact> m_solverContacts;
+    std::vector<uint32_t> m_solverBegins;   //first slot per island
+    std::vector<uint32_t> m_solverCounts;   //used slots per island
+
+    //split impulse pseudo velocities, linear and angular, dense body index
+    std::vector<float> m_pseudoX, m_pseudoY, m_pseudoZ;
+    std::vector<float> m_pseudoAngX, m_pseudoAngY, m_pseudoAngZ;
+
+    std::vector<CachedImpulse> m_cache;     //sorted by key, then feature
+    std::vector<CachedImpulse> m_nextCache;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// hulls are meant for small collision shapes (a rock, a crate with bevels), building one is O(n^4)
+constexpr size_t MAX_HULL_VERTICES = 64;
+
+// convex shape in the body's local frame, built once per collider. the narrowphase walks the
+// vertices for support points and clips faces against each other for resting contacts
+struct ConvexHull {
+    std::vector<glm::vec3> vertices;    //only the corners, points inside or on a face are gone
+    std::vector<glm::vec4> planes;      //outward normal in xyz, dot(normal, p) <= w inside
+    //corners of face f (same order as planes) in order around it are
+    //faceVertices[faceStarts[f]] .. faceVertices[faceStarts[f + 1] - 1]
+    std::vector<uint32_t> faceVertices;
+    std::vector<uint32_t> faceStarts;
+    glm::vec3 halfExtents{ 0.0f };      //local bounds, symmetric around the body's center
+};
+
+// builds the hull of the points, which are taken to be around the body's center of mass.
+// fewer than 4 points or all of them on one plane gives an empty hull
+ConvexHull buildConvexHull(const std::vector<glm::vec3>& points);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Everything the physics math needs to round the same way on every run and every machine. Every
+// source file whose math feeds the simulation state (the step, collision, solver, broadphases, hulls,
+// islands, kernels, the body store) includes it before anything else, glm included, so the pragmas
+// cover the whole file. a new physics file has to do the same.
+//
+// a*b+c must not be fused into one fma, that rounds once instead of twice. msvc and clang are told
+// here, gcc only fuses outside strict iso mode so build with -std=c++17 (not gnu++17) or pass
+// -ffp-contract=off. the vcxproj pins /fp:precise for the same reason
+#if defined(_MSC_VER) && !defined(__clang__)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+#if defined(__FAST_MATH__)
+#error "the physics code relies on strict ieee float math, dont build it with -ffast-math"
+#endif
+
+
+// 64 bit FNV-1a fed whole 32 bit words instead of single bytes. not cryptographic, just enough that
+// two simulations that drifted apart by even one bit hash differently
+class StateHasher
+{
+public:
+    void add(uint32_t word) { m_hash = (m_hash ^ word) * PRIME; }
+    void add(uint64_t word) { add(static_cast<uint32_t>(word)); add(static_cast<uint32_t>(word >> 32)); }
+    void add(float value)
+    {
+        //the exact bit pattern, so -0 and 0 (or two nans) count as different
+        uint32_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        add(word);
+    }
+
+    template<typename T>
+    void add(const std::vector<T>& values)
+    {
+        add(static_cast<uint32_t>(values.size()));
+        for (const T& value : values) add(value);
+    }
+
+    uint64_t get() const { return m_hash; }
+
+private:
+    static constexpr uint64_t PRIME = 1099511628211ull;
+    uint64_t m_hash = 14695981039346656037ull;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Collision.h"
+#include "RigidBodyStore.h"
+#include "JobSystem.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cassert>
+
+// Dynamic bounding volume hierarchy broadphase. Every body is a leaf holding a "fat" box (its bounds
+// plus a margin), so small movements dont touch the tree at all. When a body leaves its fat box the
+// leaf is pulled out and reinserted where it grows the tree the least, and the ancestors are refit and
+// rotated on the way back up to keep it balanced. Unlike the grid it does not care how big bodies are
+class DynamicAABBTree
+{
+public:
+    static constexpr int NULL_NODE = -1;
+
+    explicit DynamicAABBTree(float margin = 0.1f);
+
+    // keeps one leaf per body in the store: adds new ones, moves ones that left their fat box, drops removed
+    void update(const RigidBodyStore& bodies);
+
+    // every pair of bodies whose boxes overlap, each reported once (a < b). the per body queries are
+    // split across the job system when one is given
+    void findPairs(const RigidBodyStore& bodies, std::vector<BodyPair>& out, JobSystem* jobs = nullptr) const;
+
+    void clear();
+
+    int createProxy(const AABB& bounds, BodyId body);
+    void destroyProxy(int proxy);
+    // returns true when the leaf had to be reinserted
+    bool moveProxy(int proxy, const AABB& bounds);
+
+    BodyId getBody(int proxy) const { return m_nodes[proxy].body; }
+    const AABB& getFatAABB(int proxy) const { return m_nodes[proxy].box; }
+    bool empty() const { return m_root == NULL_NODE; }
+    int getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+
+    // calls callback(proxy) for every leaf whose fat box overlaps, callback returns false to stop early
+    template<typename Callback>
+    void query(const AABB& box, Callback callback) const
+    {
+        int stack[STACK_SIZE];
+        int count = 0;
+        if (m_root != NULL_NODE) stack[count++] = m_root;
+
+        while (count > 0) {
+            const Node& node = m_nodes[stack[--count]];
+            if (!node.box.overlaps(box)) continue;
+
+            if (node.isLeaf()) {
+                if (!callback(static_cast<int>(&node - m_nodes.data()))) return;
+            }
+            else {
+                assert(count + 2 <= STACK_SIZE);
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+
+    // walks leaves whose fat box the ray passes through. callback(proxy, maxT) does the exact test and
+    // returns the new max distance: the hit distance to clip the ray, maxT to ignore, 0 to stop
+    template<typename Callback>
+    void raycast(const glm::vec3& origin, const glm::vec3& dir, float maxT, Callback callback) const
+    {
+        int stack[STACK_SIZE];
+        int count = 0;
+        if (m_root != NULL_NODE) stack[count++] = m_root;
+
+        while (count > 0) {
+            const Node& node = m_nodes[stack[--count]];
+
+            float t;
+            if (!Narrowphase::rayAABB(origin, dir, node.box.lower, node.box.upper, maxT, t)) continue;
+
+            if (node.isLeaf()) {
+                maxT = callback(static_cast<int>(&node - m_nodes.data()), maxT);
+                if (maxT <= 0.0f) return;
+            }
+            else {
+                assert(count + 2 <= STACK_SIZE);
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+
+private:
+    //a balanced tree over millions of leaves is still only a few dozen levels deep
+    static constexpr int STACK_SIZE = 256;
+
+    struct Node {
+        AABB box;
+        int parent = NULL_NODE;     //doubles as the free list link for unused nodes
+        int child1 = NULL_NODE;
+        int child2 = NULL_NODE;
+        int height = -1;            //leaves are 0, free nodes -1
+        BodyId body = INVALID_BODY;
+
+        bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refitUpwards(int node);
+
+    float m_margin;
+    int m_root = NULL_NODE;
+    int m_freeList = NULL_NODE;
+    std::vector<Node> m_nodes;
+
+    std::vector<int> m_proxyOf;     //indexed by BodyId
+
+    mutable std::vector<std::vector<BodyPair>> m_rangePairs;
+};
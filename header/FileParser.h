@@ -1,12 +1,25 @@
 #pragma once
 
-#include <iostream>
-#include <fstream> 
-#include <sstream>
+#include <cstddef>
 #include <string>
 #include <glm/glm.hpp>
 #include <vector>
+#include "MeshData.h"
 #include "Primitives.h"
 
+class JobSystem;
 
-void parseObj(const std::string& filePath, std::vector<Primitives::Vertex>& out_vertices);
+// Wavefront obj to a triangle soup, three vertices per triangle. The file is memory mapped and cut
+// into line aligned chunks that are parsed in parallel on jobs (one after another without), numbers
+// go through std::from_chars. faces may be v, v/vt, v//vn or v/vt/vn with any number of corners
+// (fanned into triangles) and negative (relative) indices. missing attributes come out as zero.
+// returns false when the file can't be read, bad lines are skipped with a warning
+bool parseObj(const std::string& filePath, std::vector<Primitives::Vertex>& out_vertices, JobSystem* jobs = nullptr);
+
+// same but indexed: corners with the same v/vt/vn triple share one vertex (first use order), which for
+// smooth models like the sphere leaves several times fewer vertices than the soup
+bool parseObj(const std::string& filePath, MeshData& out_mesh, JobSystem* jobs = nullptr);
+
+// both of the above on obj text that is already in memory
+bool parseObjText(const char* text, size_t size, std::vector<Primitives::Vertex>& out_vertices, JobSystem* jobs = nullptr);
+bool parseObjText(const char* text, size_t size, MeshData& out_mesh, JobSystem* jobs = nullptr);
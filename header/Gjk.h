@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Collision.h"
+#include <glm/glm.hpp>
+
+// GJK distance and EPA penetration between any two convex shapes, only going through support points.
+// the narrowphase falls back to this for pairs that have no hand written test.
+// rounded shapes are split into a core and a radius around it (a sphere is a point, a capsule a
+// segment, boxes and hulls have no radius) and these functions only ever look at the cores, which
+// keeps them exact for rounded shapes and away from GJK's weak spot of cores that barely touch
+namespace Gjk
+{
+    // core point furthest along dir, world space. dir does not have to be normalized
+    glm::vec3 support(const ShapeInstance& shape, const glm::vec3& dir);
+    float coreRadius(const ShapeInstance& shape);
+
+    struct Result {
+        glm::vec3 normal{ 0.0f };   //from a to b, moving b along it separates them
+        float separation = 0.0f;    //between the cores, negative (the EPA depth) when they overlap
+        glm::vec3 pointA{ 0.0f };   //closest (or deepest) points on each core
+        glm::vec3 pointB{ 0.0f };
+    };
+
+    // false when the answer can not be trusted: cores that overlap with no volume between them, or
+    // EPA running out of room. the caller should treat that as no contact this step
+    bool closestPoints(const ShapeInstance& a, const ShapeInstance& b, Result& out);
+}
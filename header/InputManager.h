@@ -1,20 +1,9 @@
 #pragma once
 
 #include "Camera.h"
+#include "InputState.h"
 #include <GLFW/glfw3.h>
 
-// A simple struct to hold the results of our input polling
-struct InputState {
-    bool shouldInteract = false;
-    bool toggleGravity = false; 
-    bool resetPosition = false; 
-
-   
-    bool saveState = false;
-    bool exitApp = false;
-    
-};
-
 // Manages all GLFW input and updates the camera
 class InputManager
 {
@@ -51,6 +40,7 @@ private:
     bool m_firstMouse = true;
     int m_lastGKeyState = GLFW_RELEASE;
     int m_lastRKeyState = GLFW_RELEASE;
+    int m_lastCKeyState = GLFW_RELEASE;
     int m_lastSKeyState = GLFW_RELEASE;
     int m_lastEscKeyState = GLFW_RELEASE;
 };
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+// A simple struct to hold the results of our input polling.
+// Kept apart from InputManager so Physics (and the headless bench) build without GLFW
+struct InputState {
+    bool shouldInteract = false;
+    bool toggleGravity = false; 
+    bool resetPosition = false; 
+    bool spawnCube = false;
+
+   
+    bool saveState = false;
+    bool exitApp = false;
+    
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Collision.h"
+#include "RigidBodyStore.h"
+#include <vector>
+#include <cstdint>
+
+// a group of awake dynamic bodies connected through contacts, plus those contacts. static bodies never
+// join islands (otherwise the ground would glue everything into one), their contacts just belong
+// to the island of the dynamic body they touch. sleeping bodies are left out the same way
+struct Island {
+    uint32_t bodyBegin = 0;     //range in IslandBuilder::getBodies()
+    uint32_t bodyCount = 0;
+    uint32_t contactBegin = 0;  //range in IslandBuilder::getContacts()
+    uint32_t contactCount = 0;
+};
+
+// Splits the contact graph into islands with a union-find over dense body indices. Bodies in different
+// islands share no contacts, so islands can be solved independently (and in parallel)
+class IslandBuilder
+{
+public:
+    // every contact needs at least one awake dynamic body, Physics wakes sleepers that get touched first
+    void build(const RigidBodyStore& bodies, const std::vector<Contact>& contacts);
+
+    const std::vector<Island>& getIslands() const { return m_islands; }
+    // dense body indices grouped by island
+    const std::vector<uint32_t>& getBodies() const { return m_bodies; }
+    // indices into the contact array given to build, grouped by island, original order within one
+    const std::vector<uint32_t>& getContacts() const { return m_contacts; }
+
+private:
+    uint32_t find(uint32_t body);
+    void unite(uint32_t a, uint32_t b);
+
+    std::vector<uint32_t> m_parent;
+    std::vector<uint32_t> m_islandOf;   //root body -> island index
+
+    std::vector<Island> m_islands;
+    std::vector<uint32_t> m_bodies;
+    std::vector<uint32_t> m_contacts;
+};
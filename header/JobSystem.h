@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small work stealing job scheduler. Every thread (the workers plus the thread that created the
+// system) owns a deque: jobs are pushed onto and popped off the back of your own deque, and an idle
+// thread steals from the front of someone else's. Waiting on a counter does not block, the waiting
+// thread keeps running jobs until the counter hits zero, so the main thread is one of the workers
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    // number of jobs still outstanding, wait() returns once it is back to zero
+    struct Counter {
+        std::atomic<int> pending{ 0 };
+    };
+
+    // hardware threads minus the one the caller is already using
+    static unsigned defaultWorkerCount();
+
+    explicit JobSystem(unsigned workerCount = defaultWorkerCount());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void run(Counter& counter, Job job);
+    void wait(Counter& counter);
+    // runs one queued job on the calling thread if there is any, for callers that wait on something
+    // other than a counter and want to help out meanwhile
+    bool tryRunOne() { return runOne(currentQueue()); }
+
+    // splits [0, count) into grain sized ranges and calls fn(begin, end) on each, returns when all are
+    // done. range k always starts at k * grain, so callers can keep one output buffer per range
+    template<typename Func>
+    void parallelFor(size_t count, size_t grain, Func&& fn)
+    {
+        if (grain == 0) grain = 1;
+        if (count <= grain || m_workers.empty()) {
+            if (count > 0) fn(size_t(0), count);
+            return;
+        }
+
+        Counter counter;
+        for (size_t begin = grain; begin < count; begin += grain) {
+            size_t end = begin + grain < count ? begin + grain : count;
+            run(counter, [&fn, begin, end]() { fn(begin, end); });
+        }
+        fn(size_t(0), grain);
+        wait(counter);
+    }
+
+    // workers plus the owning thread
+    unsigned getThreadCount() const { return static_cast<unsigned>(m_queues.size()); }
+    // 0 .. getThreadCount() - 1, stable per thread. 0 is the owning thread and any thread that is not
+    // one of the workers, so per thread data indexed by it is only safe for the owner and the workers
+    unsigned currentThreadIndex() const { return currentQueue(); }
+
+private:
+    struct Task {
+        Job job;
+        Counter* counter;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    unsigned currentQueue() const;
+    bool popOwn(unsigned queue, Task& task);
+    bool steal(unsigned thief, Task& task);
+    bool runOne(unsigned queue);
+    void workerLoop(unsigned queue);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;   //0 belongs to the thread that made the system
+    std::vector<std::thread> m_workers;
+
+    std::atomic<int> m_queued{ 0 };
+    std::atomic<bool> m_running{ true };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+};
+
+// runs fn(begin, end) over [0, count) on the job system, or inline when there is none
+template<typename Func>
+void parallelFor(JobSystem* jobs, size_t count, size_t grain, Func&& fn)
+{
+    if (jobs) jobs->parallelFor(count, grain, fn);
+    else if (count > 0) fn(size_t(0), count);
+}
+
+// how many grain sized ranges parallelFor cuts count into
+inline size_t rangeCount(size_t count, size_t grain)
+{
+    return grain == 0 ? count : (count + grain - 1) / grain;
+}
@@ -2,59 +2,79 @@
 
 #include <glad/glad.h>
 #include "FileParser.h" 
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "MeshSimplifier.h"
+#include "Camera.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 #include <iostream> 
 
 class Mesh
 {
 public:
-    Mesh(const std::string& modelPath)
+    // loads through the bake next to the model (writing it first if it is missing or stale), so the
+    // buffers are filled straight from the mapped file. jobs lets a big model parse in parallel,
+    // COMPACT uploads quantized vertices the shaders decode with the uniforms from getPositionOffset etc
+    Mesh(const std::string& modelPath, JobSystem* jobs = nullptr, VertexFormat format = VertexFormat::STANDARD)
     {
-        std::vector<Primitives::Vertex> vertices;
-        parseObj(modelPath, vertices);
-
-        if (vertices.empty()) {
+        BakedMesh baked;
+        if (!loadBakedMesh(modelPath, baked, jobs, format)) {
             std::cerr << "ERROR::MESH: Failed to load model or model is empty: " << modelPath << std::endl;
-            m_vertexCount = 0;
-            m_vao = 0;
-            m_vbo = 0;
             return;
         }
+        upload(baked.getBlobs());
+    }
 
-        m_vertexCount = static_cast<unsigned int>(vertices.size());
+    // uploads an open bake, which can be closed again right after
+    explicit Mesh(const BakedMesh& baked)
+    {
+        if (baked.isOpen()) upload(baked.getBlobs());
+    }
 
-        glGenVertexArrays(1, &m_vao);
-        glGenBuffers(1, &m_vbo);
+    explicit Mesh(const MeshData& data)
+    {
+        if (data.indices.empty()) return;
 
-        glBindVertexArray(m_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-            vertices.size() * sizeof(Primitives::Vertex),
-            vertices.data(),
-            GL_STATIC_DRAW);
-
-        //pos
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Primitives::Vertex), (void*)offsetof(Primitives::Vertex, position));
-        glEnableVertexAttribArray(0);
-        //tex cooridnates
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Primitives::Vertex), (void*)offsetof(Primitives::Vertex, texCoord));
-        glEnableVertexAttribArray(1);
-        //normals
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Primitives::Vertex), (void*)offsetof(Primitives::Vertex, normal));
-        glEnableVertexAttribArray(2);
+        MeshBlobs blobs;
+        blobs.vertices = data.vertices.data();
+        blobs.vertexCount = static_cast<uint32_t>(data.vertices.size());
+        blobs.vertexStride = sizeof(Primitives::Vertex);
+        blobs.indexCount = static_cast<uint32_t>(data.indices.size());
+        blobs.attributes = standardVertexLayout();
+        blobs.attributeCount = STANDARD_ATTRIBUTE_COUNT;
+        blobs.boundsMin = data.boundsMin;
+        blobs.boundsMax = data.boundsMax;
+        std::vector<MeshLod> lods = data.getLods();
+        blobs.lods = lods.data();
+        blobs.lodCount = static_cast<uint32_t>(lods.size());
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        std::vector<uint16_t> shortIndices;
+        if (data.fitsShortIndices()) {
+            shortIndices.assign(data.indices.begin(), data.indices.end());
+            blobs.indices = shortIndices.data();
+            blobs.indexSize = sizeof(uint16_t);
+        }
+        else {
+            blobs.indices = data.indices.data();
+            blobs.indexSize = sizeof(uint32_t);
+        }
+        upload(blobs);
     }
 
     ~Mesh()
     {
         glDeleteVertexArrays(1, &m_vao);
         glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ebo);
     }
 
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
     void bind() const {
         glBindVertexArray(m_vao);
     }
@@ -63,13 +83,121 @@ public:
         glBindVertexArray(0);
     }
 
+    // expects bind() first
+    void draw(size_t lod = 0) const {
+        if (m_lods.empty()) return;
+        const MeshLod& level = m_lods[std::min(lod, m_lods.size() - 1)];
+        size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        glDrawElements(GL_TRIANGLES, level.indexCount, m_indexType, (void*)(uintptr_t(level.indexOffset) * indexSize));
+    }
+
+    // the coarsest lod whose error stays under maxPixelError pixels on screen for this placement
+    size_t selectLod(const glm::mat4& model, const Camera& camera, int viewportHeight, float maxPixelError = 1.0f) const {
+        if (m_lods.size() <= 1) return 0;
+
+        glm::vec3 center = glm::vec3(model * glm::vec4((m_boundsMin + m_boundsMax) * 0.5f, 1.0f));
+        float worldScale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float radius = glm::length(m_boundsMax - m_boundsMin) * 0.5f * worldScale;
+        float distance = glm::length(camera.Position - center) - radius;
+        if (distance <= 0.0f) return 0; //inside the bounding sphere, full detail
+
+        return ::selectLod(m_lods.data(), m_lods.size(), distance, worldScale, glm::radians(camera.Zoom), viewportHeight, maxPixelError);
+    }
+
+    size_t getLodCount() const {
+        return m_lods.size();
+    }
+
     unsigned int getVertexCount() const {
         return m_vertexCount;
     }
 
+    unsigned int getIndexCount() const {
+        return m_indexCount;
+    }
+
+    // false when the model failed to load, draw() then does nothing
+    bool isLoaded() const {
+        return !m_lods.empty();
+    }
+
+    // sizes of the gpu buffers
+    size_t getVertexBytes() const {
+        return m_vertexBytes;
+    }
+
+    size_t getIndexBytes() const {
+        return m_indexBytes;
+    }
+
+    const glm::vec3& getBoundsMin() const { return m_boundsMin; }
+    const glm::vec3& getBoundsMax() const { return m_boundsMax; }
+
+    VertexFormat getFormat() const { return m_format; }
+    // model space position = positionOffset + positionScale * aPos, identity for STANDARD
+    glm::vec3 getPositionOffset() const { return m_format == VertexFormat::COMPACT ? m_boundsMin : glm::vec3(0.0f); }
+    glm::vec3 getPositionScale() const { return m_format == VertexFormat::COMPACT ? m_boundsMax - m_boundsMin : glm::vec3(1.0f); }
+    bool hasPackedNormals() const { return m_format == VertexFormat::COMPACT; }
+
 private:
+    static GLenum glType(AttributeType type)
+    {
+        switch (type) {
+        case AttributeType::FLOAT32: return GL_FLOAT;
+        case AttributeType::FLOAT16: return GL_HALF_FLOAT;
+        case AttributeType::UINT16: return GL_UNSIGNED_SHORT;
+        case AttributeType::INT16: return GL_SHORT;
+        }
+        return GL_FLOAT;
+    }
+
+    void upload(const MeshBlobs& blobs)
+    {
+        m_vertexCount = blobs.vertexCount;
+        m_indexCount = blobs.indexCount;
+        m_indexType = blobs.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        m_boundsMin = blobs.boundsMin;
+        m_boundsMax = blobs.boundsMax;
+        m_format = blobs.format;
+        m_vertexBytes = size_t(blobs.vertexCount) * blobs.vertexStride;
+        m_indexBytes = size_t(blobs.indexCount) * blobs.indexSize;
+        if (blobs.lods) m_lods.assign(blobs.lods, blobs.lods + blobs.lodCount);
+        else m_lods = { MeshLod{ 0, blobs.indexCount, 0.0f } };
+
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vbo);
+        glGenBuffers(1, &m_ebo);
+
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(m_vertexBytes), blobs.vertices, GL_STATIC_DRAW);
+
+        //the element buffer binding is vao state, so it stays bound with it
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(m_indexBytes), blobs.indices, GL_STATIC_DRAW);
+
+        //pos at 0, tex cooridnates at 1, normals at 2, whatever format the layout says they are in
+        for (uint32_t a = 0; a < blobs.attributeCount; a++) {
+            const VertexAttribute& attribute = blobs.attributes[a];
+            glVertexAttribPointer(attribute.location, attribute.components, glType(attribute.type),
+                attribute.normalized ? GL_TRUE : GL_FALSE, blobs.vertexStride, (void*)uintptr_t(attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
     GLuint m_vao = 0;
     GLuint m_vbo = 0;
     GLuint m_ebo = 0;
     GLuint m_vertexCount = 0;
-};
\ No newline at end of file
+    GLuint m_indexCount = 0;
+    GLenum m_indexType = GL_UNSIGNED_INT;
+    size_t m_vertexBytes = 0;
+    size_t m_indexBytes = 0;
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+    VertexFormat m_format = VertexFormat::STANDARD;
+    std::vector<MeshLod> m_lods;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "MappedFile.h"
+#include "MeshData.h"
+
+class JobSystem;
+
+// Binary bake of a parsed model, kept next to its source (sphere.txt -> sphere.txt.mesh, or
+// sphere.txt.packed.mesh for VertexFormat::COMPACT) so later launches map it and hand the blobs to
+// glBufferData without parsing or copying anything.
+// on disk, native (little) endian, every blob 64 byte aligned from the start of the file:
+//   BakedMeshHeader | VertexAttribute[attributeCount] | MeshLod[lodCount] | vertices | indices (16 bit
+//   when they fit, every lod back to back)
+// a bake is only used when its magic, version, vertex format and the source's size and content hash match, so
+// editing the obj or changing what goes into a bake (bump BAKED_MESH_VERSION) rebakes on next load
+const uint32_t BAKED_MESH_MAGIC = 0x48534D42; //"BMSH"
+const uint32_t BAKED_MESH_VERSION = 4;     //2: optimizeMesh order, 3: vertexFormat, 4: lods
+const uint32_t BAKED_MESH_ALIGNMENT = 64;
+const uint32_t BAKED_MESH_MAX_ATTRIBUTES = 8;
+const uint32_t BAKED_MESH_MAX_LODS = 8;
+
+struct BakedMeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t attributeCount;
+    VertexFormat vertexFormat;
+    uint32_t lodCount;
+    uint32_t reserved;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t attributeOffset;
+    uint64_t lodOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+};
+static_assert(std::is_trivially_copyable<BakedMeshHeader>::value, "the header is written and mapped as raw bytes");
+
+// a validated bake, either mapped from disk or (when it couldn't be written) held in memory
+class BakedMesh
+{
+public:
+    // maps bakePath and checks it against the source it claims to come from. false for a missing,
+    // truncated, foreign, old version, other format or stale bake
+    bool open(const std::string& bakePath, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format);
+    // takes an image built by serializeBakedMesh
+    bool adopt(std::vector<char>&& image);
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+    bool isMapped() const { return m_file.isOpen(); }
+    const BakedMeshHeader& getHeader() const { return *m_header; }
+    // pointers into the bake, valid while it stays open
+    MeshBlobs getBlobs() const;
+
+private:
+    bool validate(const char* data, size_t size, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format);
+
+    MappedFile m_file;
+    std::vector<char> m_memory;
+    const BakedMeshHeader* m_header = nullptr;
+};
+
+// 64 bit FNV-1a over the file contents, eight bytes at a time
+uint64_t hashContent(const char* data, size_t size);
+
+std::string bakedMeshPath(const std::string& sourcePath, VertexFormat format);
+
+// the whole bake file as bytes, vertices packed first for COMPACT
+std::vector<char> serializeBakedMesh(const MeshData& data, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format);
+
+// writes to a temporary name first and renames, so a crash never leaves a half bake that looks valid
+bool writeBakedMesh(const std::string& bakePath, const std::vector<char>& image);
+
+// what Mesh loads through: the bake if it matches the source, otherwise parse the source (on jobs),
+// build its lods, reorder it with optimizeMesh, write a fresh bake and use that. false only when the source itself
+// can't be read or has no faces
+bool loadBakedMesh(const std::string& sourcePath, BakedMesh& out, JobSystem* jobs = nullptr,
+                   VertexFormat format = VertexFormat::STANDARD);
+// the same for a source the caller already mapped and hashed (MeshRegistry needs the hash first)
+bool loadBakedMesh(const std::string& sourcePath, const MappedFile& source, uint64_t sourceHash, BakedMesh& out,
+                   JobSystem* jobs = nullptr, VertexFormat format = VertexFormat::STANDARD);
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Primitives.h"
+
+// one level of detail: a range of MeshData::indices into the shared vertex array, and how far (in
+// model units) its surface may be from the full mesh. written to bakes as is
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+};
+
+// Indexed triangle list the way it goes to the gpu: every distinct vertex once, three indices per
+// triangle. indices are kept 32 bit here, Mesh narrows them to 16 bit when the vertex count allows.
+// with lods, indices holds every level back to back (full detail first) and lods says where each is,
+// without them all of indices is the one level
+struct MeshData
+{
+    std::vector<Primitives::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    bool fitsShortIndices() const { return vertices.size() <= 0x10000; }
+    // of the full detail level
+    size_t triangleCount() const { return (lods.empty() ? indices.size() : lods[0].indexCount) / 3; }
+
+    std::vector<MeshLod> getLods() const
+    {
+        if (!lods.empty()) return lods;
+        return { MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+    }
+
+    void updateBounds()
+    {
+        if (vertices.empty()) {
+            boundsMin = boundsMax = glm::vec3(0.0f);
+            return;
+        }
+        boundsMin = boundsMax = vertices[0].position;
+        for (const Primitives::Vertex& vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+    }
+};
+
+// which vertex the gpu gets. STANDARD is Primitives::Vertex as is (32 bytes), COMPACT the 16 byte
+// PackedVertex from VertexPacking.h that the vertex shaders decode
+enum class VertexFormat : uint32_t {
+    STANDARD,
+    COMPACT,
+};
+
+// gl free description of one vertex attribute, so bake files can carry their layout and the headless
+// tools don't need a context. Mesh turns it into the glVertexAttribPointer call
+enum class AttributeType : uint32_t {
+    FLOAT32,
+    FLOAT16,
+    UINT16,
+    INT16,
+};
+
+struct VertexAttribute
+{
+    uint32_t location;
+    uint32_t components;
+    AttributeType type;
+    uint32_t normalized;    //0 or 1, fixed size since it is written to disk as is
+    uint32_t offset;
+};
+
+// bytes per component, 0 for a type this build doesn't know
+inline uint32_t attributeTypeSize(AttributeType type)
+{
+    switch (type) {
+    case AttributeType::FLOAT32: return 4;
+    case AttributeType::FLOAT16:
+    case AttributeType::UINT16:
+    case AttributeType::INT16: return 2;
+    }
+    return 0;
+}
+
+// the layout of Primitives::Vertex: position at 0, uv at 1, normal at 2 like the shaders expect
+const uint32_t STANDARD_ATTRIBUTE_COUNT = 3;
+inline const VertexAttribute* standardVertexLayout()
+{
+    static const VertexAttribute layout[STANDARD_ATTRIBUTE_COUNT] = {
+        { 0, 3, AttributeType::FLOAT32, 0, static_cast<uint32_t>(offsetof(Primitives::Vertex, position)) },
+        { 1, 2, AttributeType::FLOAT32, 0, static_cast<uint32_t>(offsetof(Primitives::Vertex, texCoord)) },
+        { 2, 3, AttributeType::FLOAT32, 0, static_cast<uint32_t>(offsetof(Primitives::Vertex, normal)) },
+    };
+    return layout;
+}
+
+// what Mesh uploads: raw pointers into a MeshData or straight into a memory mapped bake, nothing owned
+struct MeshBlobs
+{
+    const void* vertices = nullptr;
+    uint32_t vertexCount = 0;
+    uint32_t vertexStride = 0;
+    const void* indices = nullptr;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = 0;         //2 or 4 bytes
+    const VertexAttribute* attributes = nullptr;
+    uint32_t attributeCount = 0;
+    const MeshLod* lods = nullptr;  //null means one level covering every index
+    uint32_t lodCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    VertexFormat format = VertexFormat::STANDARD;
+};
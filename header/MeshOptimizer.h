@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+
+// Offline reordering of an indexed mesh for the gpu, all cpu and headless. The bake runs the whole
+// chain once per model, the individual passes are here for tools and the bench
+
+// how well an index order uses a post transform vertex cache, simulated as a fifo
+struct VertexCacheStats {
+    float acmr = 0.0f;      //vertex shader runs per triangle, 0.5 is the ideal for a big regular grid, 3 the worst
+    float atvr = 0.0f;      //vertex shader runs per vertex, 1 is the ideal
+};
+
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Forsyth's linear speed vertex cache optimisation: greedily emits the triangle whose vertices score
+// best on cache recency and on how few triangles they have left
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// cuts a cache optimised index order into clusters where restarting the cache costs little (the
+// cluster's miss rate stays within threshold of the whole run's) and sorts the clusters so the ones
+// facing outward from the mesh centre draw first, which lets them occlude the rest. threshold 1.05
+// trades at most about 5% acmr for less overdraw
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Primitives::Vertex>& vertices, float threshold = 1.05f);
+
+// renumbers vertices in the order the indices first use them so fetches walk memory forward. drops
+// vertices no triangle uses
+void optimizeVertexFetch(MeshData& mesh);
+
+struct MeshOptimizeReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// cache, then overdraw (both per lod), then fetch, the order they have to run in. the report is for
+// the full detail level
+MeshOptimizeReport optimizeMesh(MeshData& mesh);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MeshData.h"
+
+class JobSystem;
+class Mesh;
+class MeshRegistry;
+
+// what one loaded model costs
+struct MeshAssetInfo {
+    std::string path;               //canonical, the same file reached two ways is one asset
+    uint64_t contentHash = 0;
+    VertexFormat format = VertexFormat::STANDARD;
+    uint32_t references = 0;        //live handles
+    size_t vertexBytes = 0;         //gpu buffer sizes
+    size_t indexBytes = 0;
+
+    size_t getGpuBytes() const { return vertexBytes + indexBytes; }
+};
+
+// Counted reference to a mesh in a MeshRegistry. copies share the mesh, the last handle to go
+// unloads it. null when default constructed or when the model failed to load
+class MeshHandle
+{
+public:
+    MeshHandle() = default;
+    MeshHandle(const MeshHandle& other);
+    MeshHandle& operator=(const MeshHandle& other);
+    MeshHandle(MeshHandle&& other) noexcept;
+    MeshHandle& operator=(MeshHandle&& other) noexcept;
+    ~MeshHandle() { reset(); }
+
+    void reset();
+
+    Mesh* get() const;
+    Mesh* operator->() const { return get(); }
+    explicit operator bool() const { return m_registry != nullptr; }
+
+private:
+    friend class MeshRegistry;
+    MeshHandle(MeshRegistry* registry, uint32_t slot) : m_registry(registry), m_slot(slot) {}
+
+    MeshRegistry* m_registry = nullptr;
+    uint32_t m_slot = 0;
+};
+
+// Loads each model once however many entities draw it. assets are found by canonical path and vertex
+// format, and asking again for a file whose size and modification time haven't changed hands out
+// another handle to the mesh already on the gpu without reading the file. when they have changed the
+// file is hashed, the same content still shares the asset, an edited model loads as a new one next to
+// the old until that one's handles are gone. uploads and unloads are gl calls, so main thread only,
+// and every handle has to be released before the registry is destroyed
+class MeshRegistry
+{
+public:
+    explicit MeshRegistry(JobSystem* jobs = nullptr) : m_jobs(jobs) {}
+    ~MeshRegistry();
+
+    MeshRegistry(const MeshRegistry&) = delete;
+    MeshRegistry& operator=(const MeshRegistry&) = delete;
+
+    // the mesh for this model (through its bake, see loadBakedMesh), a null handle if it can't be loaded
+    MeshHandle load(const std::string& modelPath, VertexFormat format = VertexFormat::STANDARD);
+
+    size_t getAssetCount() const { return m_assets.size() - m_freeSlots.size(); }
+    // every loaded asset's buffers together
+    size_t getGpuBytes() const { return m_gpuBytes; }
+    std::vector<MeshAssetInfo> getAssets() const;
+
+private:
+    friend class MeshHandle;
+
+    struct AssetKey {
+        std::string path;
+        VertexFormat format;
+
+        bool operator==(const AssetKey& other) const { return format == other.format && path == other.path; }
+    };
+
+    struct AssetKeyHash {
+        size_t operator()(const AssetKey& key) const;
+    };
+
+    //slots are reused once unloaded, handles only hold the index so growing m_assets is fine
+    struct Asset {
+        std::unique_ptr<Mesh> mesh;     //null while the slot is free
+        MeshAssetInfo info;
+        uint64_t fileSize = 0;          //what the file looked like when contentHash was taken
+        int64_t fileTime = 0;
+    };
+
+    void retain(uint32_t slot);
+    void release(uint32_t slot);
+
+    JobSystem* m_jobs;
+    std::vector<Asset> m_assets;
+    std::vector<uint32_t> m_freeSlots;
+    std::unordered_map<AssetKey, uint32_t, AssetKeyHash> m_lookup;    //newest asset per file and format
+    size_t m_gpuBytes = 0;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+
+// Quadric error metric simplification (Garland & Heckbert) for building lods at bake time. Edges are
+// collapsed cheapest first, always onto one of their two end points, so every level indexes the same
+// vertex buffer as the full mesh. vertices sharing a position (uv or normal seams, hard edges) move
+// together so collapses never tear the surface open, and open borders are held in place by extra
+// planes. collapses that would flip a triangle or pinch the surface into a non manifold are skipped
+
+// fractions of the full triangle count generateLods aims for by default
+constexpr float DEFAULT_LOD_RATIOS[] = { 0.5f, 0.25f, 0.125f };
+constexpr size_t DEFAULT_LOD_RATIO_COUNT = sizeof(DEFAULT_LOD_RATIOS) / sizeof(DEFAULT_LOD_RATIOS[0]);
+// smaller meshes gain nothing from lods
+const size_t MIN_LOD_TRIANGLES = 64;
+
+// collapses edges until at most targetIndexCount indices are left or no valid collapse remains.
+// returns the error: the largest rms distance (model units) between a collapsed vertex and the planes
+// of the surface it stands in for
+float simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Primitives::Vertex>& vertices,
+                   size_t targetIndexCount, std::vector<uint32_t>& out);
+
+// appends one level per ratio to mesh.indices and fills mesh.lods, level 0 being the full mesh with
+// error 0. one simplification carries on from level to level, each error is still against the full
+// mesh. stops early once a level barely shrinks
+void generateLods(MeshData& mesh, const float* ratios = DEFAULT_LOD_RATIOS, size_t ratioCount = DEFAULT_LOD_RATIO_COUNT);
+
+// the coarsest level whose error projects to at most maxPixelError pixels. distance is from the eye to
+// the closest point of the mesh's bounding sphere, worldScale the model matrix's largest axis scale
+// and fovY the vertical field of view in radians
+size_t selectLod(const MeshLod* lods, size_t lodCount, float distance, float worldScale, float fovY,
+                 int viewportHeight, float maxPixelError = 1.0f);
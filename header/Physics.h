@@ -1,9 +1,33 @@
 #pragma once
 
 #include "Components.h"
-#include "InputManager.h" 
+#include "InputState.h"
+#include "RigidBodyStore.h"
+#include "PhysicsKernels.h"
+#include "Collision.h"
+#include "CollisionDispatch.h"
+#include "SpatialHashGrid.h"
+#include "DynamicAABBTree.h"
+#include "Islands.h"
+#include "ContactSolver.h"
+#include "JobSystem.h"
+#include "Registry.h"
+#include "SceneComponents.h"
+#include <array>
+#include <vector>
 
 
+enum class BroadphaseType {
+    GRID,   //uniform hash grid, best when bodies are roughly the same size
+    BVH     //dynamic aabb tree, copes with mixed sizes and also answers ray/box queries
+};
+
+struct RayHit {
+    BodyId body = INVALID_BODY;
+    float distance = 0.0f;
+    glm::vec3 point{ 0.0f };
+};
+
 
 class Physics
 {
@@ -11,17 +35,119 @@ class Physics
 
     bool m_gravityEnabled = false;
 
+    bool m_deterministic = false;
+    float m_deterministicStep = 0.0f;  //the step size the first deterministic update used
+    uint64_t m_stepCount = 0;
+    uint64_t m_stateHash = 0;
+
+    std::vector<ImpactEvent> m_impacts;
+    std::vector<float> m_planeSeparation; //per body scratch the plane kernel writes into
+
+    PhysicsKernels::Backend m_backend;
+
+    BroadphaseType m_broadphase = BroadphaseType::GRID;
+    SpatialHashGrid m_grid;
+    DynamicAABBTree m_tree;
+    std::vector<BodyPair> m_pairs;
+    //m_pairs regrouped by shape pair type, batch t is [m_batchStarts[t], m_batchStarts[t + 1])
+    std::vector<BodyPair> m_batchedPairs;
+    std::vector<uint8_t> m_pairTypes;
+    std::array<size_t, CollisionDispatch::PAIR_TYPE_COUNT + 1> m_batchStarts{};
+    std::vector<BodyId> m_ccdCandidates;  //scratch, boxes near a fast body's path
+    std::vector<Contact> m_contacts;
+    IslandBuilder m_islands;
+    ContactSolver m_solver;
+
+    //an island falls asleep once all its bodies stayed slower than m_sleepSpeed for m_timeToSleep
+    bool m_sleepingEnabled = true;
+    float m_sleepSpeed = 0.15f;
+    float m_timeToSleep = 0.5f;
+    std::vector<BodyId> m_wakeIslands;  //scratch, sleep islands that got a body woken this step
+
+    //optional, without one every stage just runs on the calling thread
+    JobSystem* m_jobs = nullptr;
+
+    //one output buffer per parallelFor range, merged in range order so results dont depend on scheduling
+    std::vector<std::vector<Contact>> m_rangeContacts;
+    std::vector<std::vector<ImpactEvent>> m_rangeImpacts;
 
    
-    void solveSpherePlaneCollision(GlowingOrb& orb, Plane& plane);
-    void solveCubePlaneCollision(Cube& cube, Plane& plane);
+    PhysicsKernels::BodyArrays bodyArrays(RigidBodyStore& bodies);
+    void integrate(RigidBodyStore& bodies, float deltaTime);
+    void solveContinuous(RigidBodyStore& bodies, const Plane& plane, float deltaTime);
+    void updatePlaneSeparation(RigidBodyStore& bodies, const Plane& plane);
+
+    void solveCollisions(RigidBodyStore& bodies, const Plane& plane, float deltaTime);
+    void wakeTouched(RigidBodyStore& bodies);
+    void wakeIslands(RigidBodyStore& bodies);
+    void updateSleep(RigidBodyStore& bodies, const Island& island, float deltaTime) const;
+    bool rayTestBody(const RigidBodyStore& bodies, uint32_t index, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, float& t) const;
+    // sorts m_pairs into m_batchedPairs by shape pair type
+    void batchPairs(const RigidBodyStore& bodies);
 
 
 public:
     Physics();
 
-    void update(GlowingOrb& orb, Plane& plane, Cube* cube, const InputState& input, float deltaTime);
+    // deterministic mode: pairs are sorted before the narrowphase so nothing depends on hash map or
+    // thread order, and the full state is hashed after every step. two runs (or two processes, or
+    // two machines) that start from the same state and step with the same fixed dt and input report
+    // the same hash every step, so comparing hashes is enough to catch a desync.
+    // the rest of the pipeline is already order stable: parallel stages merge per range output in
+    // range order and every simd backend rounds like the scalar one
+    void setDeterministic(bool isEnabled) { m_deterministic = isEnabled; m_deterministicStep = 0.0f; }
+    bool getDeterministic() const { return m_deterministic; }
+    // hash after the most recent update, only kept up to date in deterministic mode
+    uint64_t getStateHash() const { return m_stateHash; }
+    uint64_t getStepCount() const { return m_stepCount; }
+    // hash of bodies plus the state physics itself carries between steps (gravity, warm start cache)
+    uint64_t computeStateHash(const RigidBodyStore& bodies) const;
+
+    // edge triggered input (gravity toggle), applied once per frame rather than once per fixed step
+    void applyInput(RigidBodyStore& bodies, const InputState& input);
+
+    void update(RigidBodyStore& bodies, const Plane& plane, float deltaTime);
+
+    // interaction charge/decay of every orb (GlowingOrb + RigidBody), only the orb whose body is
+    // interactingBody charges. touches no physics state, so it can run alongside update
+    static void decayEnergy(Registry& registry, BodyId interactingBody, float deltaTime);
+    // energy the orbs picked up from impacts (getImpacts, or several steps' worth of them)
+    static void absorbImpacts(Registry& registry, const std::vector<ImpactEvent>& impacts);
+
+    // closest body along the ray (dir normalized). uses the tree when the bvh broadphase is active,
+    // otherwise it has to test every body
+    bool raycast(const RigidBodyStore& bodies, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, RayHit& hit) const;
+    // every body whose bounds overlap the box, same tree/scan split as raycast
+    void queryAABB(const RigidBodyStore& bodies, const AABB& box, std::vector<BodyId>& out) const;
+
+    const std::vector<ImpactEvent>& getImpacts() const { return m_impacts; }
+    const std::vector<Contact>& getContacts() const { return m_contacts; }
+
+    SpatialHashGrid& getGrid() { return m_grid; }
+    DynamicAABBTree& getTree() { return m_tree; }
+
+    // integration, pair finding, narrowphase and island solving get spread over it
+    void setJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+    JobSystem* getJobSystem() const { return m_jobs; }
+
+    void setBroadphase(BroadphaseType type);
+    BroadphaseType getBroadphase() const { return m_broadphase; }
     
+    // turning sleeping off only stops new islands from falling asleep, RigidBodyStore::wakeAll wakes the rest
+    void setSleepingEnabled(bool isEnabled) { m_sleepingEnabled = isEnabled; }
+    bool getSleepingEnabled() const { return m_sleepingEnabled; }
+    void setSleepSpeed(float speed) { m_sleepSpeed = speed; }
+    float getSleepSpeed() const { return m_sleepSpeed; }
+    void setTimeToSleep(float seconds) { m_timeToSleep = seconds; }
+    float getTimeToSleep() const { return m_timeToSleep; }
+
+    // contact solver knobs: iterations, warm starting, position correction, friction, restitution
+    SolverSettings& getSolverSettings() { return m_solver.getSettings(); }
+
     void setGravity(bool isEnabled) { m_gravityEnabled = isEnabled; }
     bool getGravityState() const { return m_gravityEnabled; }
+
+    // defaults to the widest simd the cpu has, mostly here so benchmarks can compare
+    void setKernelBackend(PhysicsKernels::Backend backend) { m_backend = backend; }
+    PhysicsKernels::Backend getKernelBackend() const { return m_backend; }
 };
\ No newline at end of file
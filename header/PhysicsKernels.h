@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Determinism.h"
+#include "Components.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Per body physics loops written against raw structure of arrays pointers, with scalar, SSE (4 wide)
+// and AVX2 (8 wide) versions. Which one runs is picked once at startup from what the CPU supports,
+// every backend gives the same result so the choice never changes the simulation
+namespace PhysicsKernels
+{
+    enum class Backend {
+        SCALAR,
+        SSE,
+        AVX2
+    };
+
+    // pointers into RigidBodyStore arrays (plus a plane separation scratch array), all count long
+    struct BodyArrays {
+        float* posX; float* posY; float* posZ;
+        float* velX; float* velY; float* velZ;
+        const float* forceX; const float* forceY; const float* forceZ;
+        const float* inverseMass;
+        float* rotW; float* rotX; float* rotY; float* rotZ;
+        float* angVelX; float* angVelY; float* angVelZ;
+        const float* torqueX; const float* torqueY; const float* torqueZ;
+        const float* invInertiaX; const float* invInertiaY; const float* invInertiaZ;
+        float* invInertiaXX; float* invInertiaXY; float* invInertiaXZ;
+        float* invInertiaYY; float* invInertiaYZ; float* invInertiaZZ;
+        const float* radius;
+        const float* halfX; const float* halfY; const float* halfZ;
+        float* extentX; float* extentY; float* extentZ;
+        const EquilibriumState* state;
+        float* planeSeparation;     //written by planeSeparation, gap between the body and the plane
+        size_t count;
+    };
+
+    struct PlaneParams {
+        glm::vec3 normal;
+        float distance;         //plane offset along the normal
+    };
+
+    // what planeSeparation writes for bodies it skips, far enough that nothing treats it as a contact
+    constexpr float NO_SEPARATION = 3.0e38f;
+
+    // best backend the cpu (and os) supports
+    Backend detectBackend();
+    const char* backendName(Backend backend);
+
+    // semi implicit euler over bodies [begin, end), sleeping bodies are skipped
+    void integrate(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, float gravity, float deltaTime);
+
+    // the rotating half of integrate: torque into angular velocity through the cached world inverse
+    // inertia, angular velocity into the orientation quaternion (renormalized), then the world inertia
+    // and bounds extents are rebuilt from the new orientation. the gyroscopic term is left out, it
+    // only matters for long thin bodies spinning fast. static and sleeping bodies are skipped
+    void integrateAngular(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, float deltaTime);
+
+    // signed gap between each body's bounds and the plane (negative when it sinks in), the contact
+    // solver turns the close ones into plane contacts. static and sleeping bodies get NO_SEPARATION
+    void planeSeparation(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, const PlaneParams& plane);
+}
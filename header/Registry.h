@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 32 bit entity handle, the low 20 bits pick a slot and the high 12 count how often that slot was
+// reused. a handle whose generation no longer matches its slot is dead, so holding on to one after
+// the entity is destroyed is safe, it just stops being valid
+using Entity = uint32_t;
+
+constexpr uint32_t ENTITY_INDEX_BITS = 20;
+constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+constexpr uint32_t ENTITY_GENERATION_MASK = 0xFFFu;
+//the last index is never handed out, so no live entity can look like NULL_ENTITY
+constexpr uint32_t MAX_ENTITIES = ENTITY_INDEX_MASK;
+constexpr Entity NULL_ENTITY = 0xFFFFFFFFu;
+
+inline uint32_t entityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+inline uint32_t entityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+inline Entity makeEntity(uint32_t index, uint32_t generation) { return (generation << ENTITY_INDEX_BITS) | index; }
+
+
+// archetype storage is cut into chunks this big, each column starts on its own cache line
+constexpr size_t CHUNK_BYTES = 16 * 1024;
+constexpr size_t CHUNK_ALIGNMENT = 64;
+
+// one bit per component type, so at most 64 types
+using ComponentMask = uint64_t;
+constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+
+// what the registry needs to move a component around without knowing its type
+struct ComponentInfo {
+    size_t size;
+    size_t alignment;
+    void (*relocate)(void* destination, void* source);  //move construct into destination, then destroy source
+    void (*destroy)(void* component);
+};
+
+namespace ComponentTypes
+{
+    uint32_t registerType(const ComponentInfo& info);
+    const ComponentInfo& info(uint32_t id);
+
+    // small dense number per component type, handed out the first time a type is used
+    template<typename T>
+    uint32_t id()
+    {
+        static const uint32_t typeId = registerType({
+            sizeof(T),
+            alignof(T),
+            [](void* destination, void* source) {
+                T* from = static_cast<T*>(source);
+                new (destination) T(std::move(*from));
+                from->~T();
+            },
+            [](void* component) { static_cast<T*>(component)->~T(); }
+        });
+        return typeId;
+    }
+
+    template<typename... Ts>
+    ComponentMask mask() { return (ComponentMask(0) | ... | (ComponentMask(1) << id<Ts>())); }
+}
+
+
+// Every entity with exactly the same set of components lives in the same archetype, one row each.
+// Rows are packed into 16KB chunks and each chunk holds one array per component, so a query walks
+// a few arrays that are contiguous per chunk instead of chasing one pointer per entity.
+// rows stay packed: removing one moves the last row into the hole
+class Archetype
+{
+public:
+    explicit Archetype(ComponentMask mask);
+    ~Archetype();
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    ComponentMask mask() const { return m_mask; }
+    bool has(uint32_t componentId) const { return (m_mask >> componentId) & 1; }
+    const std::vector<uint32_t>& components() const { return m_components; }
+
+    size_t size() const { return m_count; }
+    uint32_t chunkCapacity() const { return m_capacity; }
+    size_t chunkCount() const { return m_chunks.size(); }
+    uint32_t chunkSize(size_t chunk) const
+    {
+        return chunk + 1 < m_chunks.size() ? m_capacity : static_cast<uint32_t>(m_count - chunk * m_capacity);
+    }
+
+    Entity* entities(size_t chunk) { return reinterpret_cast<Entity*>(m_chunks[chunk]); }
+    void* column(size_t chunk, uint32_t componentId) { return m_chunks[chunk] + m_offsets[componentId]; }
+    template<typename T>
+    T* column(size_t chunk) { return static_cast<T*>(column(chunk, ComponentTypes::id<T>())); }
+
+    Entity entityAt(uint32_t row) const { return reinterpret_cast<const Entity*>(m_chunks[row / m_capacity])[row % m_capacity]; }
+    void* at(uint32_t row, uint32_t componentId)
+    {
+        return m_chunks[row / m_capacity] + m_offsets[componentId] + (row % m_capacity) * ComponentTypes::info(componentId).size;
+    }
+
+    // new row at the end with every component left unconstructed, the caller fills them in
+    uint32_t addRow(Entity entity);
+    // moves the last row into row and shrinks by one. the components of row must already be destroyed
+    // or moved out. returns the entity that now sits at row, NULL_ENTITY when row was the last one
+    Entity removeRow(uint32_t row);
+
+private:
+    ComponentMask m_mask;
+    std::vector<uint32_t> m_components;
+    uint32_t m_offsets[MAX_COMPONENT_TYPES] = {};   //byte offset of each column inside a chunk
+    uint32_t m_capacity = 0;                        //rows per chunk
+    std::vector<std::byte*> m_chunks;
+    size_t m_count = 0;
+};
+
+
+// Owns every entity and the archetypes their components live in. Entities are just handles, adding or
+// removing a component moves the entity's row to the archetype for its new set of components.
+// Queries (each, eachChunk) are cached per component set, a cache only has to look at archetypes made
+// since it was last used, so the per frame cost is a walk over the matching chunks and nothing else.
+// structural changes (create, destroy, emplace, remove) are not allowed while a query is running,
+// and they move components around, so references from get() only last until the next one.
+// any number of threads may run queries at once as long as none of them makes a structural change
+class Registry
+{
+public:
+    Registry();
+
+    // NULL_ENTITY once MAX_ENTITIES are alive
+    Entity create();
+    // destroys every component of the entity, its handle (and every copy of it) stops being valid
+    void destroy(Entity entity);
+    bool valid(Entity entity) const
+    {
+        uint32_t index = entityIndex(entity);
+        return entity != NULL_ENTITY && index < m_records.size() && m_records[index].generation == entityGeneration(entity) &&
+               m_records[index].archetype != NO_ARCHETYPE;
+    }
+    size_t alive() const { return m_records.size() - m_freeSlots.size(); }
+
+    template<typename T, typename... Args>
+    T& emplace(Entity entity, Args&&... args)
+    {
+        assert(valid(entity) && !has<T>(entity));
+        uint32_t id = ComponentTypes::id<T>();
+        const EntityRecord& record = m_records[entityIndex(entity)];
+        moveEntity(entity, findOrCreateArchetype(m_archetypes[record.archetype]->mask() | (ComponentMask(1) << id)));
+
+        void* slot = m_archetypes[record.archetype]->at(record.row, id);
+        return *new (slot) T{ std::forward<Args>(args)... };
+    }
+
+    template<typename T>
+    void remove(Entity entity)
+    {
+        if (!has<T>(entity)) return;
+        const EntityRecord& record = m_records[entityIndex(entity)];
+        moveEntity(entity, findOrCreateArchetype(m_archetypes[record.archetype]->mask() & ~ComponentTypes::mask<T>()));
+    }
+
+    template<typename T>
+    bool has(Entity entity) const
+    {
+        return valid(entity) && m_archetypes[m_records[entityIndex(entity)].archetype]->has(ComponentTypes::id<T>());
+    }
+
+    template<typename T>
+    T& get(Entity entity)
+    {
+        assert(has<T>(entity));
+        const EntityRecord& record = m_records[entityIndex(entity)];
+        return *static_cast<T*>(m_archetypes[record.archetype]->at(record.row, ComponentTypes::id<T>()));
+    }
+
+    template<typename T>
+    T* tryGet(Entity entity) { return has<T>(entity) ? &get<T>(entity) : nullptr; }
+
+    // every archetype that has all of the components, in the order they were made
+    template<typename... Ts>
+    const std::vector<Archetype*>& query() { return query(ComponentTypes::mask<Ts...>()); }
+    const std::vector<Archetype*>& query(ComponentMask mask);
+
+    // fn(count, entities, columns...) once per chunk that has all of the components, for loops that
+    // want whole arrays (simd, prefetching, handing chunks to jobs)
+    template<typename... Ts, typename Func>
+    void eachChunk(Func&& fn)
+    {
+        IterationScope scope(*this);
+        for (Archetype* archetype : query<Ts...>()) {
+            for (size_t chunk = 0; chunk < archetype->chunkCount(); chunk++) {
+                fn(size_t(archetype->chunkSize(chunk)), static_cast<const Entity*>(archetype->entities(chunk)),
+                   archetype->template column<Ts>(chunk)...);
+            }
+        }
+    }
+
+    // fn(entity, components...) for every entity that has all of the components
+    template<typename... Ts, typename Func>
+    void each(Func&& fn)
+    {
+        eachChunk<Ts...>([&](size_t count, const Entity* entities, Ts*... columns) {
+            for (size_t i = 0; i < count; i++) {
+                fn(entities[i], columns[i]...);
+            }
+        });
+    }
+
+    size_t archetypeCount() const { return m_archetypes.size(); }
+
+private:
+    static constexpr uint32_t NO_ARCHETYPE = 0xFFFFFFFFu;
+
+    struct EntityRecord {
+        uint32_t generation = 0;
+        uint32_t archetype = NO_ARCHETYPE;
+        uint32_t row = 0;
+    };
+
+    struct QueryCache {
+        std::vector<Archetype*> archetypes;
+        size_t archetypesSeen = 0;
+    };
+
+    // catches structural changes made from inside a query in debug builds
+    struct IterationScope {
+        Registry& registry;
+        explicit IterationScope(Registry& owner) : registry(owner) { registry.m_iterating++; }
+        ~IterationScope() { registry.m_iterating--; }
+    };
+
+    uint32_t findOrCreateArchetype(ComponentMask mask);
+    // moves the entity's row into target, components target does not have are destroyed and the ones
+    // only target has are left unconstructed
+    void moveEntity(Entity entity, uint32_t target);
+
+    std::vector<EntityRecord> m_records;    //indexed by entityIndex
+    std::vector<uint32_t> m_freeSlots;      //destroyed slots waiting to be reused, last in first out
+    std::vector<std::unique_ptr<Archetype>> m_archetypes;  //0 is the empty one new entities start in
+    std::unordered_map<ComponentMask, uint32_t> m_archetypeOf;
+    std::unordered_map<ComponentMask, QueryCache> m_queries;
+    std::mutex m_queryMutex;            //systems on different threads query at the same time
+    std::atomic<int> m_iterating{ 0 };
+};
@@ -4,7 +4,21 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "Window.h"
+#include "Registry.h"
+#include "SceneComponents.h"
+#include "Components.h"
 #include <glm/glm.hpp>
+#include <vector>
+
+// one draw worth of state, pulled out of the registry so drawing itself needs nothing else
+struct DrawItem {
+    Mesh* mesh;
+    Shader* shader;
+    glm::mat4 model;
+    glm::vec3 color;
+    float energy;
+    bool glows;     //orbs get the energy uniform instead of a color
+};
 
 class Renderer
 {
@@ -28,12 +42,22 @@ public:
 
         shader->setMat4("model", model);
 
+        //always set, uniforms default to zero and that would collapse a STANDARD mesh to a point
+        shader->setVec3("positionOffset", mesh->getPositionOffset());
+        shader->setVec3("positionScale", mesh->getPositionScale());
+        shader->setBool("packedNormals", mesh->hasPackedNormals());
+
         setUniforms(*shader);
 
         mesh->bind();
-        glDrawArrays(GL_TRIANGLES, 0, mesh->getVertexCount());
+        mesh->draw(m_camera ? mesh->selectLod(model, *m_camera, m_viewportHeight) : 0);
     }
 
+    // collects every entity with a Renderable and a Transform. touches no gl, so it can run on any thread
+    static void extract(Registry& registry, std::vector<DrawItem>& out);
+    // draws what extract collected, on the thread that owns the context
+    void submit(const std::vector<DrawItem>& items);
+
     void endFrame();
 
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -42,4 +66,6 @@ private:
     glm::mat4 m_projection;
     glm::mat4 m_view;
     glm::vec3 m_viewPos; 
+    const Camera* m_camera = nullptr;  //the one beginFrame got, for lod selection
+    int m_viewportHeight = 0;
 };
\ No newline at end of file
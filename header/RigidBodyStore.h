@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Determinism.h"
+#include "Components.h"
+#include "ConvexHull.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+using BodyId = uint32_t;
+constexpr BodyId INVALID_BODY = 0xFFFFFFFFu;
+
+// what a body looks like when it is spawned, the store only keeps the parts the sim needs
+struct BodyDesc {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 angularVelocity = glm::vec3(0.0f);
+    float mass = 1.0f;              //0 means static/immovable
+    uint32_t collider = 0;          //index returned by RigidBodyStore::addCollider
+};
+
+// Structure of arrays storage for every simulated body. Each field lives in its own contiguous array,
+// all indexed by the same dense index, so the integrator and the collision passes are plain loops over
+// floats instead of hopping between GlowingOrb/Cube structs. Removing a body swaps the last one into
+// its slot, BodyIds stay valid through that via the id <-> index tables
+class RigidBodyStore
+{
+public:
+    // colliders are shared, a thousand identical spheres only need one entry. convex hull colliders
+    // get their hull built here, once
+    uint32_t addCollider(const Collider& collider);
+    const Collider& getCollider(uint32_t index) const { return m_colliders[index]; }
+    // empty for every collider that is not a CONVEX_HULL
+    const ConvexHull& getHull(uint32_t colliderIndex) const { return m_hulls[colliderIndex]; }
+    size_t colliderCount() const { return m_colliders.size(); }
+
+    BodyId add(const BodyDesc& desc);
+    // the id goes back on the free list right away, so anything keyed on it has to go through
+    // getRemovedIds before the next step (Physics::update does)
+    void remove(BodyId id);
+    void clear();
+    void reserve(size_t count);
+
+    size_t size() const { return m_ids.size(); }
+    bool contains(BodyId id) const { return id < m_indexOf.size() && m_indexOf[id] != INVALID_BODY; }
+    uint32_t indexOf(BodyId id) const { return m_indexOf[id]; }
+    BodyId idAt(uint32_t index) const { return m_ids[index]; }
+
+    glm::vec3 getPosition(BodyId id) const;
+    glm::vec3 getVelocity(BodyId id) const;
+    void setVelocity(BodyId id, const glm::vec3& velocity);
+    // instant change in momentum, does nothing to static bodies
+    void applyImpulse(BodyId id, const glm::vec3& impulse);
+    // same but hitting the body at a world space point, so it spins too
+    void applyImpulse(BodyId id, const glm::vec3& impulse, const glm::vec3& point);
+
+    glm::quat getOrientation(BodyId id) const;
+    void setOrientation(BodyId id, const glm::quat& orientation);
+    glm::vec3 getAngularVelocity(BodyId id) const;
+    void setAngularVelocity(BodyId id, const glm::vec3& angularVelocity);
+
+    // moves a body without it being interpolated from the old spot, also wakes it
+    void teleport(BodyId id, const glm::vec3& position);
+
+    // everything that changes a body from outside the step (the setters above) wakes it, and the next
+    // Physics::update wakes whatever island it was sleeping in along with it
+    void wake(BodyId id);
+    void wakeAll();
+    bool isSleeping(BodyId id) const { return state[m_indexOf[id]] == EquilibriumState::SLEEPING; }
+    // awake and dynamic (dense index), the only bodies a step has to do anything for
+    bool isActive(uint32_t index) const { return inverseMass[index] > 0.0f && state[index] == EquilibriumState::AWAKE; }
+
+    // copies current positions and orientations into the previous ones, called right before each fixed step
+    void storePrevious();
+    glm::vec3 getInterpolatedPosition(BodyId id, float alpha) const;
+    glm::quat getInterpolatedOrientation(BodyId id, float alpha) const;
+
+    // rotation matrix of body i (dense index)
+    glm::mat3 rotationAt(uint32_t index) const;
+    // refreshes the cached world inertia and bounds of body i after its orientation changed outside
+    // the integrator
+    void updateDerived(uint32_t index);
+
+    void clearVelocities();
+    void clearForces();
+
+    // ids removed since the last clearRemovedIds, a body added meanwhile may already have one of them
+    const std::vector<BodyId>& getRemovedIds() const { return m_removedIds; }
+    void clearRemovedIds() { m_removedIds.clear(); }
+
+    // feeds everything a step reads (ids in dense order, positions, orientations, velocities, forces,
+    // mass, shape, sleep state) into the hasher. previous positions are left out, only rendering uses them
+    void hashState(StateHasher& hasher) const;
+
+    //per body data, every array is size() long and indexed by the dense index
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> prevX, prevY, prevZ;
+    std::vector<float> velX, velY, velZ;
+    std::vector<float> forceX, forceY, forceZ;
+    std::vector<float> inverseMass;
+
+    //orientation as a unit quaternion, split per component like everything else
+    std::vector<float> rotW, rotX, rotY, rotZ;
+    std::vector<float> prevRotW, prevRotX, prevRotY, prevRotZ;
+    std::vector<float> angVelX, angVelY, angVelZ;
+    std::vector<float> torqueX, torqueY, torqueZ;
+    //inverse inertia in the body's own frame, spheres and boxes only need the diagonal. 0 for
+    //static bodies and for AABB shapes, which are not allowed to turn
+    std::vector<float> invInertiaX, invInertiaY, invInertiaZ;
+    //the same tensor rotated into world space, symmetric so 6 numbers. the integrator refreshes it
+    //every step, everything after that (solver) reads the cached one
+    std::vector<float> invInertiaXX, invInertiaXY, invInertiaXZ, invInertiaYY, invInertiaYZ, invInertiaZZ;
+
+    std::vector<float> sleepTimer;
+    std::vector<uint32_t> colliderIndex;
+    std::vector<EquilibriumState> state;
+    std::vector<BodyId> sleepIsland;    //island a body fell asleep with (its first body), INVALID_BODY once woken by Physics
+
+    //collider extents unpacked per body so the kernels never have to look at the collider table.
+    //spheres only fill radius, boxes only fill the half extents (in their own frame), the other part stays 0.
+    //capsules are a radius around a segment from -halfY to +halfY, hulls fill the half extents with their
+    //local bounds so everything that only needs a box around them can treat them as one
+    std::vector<float> radius;
+    std::vector<float> halfX, halfY, halfZ;
+    //half size of the world space bounding box, radius for spheres, the rotated half extents for
+    //boxes. refreshed together with the world inertia
+    std::vector<float> extentX, extentY, extentZ;
+
+    // world inverse inertia of body i times v
+    glm::vec3 applyInvInertia(uint32_t index, const glm::vec3& v) const
+    {
+        return glm::vec3(invInertiaXX[index] * v.x + invInertiaXY[index] * v.y + invInertiaXZ[index] * v.z,
+                         invInertiaXY[index] * v.x + invInertiaYY[index] * v.y + invInertiaYZ[index] * v.z,
+                         invInertiaXZ[index] * v.x + invInertiaYZ[index] * v.y + invInertiaZZ[index] * v.z);
+    }
+
+private:
+    void wakeIndex(uint32_t index);
+
+    //calls f on every per body float array, add/remove/clear/reserve all go through this
+    template<typename Func>
+    void forEachFloatArray(Func&& f)
+    {
+        for (std::vector<float>* array : {
+                &posX, &posY, &posZ, &prevX, &prevY, &prevZ, &velX, &velY, &velZ, &forceX, &forceY, &forceZ,
+                &inverseMass, &sleepTimer,
+                &rotW, &rotX, &rotY, &rotZ, &prevRotW, &prevRotX, &prevRotY, &prevRotZ,
+                &angVelX, &angVelY, &angVelZ, &torqueX, &torqueY, &torqueZ,
+                &invInertiaX, &invInertiaY, &invInertiaZ,
+                &invInertiaXX, &invInertiaXY, &invInertiaXZ, &invInertiaYY, &invInertiaYZ, &invInertiaZZ,
+                &radius, &halfX, &halfY, &halfZ, &extentX, &extentY, &extentZ }) {
+            f(*array);
+        }
+    }
+
+    std::vector<Collider> m_colliders;
+    std::vector<ConvexHull> m_hulls;    //parallel to m_colliders
+
+    std::vector<BodyId> m_ids;          //dense index -> id
+    std::vector<uint32_t> m_indexOf;    //id -> dense index (INVALID_BODY when free)
+    std::vector<BodyId> m_freeIds;
+    std::vector<BodyId> m_removedIds;
+};
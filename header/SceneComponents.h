@@ -0,0 +1,38 @@
+#pragma once
+
+#include "RigidBodyStore.h"
+#include "StringTable.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class Mesh;
+class Shader;
+
+//components entities in Application's registry are made of, next to the ones from Components.h
+//(GlowingOrb, Plane, Cube) that describe what was spawned
+
+// where to draw the entity this frame, for simulated entities it is interpolated from the body
+struct Transform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// link to the entity's body in RigidBodyStore, the body is removed together with the entity
+struct RigidBody {
+    BodyId body = INVALID_BODY;
+};
+
+// mesh and shader are owned by Application, entities only point at them
+struct Renderable {
+    Mesh* mesh = nullptr;
+    Shader* shader = nullptr;
+    glm::vec3 color = glm::vec3(1.0f);
+};
+
+// names and other cold text about an entity, interned so the component stays two integers.
+// id is what the saved file and the ue4 side call the entity, state is free form ("active")
+struct EntityInfo {
+    StringId id = EMPTY_STRING;
+    StringId state = EMPTY_STRING;
+};
@@ -1,11 +1,23 @@
 #pragma once
 
 #include "Components.h"
+#include "Registry.h"
+#include "SceneComponents.h"
+#include "StringTable.h"
 #include <string>
 
+// everything entity_state.json holds
+struct SavedState {
+    GlowingOrb orb;
+    EntityInfo info;
+    bool isGravityOn = false;
+};
+
 class Serializer
 {
 public:
-    GlowingOrb loadState(const std::string& filePath);
-    void saveState(const GlowingOrb& orb, const std::string& filePath);
+    // defaults (and a fresh "entity_01") when the file is missing or broken
+    SavedState loadState(const std::string& filePath, StringTable& strings);
+    // the ue4 side reads a single orb, so the file holds the first GlowingOrb + EntityInfo in the registry
+    void saveState(Registry& registry, const StringTable& strings, bool isGravityOn, const std::string& filePath);
 };
\ No newline at end of file
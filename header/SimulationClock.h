@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+// Fixed-step simulation clock. Real frame time goes into an accumulator which is then drained in
+// fixed sized steps, so physics always sees the same dt no matter how fast (or slow) we render
+class SimulationClock
+{
+public:
+    SimulationClock(float stepHz = 120.0f, int maxSubsteps = 8, float maxFrameTime = 0.25f)
+        : m_step(1.0f / stepHz), m_maxSubsteps(maxSubsteps), m_maxFrameTime(maxFrameTime) {}
+
+    // feeds one frame worth of time in, returns how many fixed steps should be simulated this frame
+    int advance(float frameTime)
+    {
+        //a hitch (shader compile, json save, window drag) should not turn into a giant catch up
+        frameTime = std::clamp(frameTime, 0.0f, m_maxFrameTime);
+        m_accumulator += frameTime;
+
+        int steps = static_cast<int>(m_accumulator / m_step);
+        if (steps > m_maxSubsteps) {
+            //spiral of death guard: simulating costs more than real time, so drop the backlog
+            //and let the sim run slower instead of falling further behind every frame
+            steps = m_maxSubsteps;
+            m_accumulator = std::fmod(m_accumulator - steps * m_step, m_step);
+        }
+        else {
+            m_accumulator -= steps * m_step;
+        }
+
+        return steps;
+    }
+
+    // how far the render is between the previous and current physics state (0..1)
+    float getAlpha() const { return m_accumulator / m_step; }
+
+    float getStep() const { return m_step; }
+    int getMaxSubsteps() const { return m_maxSubsteps; }
+
+    void setStepHz(float hz) { m_step = 1.0f / hz; }
+    void setMaxSubsteps(int maxSubsteps) { m_maxSubsteps = maxSubsteps; }
+    void setMaxFrameTime(float seconds) { m_maxFrameTime = seconds; }
+
+    void reset() { m_accumulator = 0.0f; }
+
+private:
+    float m_step;
+    int m_maxSubsteps;
+    float m_maxFrameTime;
+    float m_accumulator = 0.0f;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Collision.h"
+#include "RigidBodyStore.h"
+#include "JobSystem.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// Uniform grid broadphase. Space is cut into cubic cells, only occupied cells exist (hashed), and every
+// body is listed in each cell its bounding box touches. Bodies remember which cells they are in, so a
+// step only touches the cell lists of bodies that actually crossed a cell border
+class SpatialHashGrid
+{
+public:
+    explicit SpatialHashGrid(float cellSize = 2.0f);
+
+    // picks up new, moved and removed bodies from the store
+    void update(const RigidBodyStore& bodies);
+
+    // every pair sharing a cell whose boxes overlap, each pair reported once (a < b). cells are split
+    // across the job system when one is given
+    void findPairs(const RigidBodyStore& bodies, std::vector<BodyPair>& out, JobSystem* jobs = nullptr) const;
+
+    void clear();
+
+    float getCellSize() const { return m_cellSize; }
+    // changing the cell size rebuilds on the next update
+    void setCellSize(float cellSize);
+
+private:
+    struct BodyEntry {
+        bool inGrid = false;
+        glm::ivec3 minCell{ 0 };
+        glm::ivec3 maxCell{ 0 };
+        glm::vec3 lower{ 0.0f };    //world space box from the last update
+        glm::vec3 upper{ 0.0f };
+    };
+
+    glm::ivec3 cellOf(const glm::vec3& point) const;
+    static uint64_t cellKey(int x, int y, int z);
+
+    void insert(BodyId id, const BodyEntry& entry);
+    void erase(BodyId id, const BodyEntry& entry);
+
+    float m_cellSize;
+    float m_inverseCellSize;
+
+    struct Cell {
+        glm::ivec3 coord;
+        std::vector<BodyId> bodies;
+    };
+
+    void findPairsInCell(const RigidBodyStore& bodies, const Cell& cell, std::vector<BodyPair>& out) const;
+
+    std::unordered_map<uint64_t, Cell> m_cells;
+    std::vector<BodyEntry> m_entries;   //indexed by BodyId
+
+    //scratch for parallel pair finding, cells flattened so they can be split into ranges
+    mutable std::vector<const Cell*> m_cellList;
+    mutable std::vector<std::vector<BodyPair>> m_rangePairs;
+};
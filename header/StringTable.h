@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 32 bit stand in for a string, equal strings always get the same id so comparing two is one integer
+// compare and components that name things stay plain data
+using StringId = uint32_t;
+constexpr StringId EMPTY_STRING = 0;   //"" is interned up front, a zeroed StringId is always valid
+
+// Interns strings for the lifetime of the table. Ids are handed out in order and never reused, so
+// they can be stored anywhere (components, command buffers, snapshots) without ever dangling.
+// safe to use from several threads, though lookups are meant for cold paths (saving, debug ui)
+class StringTable
+{
+public:
+    StringTable();
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    // id of the string, adding it first if it is new
+    StringId intern(std::string_view text);
+    // same but never adds, false when the string was never interned
+    bool find(std::string_view text, StringId& id) const;
+    // the string behind an id, the reference stays valid as long as the table does
+    const std::string& lookup(StringId id) const;
+
+    size_t size() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::deque<std::string> m_strings;                      //indexed by id, a deque so strings never move
+    std::unordered_map<std::string_view, StringId> m_ids;   //views into m_strings
+};
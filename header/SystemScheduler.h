@@ -0,0 +1,92 @@
+#pragma once
+
+#include "JobSystem.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// one bit per thing a system can touch. any type works as a key, components (GlowingOrb, Transform)
+// and whole objects (RigidBodyStore, Camera) alike, the type only stands for "that data"
+using AccessMask = uint64_t;
+
+namespace SystemAccess
+{
+    uint32_t registerKey();
+
+    template<typename T>
+    uint32_t key()
+    {
+        static const uint32_t id = registerKey();
+        return id;
+    }
+
+    template<typename... Ts>
+    AccessMask mask() { return (AccessMask(0) | ... | (AccessMask(1) << key<Ts>())); }
+}
+
+// Runs a frame's worth of systems, each declaring what it reads and writes. Two systems conflict when
+// one writes something the other reads or writes, conflicting systems run in the order they were
+// added and everything else runs at the same time on the job system. declaring is on trust: a system
+// that touches data it did not declare races with whatever else is running
+class SystemScheduler
+{
+public:
+    using SystemFunction = std::function<void()>;
+
+    // returned by add, for chaining the access declarations onto it
+    class SystemBuilder
+    {
+    public:
+        template<typename... Ts>
+        SystemBuilder& reads() { m_scheduler.m_systems[m_system].reads |= SystemAccess::mask<Ts...>(); m_scheduler.m_dirty = true; return *this; }
+        template<typename... Ts>
+        SystemBuilder& writes() { m_scheduler.m_systems[m_system].writes |= SystemAccess::mask<Ts...>(); m_scheduler.m_dirty = true; return *this; }
+        // for systems that have to stay on the thread that calls run (glfw, gl)
+        SystemBuilder& mainThread() { m_scheduler.m_systems[m_system].mainThread = true; return *this; }
+
+    private:
+        friend class SystemScheduler;
+        SystemBuilder(SystemScheduler& scheduler, uint32_t system) : m_scheduler(scheduler), m_system(system) {}
+
+        SystemScheduler& m_scheduler;
+        uint32_t m_system;
+    };
+
+    SystemBuilder add(const char* name, SystemFunction function);
+
+    // runs every system once and returns when all are done. without a job system (or with no workers)
+    // they simply run one after another in the order they were added
+    void run(JobSystem* jobs);
+
+    size_t systemCount() const { return m_systems.size(); }
+    const char* getName(uint32_t system) const { return m_systems[system].name; }
+    // systems that have to finish before this one starts
+    std::vector<uint32_t> getDependencies(uint32_t system);
+
+private:
+    struct System {
+        const char* name;
+        SystemFunction function;
+        AccessMask reads = 0;
+        AccessMask writes = 0;
+        bool mainThread = false;
+        std::vector<uint32_t> dependents;   //systems waiting on this one
+        int dependencyCount = 0;
+    };
+
+    void buildGraph();
+    void dispatch(uint32_t system, JobSystem& jobs, JobSystem::Counter& counter);
+    void execute(uint32_t system, JobSystem& jobs, JobSystem::Counter& counter);
+
+    std::vector<System> m_systems;
+    bool m_dirty = false;
+
+    //per run state
+    std::unique_ptr<std::atomic<int>[]> m_remaining;    //unfinished dependencies of each system
+    std::atomic<size_t> m_finished{ 0 };
+    std::mutex m_mainMutex;
+    std::vector<uint32_t> m_mainReady;                  //main thread systems whose dependencies are done
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+
+// Quantized vertex for VertexFormat::COMPACT, half the size of Primitives::Vertex:
+//   position  3 x unorm16 across the mesh's bounding box (the shader gets the box as positionOffset
+//             and positionScale), plus one unused slot to keep the rest 4 byte aligned
+//   texCoord  2 x half float
+//   normal    octahedral, 2 x int16. read as plain integers and divided in the shader, since gl 3.3
+//             and 4.2+ disagree on how normalized signed values map to -1..1
+// precision is 1/65535 of the box per axis and under 0.05 degrees for normals, uvs keep 11 bits
+struct PackedVertex
+{
+    uint16_t position[4];
+    uint16_t texCoord[2];
+    int16_t normal[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex is uploaded as is, its layout has to match packedVertexLayout");
+
+const uint32_t PACKED_ATTRIBUTE_COUNT = 3;
+const VertexAttribute* packedVertexLayout();
+
+PackedVertex packVertex(const Primitives::Vertex& vertex, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+// what the vertex shaders compute, for tools and for checking the error on the cpu
+Primitives::Vertex unpackVertex(const PackedVertex& packed, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+void packVertices(const MeshData& mesh, std::vector<PackedVertex>& out);
@@ -6,11 +6,28 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+//compact meshes store positions as 0..1 across their bounding box and octahedral normals as two raw
+//int16s in aNormal.xy, standard ones get offset 0, scale 1 and packedNormals false
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool packedNormals;
+
 out vec3 FragPos; 
 out vec3 Normal;  
 
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal; 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 position = positionOffset + positionScale * aPos;
+    vec3 normal = packedNormals ? octDecode(clamp(aNormal.xy / 32767.0, -1.0, 1.0)) : aNormal;
+
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normal; 
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -4,7 +4,8 @@
 
 
 Application::Application()
-    : m_camera(glm::vec3(0.0f, 5.0f, 15.0f)) 
+    : m_camera(glm::vec3(0.0f, 5.0f, 15.0f)),
+      m_clock(PHYSICS_HZ, MAX_PHYSICS_SUBSTEPS, MAX_FRAME_TIME)
 {
     m_window = std::make_unique<Window>(SCR_WIDTH, SCR_HEIGHT, "cross engine");
     m_input = std::make_unique<InputManager>(m_window->getNativeWindow(), m_camera);
@@ -14,103 +15,220 @@ Application::Application()
         glViewport(0, 0, width, height);
         });
 
-    m_orb = m_serializer.loadState(JSON_PATH);
+    SavedState saved = m_serializer.loadState(JSON_PATH, m_strings);
 
-    m_plane.init();
-    
-    
-
-    
     m_renderer = std::make_unique<Renderer>();
 
-    m_physics.setGravity(m_orb.isGravityOn);
+    m_jobs = std::make_unique<JobSystem>();
+    m_commands = std::make_unique<CommandQueue>(m_jobs.get());
+
+    m_physics.setGravity(saved.isGravityOn);
+    m_physics.setJobSystem(m_jobs.get());
+    m_physics.setBroadphase(BroadphaseType::BVH); //cube scale makes sizes vary, and picking uses the tree
+    m_physics.setDeterministic(true); //the ue4 side replays from the saved state and has to stay in lockstep
 
-    m_orbMesh = std::make_unique<Mesh>(ORB_MODEL_PATH);
+    m_meshes = std::make_unique<MeshRegistry>(m_jobs.get());
+    m_orbMesh = m_meshes->load(ORB_MODEL_PATH, VertexFormat::COMPACT);
     m_orbShader = std::make_unique<Shader>(ORB_VERT_PATH, ORB_FRAG_PATH);
 
-    m_planeMesh = std::make_unique<Mesh>(PLANE_MODEL_PATH);
+    m_planeMesh = m_meshes->load(PLANE_MODEL_PATH, VertexFormat::COMPACT);
     m_planeShader = std::make_unique<Shader>(BASIC_VERT_PATH, BASIC_FRAG_PATH);
 
+    m_cubeMesh = m_meshes->load(CUBE_MODEL_PATH, VertexFormat::COMPACT);
+    m_cubeShader = std::make_unique<Shader>(BASIC_VERT_PATH, BASIC_FRAG_PATH);
 
-    if (shouldSpawnCube)
-    {
-        m_cube.init();
-        m_cube.scale = glm::vec3(0.2f);
-        m_cubeMesh = std::make_unique<Mesh>(CUBE_MODEL_PATH);
-        m_cubeShader = std::make_unique<Shader>(BASIC_VERT_PATH, BASIC_FRAG_PATH);
-    }
+    Cube cube;
+    cube.init();
+    Collider cubeCollider = cube.collider;
+    cubeCollider.baseHalfExtents *= CUBE_SCALE; //store keeps world sized extents
+    m_cubeCollider = m_bodies.addCollider(cubeCollider);
+
+    Collider orbCollider;
+    orbCollider.type = ShapeType::SPHERE;
+    orbCollider.radius = ORB_RADIUS;
+    m_orbCollider = m_bodies.addCollider(orbCollider);
+
+
+    Plane plane;
+    plane.init();
+
+    m_plane = m_registry.create();
+    m_registry.emplace<Plane>(m_plane, plane);
+    m_registry.emplace<Transform>(m_plane, Transform{ plane.position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(10.0f) });
+    m_registry.emplace<Renderable>(m_plane, Renderable{ m_planeMesh.get(), m_planeShader.get(), plane.color });
+
+    m_orb = spawnOrb(saved.orb, saved.info);
 
-    
+    buildSystems();
 }
 
-void Application::run()
+Entity Application::spawnOrb(const GlowingOrb& orb, const EntityInfo& info)
 {
-    float lastFrame = 0.0f;
+    BodyDesc orbDesc;
+    orbDesc.position = orb.position;
+    orbDesc.velocity = orb.velocity;
+    orbDesc.mass = orb.mass;
+    orbDesc.collider = m_orbCollider;
+
+    Entity entity = m_registry.create();
+    if (entity == NULL_ENTITY) return NULL_ENTITY;
+    m_registry.emplace<GlowingOrb>(entity, orb);
+    m_registry.emplace<EntityInfo>(entity, info);
+    m_registry.emplace<RigidBody>(entity, RigidBody{ m_bodies.add(orbDesc) });
+    m_registry.emplace<Transform>(entity, Transform{ orb.position });
+    m_registry.emplace<Renderable>(entity, Renderable{ m_orbMesh.get(), m_orbShader.get() });
+    return entity;
+}
 
-    while (!m_window->shouldClose())
-    {
-        
-        float currentFrame = static_cast<float>(glfwGetTime());
-        float deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+void Application::spawnCube(CommandRecorder& commands, const glm::vec3& position)
+{
+    Cube cube;
+    cube.init();
+    cube.position = position;
+    cube.scale = glm::vec3(CUBE_SCALE);
+
+    BodyDesc cubeDesc;
+    cubeDesc.position = cube.position;
+    cubeDesc.velocity = cube.velocity;
+    cubeDesc.orientation = cube.rotation;
+    cubeDesc.angularVelocity = cube.angularVelocity;
+    cubeDesc.mass = cube.mass;
+    cubeDesc.collider = m_cubeCollider;
+
+    Entity entity = commands.spawn();
+    commands.add(entity, cube);
+    commands.add(entity, cubeDesc);     //turned into a body by attachBodies after playback
+    commands.add(entity, Transform{ cube.position, cube.rotation, cube.scale });
+    commands.add(entity, Renderable{ m_cubeMesh.get(), m_cubeShader.get(), cube.color });
+}
 
-        
-        m_input->process(deltaTime);
-        InputState inputState = m_input->getState();
+void Application::removeBody(Entity entity)
+{
+    if (RigidBody* body = m_registry.tryGet<RigidBody>(entity)) {
+        m_bodies.remove(body->body);
+    }
+}
+
+void Application::attachBodies()
+{
+    std::vector<Entity> pending;
+    m_registry.each<BodyDesc>([&](Entity entity, BodyDesc&) { pending.push_back(entity); });
 
-        if (inputState.exitApp) {
+    for (Entity entity : pending) {
+        BodyId body = m_bodies.add(m_registry.get<BodyDesc>(entity));
+        m_registry.remove<BodyDesc>(entity);
+        m_registry.emplace<RigidBody>(entity, RigidBody{ body });
+    }
+}
+
+void Application::buildSystems()
+{
+    //add order doubles as priority: of two systems that touch the same data the earlier one runs first.
+    //no system changes the registry's structure itself, spawning and despawning go through m_commands
+    //and are played back once the frame's systems are done
+
+    m_systems.add("input", [this]() {
+        m_input->process(m_frameTime);
+        m_inputState = m_input->getState();
+
+        if (m_inputState.exitApp) {
             glfwSetWindowShouldClose(m_window->getNativeWindow(), true);
         }
-        if (inputState.saveState) {
-            m_orb.isGravityOn = m_physics.getGravityState();
-            m_serializer.saveState(m_orb, JSON_PATH);
-        }
-        if (inputState.resetPosition) {
-            GlowingOrb defaultOrb;
-            m_orb.position = defaultOrb.position;
-            m_orb.velocity = defaultOrb.velocity;
-        }
-
-        m_physics.update(m_orb, m_plane, (shouldSpawnCube ? &m_cube : nullptr), inputState, deltaTime);
+    }).writes<InputState, Camera>().mainThread();
 
-        int width, height;
-        m_window->getSize(width, height);
+    m_systems.add("gameplay", [this]() {
+        if (m_inputState.resetPosition) {
+            GlowingOrb defaultOrb;
+            BodyId orbBody = m_registry.get<RigidBody>(m_orb).body;
+            m_bodies.teleport(orbBody, defaultOrb.position); //teleport, dont interpolate from the old spot
+            m_bodies.setVelocity(orbBody, defaultOrb.velocity);
 
-        m_renderer->beginFrame(m_camera, width, height);
+            //and the spawned cubes go away
+            CommandRecorder commands = m_commands->record(GAMEPLAY_COMMANDS);
+            m_registry.each<Cube>([&](Entity cube, Cube&) { commands.destroy(cube); });
+        }
+        if (m_inputState.spawnCube) {
+            CommandRecorder commands = m_commands->record(GAMEPLAY_COMMANDS);
+            spawnCube(commands, m_camera.Position + m_camera.Front * CUBE_SPAWN_DISTANCE);
+        }
 
+        m_physics.applyInput(m_bodies, m_inputState);
 
-        glm::mat4 planeModel = glm::translate(glm::mat4(1.0f), m_plane.position);
-        glm::vec3 planeScale(10.0f);
-        planeModel = glm::scale(planeModel, planeScale);
-        m_renderer->draw(m_planeMesh.get(), m_planeShader.get(), planeModel,
-            [&](Shader& shader) {
-                shader.setVec3("objectColor", m_plane.color);
+        //interacting only charges the orb while the crosshair is actually on it
+        m_interaction.body = INVALID_BODY;
+        if (m_inputState.shouldInteract) {
+            RayHit hit;
+            BodyId orbBody = m_registry.get<RigidBody>(m_orb).body;
+            if (m_physics.raycast(m_bodies, m_camera.Position, m_camera.Front, INTERACT_RANGE, hit) && hit.body == orbBody) {
+                m_interaction.body = orbBody;
             }
-        );
-
+        }
 
-        if (shouldSpawnCube) {
-            glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), m_cube.position);
-            cubeModel = glm::scale(cubeModel, m_cube.scale);
+        m_steps = m_clock.advance(m_frameTime);
+    }).reads<Registry, Cube, RigidBody, InputState, Camera>().writes<RigidBodyStore, Physics, InteractionTarget, SimulationClock>();
+
+    //drain the frame time in fixed steps, keeping the pre-step state around for interpolation
+    m_systems.add("physics", [this]() {
+        const Plane& plane = m_registry.get<Plane>(m_plane);
+        m_frameImpacts.clear();
+        for (int i = 0; i < m_steps; i++) {
+            m_bodies.storePrevious();
+            m_physics.update(m_bodies, plane, m_clock.getStep());
+            m_frameImpacts.insert(m_frameImpacts.end(), m_physics.getImpacts().begin(), m_physics.getImpacts().end());
+        }
+    }).reads<Registry, Plane, SimulationClock>().writes<RigidBodyStore, Physics, ImpactEvent>();
 
-            m_renderer->draw(m_cubeMesh.get(), m_cubeShader.get(), cubeModel,
-                [&](Shader& shader) {
-                    shader.setVec3("objectColor", m_cube.color);
-                }
-            );
+    //only orb energy, nothing physics touches, so it runs while the steps above do
+    m_systems.add("energy decay", [this]() {
+        for (int i = 0; i < m_steps; i++) {
+            Physics::decayEnergy(m_registry, m_interaction.body, m_clock.getStep());
         }
+    }).reads<Registry, RigidBody, InteractionTarget, SimulationClock>().writes<GlowingOrb>();
+
+    m_systems.add("energy impacts", [this]() {
+        Physics::absorbImpacts(m_registry, m_frameImpacts);
+    }).reads<Registry, RigidBody, ImpactEvent>().writes<GlowingOrb>();
+
+    m_systems.add("transform sync", [this]() {
+        syncTransforms(m_clock.getAlpha());
+    }).reads<Registry, RigidBody, RigidBodyStore, SimulationClock>().writes<Transform>();
+
+    m_systems.add("serialization", [this]() {
+        if (!m_inputState.saveState) return;
+        syncOrbFromBody();
+        m_serializer.saveState(m_registry, m_strings, m_physics.getGravityState(), JSON_PATH);
+    }).reads<Registry, RigidBody, EntityInfo, StringTable, RigidBodyStore, Physics, InputState>().writes<GlowingOrb, Serializer>();
+
+    //builds the draw list, the gl calls themselves stay on the main thread in run
+    m_systems.add("render extraction", [this]() {
+        Renderer::extract(m_registry, m_drawList);
+    }).reads<Registry, Renderable, Transform, GlowingOrb>().writes<DrawItem>();
+}
+
+void Application::run()
+{
+    float lastFrame = 0.0f;
 
+    while (!m_window->shouldClose())
+    {
+        
+        float currentFrame = static_cast<float>(glfwGetTime());
+        m_frameTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
 
+        m_systems.run(m_jobs.get());
 
-        glm::mat4 orbModel = glm::translate(glm::mat4(1.0f), m_orb.position);
+        //sync point, nothing else touches the registry until the next frame's systems start
+        m_commands->playback(m_registry, [this](Entity entity) { removeBody(entity); });
+        attachBodies();
 
-        m_renderer->draw(m_orbMesh.get(), m_orbShader.get(), orbModel,
-            [&](Shader& shader) {
-                shader.setFloat("energy", m_orb.energy);
-            }
-        );
+        int width, height;
+        m_window->getSize(width, height);
+
+        m_renderer->beginFrame(m_camera, width, height);
 
 
+        m_renderer->submit(m_drawList);
 
 
         m_renderer->endFrame();
@@ -119,8 +237,24 @@ void Application::run()
         m_window->pollEvents();
     }
 
-    m_orb.isGravityOn = m_physics.getGravityState();
+    syncOrbFromBody();
+
+
+    m_serializer.saveState(m_registry, m_strings, m_physics.getGravityState(), JSON_PATH); //save struct data to json
+}
 
+void Application::syncTransforms(float alpha)
+{
+    m_registry.each<RigidBody, Transform>([&](Entity, RigidBody& body, Transform& transform) {
+        transform.position = m_bodies.getInterpolatedPosition(body.body, alpha);
+        transform.rotation = m_bodies.getInterpolatedOrientation(body.body, alpha);
+    });
+}
 
-    m_serializer.saveState(m_orb, JSON_PATH); //save struct data to json
+void Application::syncOrbFromBody()
+{
+    m_registry.each<GlowingOrb, RigidBody>([&](Entity, GlowingOrb& orb, RigidBody& body) {
+        orb.position = m_bodies.getPosition(body.body);
+        orb.velocity = m_bodies.getVelocity(body.body);
+    });
 }
\ No newline at end of file
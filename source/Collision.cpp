@@ -0,0 +1,533 @@
+#include "Determinism.h"
+#include "Collision.h"
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+
+namespace {
+    //a face axis has to beat the other box's face axis, and an edge axis any face axis, by this much
+    //(relative, then absolute) to be picked. keeps the chosen axis from flipping between steps when two
+    //are nearly tied, which would also throw away the warm start
+    const float AXIS_RELATIVE_TOLERANCE = 0.95f;
+    const float AXIS_ABSOLUTE_TOLERANCE = 0.01f;
+    //side planes are pushed out by this much before clipping. boxes of the same size stacked flush put
+    //corners right on a side plane, without it they would be kept one step and cut the next, and the
+    //changing feature ids would throw away the warm start
+    const float CLIP_TOLERANCE = 1e-3f;
+
+    struct ClipPoint {
+        glm::vec3 position;
+        uint32_t id;    //incident corner it came from, or the side plane and edge that cut it
+    };
+
+    //keeps the part of the polygon where dot(p, normal) <= offset, Sutherland-Hodgman
+    int clipPolygon(const ClipPoint* in, int count, const glm::vec3& normal, float offset, uint32_t planeId, ClipPoint* out)
+    {
+        int outCount = 0;
+        for (int k = 0; k < count; k++) {
+            const ClipPoint& current = in[k];
+            const ClipPoint& next = in[(k + 1) % count];
+            float distCurrent = glm::dot(current.position, normal) - offset - CLIP_TOLERANCE;
+            float distNext = glm::dot(next.position, normal) - offset - CLIP_TOLERANCE;
+
+            if (distCurrent <= 0.0f) out[outCount++] = current;
+            if ((distCurrent <= 0.0f) != (distNext <= 0.0f)) {
+                float t = distCurrent / (distCurrent - distNext);
+                out[outCount++] = { current.position + (next.position - current.position) * t, 16 + planeId * 4 + (current.id & 3) };
+            }
+        }
+        return outCount;
+    }
+
+    //closest point on the segment a-b to p
+    glm::vec3 closestOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b)
+    {
+        glm::vec3 ab = b - a;
+        float lengthSq = glm::dot(ab, ab);
+        if (lengthSq < 1e-12f) return a;
+        return a + ab * glm::clamp(glm::dot(p - a, ab) / lengthSq, 0.0f, 1.0f);
+    }
+
+    //closest points between segments p1-q1 and p2-q2 as fractions along each, Ericson 5.1.9
+    void closestSegmentSegment(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2, float& s, float& t)
+    {
+        const float epsilon = 1e-12f;
+        glm::vec3 d1 = q1 - p1;
+        glm::vec3 d2 = q2 - p2;
+        glm::vec3 r = p1 - p2;
+        float a = glm::dot(d1, d1);
+        float e = glm::dot(d2, d2);
+        float f = glm::dot(d2, r);
+
+        if (a <= epsilon && e <= epsilon) { s = t = 0.0f; return; }
+        if (a <= epsilon) { s = 0.0f; t = glm::clamp(f / e, 0.0f, 1.0f); return; }
+
+        float c = glm::dot(d1, r);
+        if (e <= epsilon) { t = 0.0f; s = glm::clamp(-c / a, 0.0f, 1.0f); return; }
+
+        float b = glm::dot(d1, d2);
+        float denominator = a * e - b * b;
+        s = denominator > epsilon ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+        t = (b * s + f) / e;
+        if (t < 0.0f) { t = 0.0f; s = glm::clamp(-c / a, 0.0f, 1.0f); }
+        else if (t > 1.0f) { t = 1.0f; s = glm::clamp((b - c) / a, 0.0f, 1.0f); }
+    }
+}
+
+
+namespace Narrowphase
+{
+    int reduceManifold(Contact* contacts, int count, const glm::vec3& normal)
+    {
+        if (count <= MAX_MANIFOLD) return count;
+
+        int picked[MAX_MANIFOLD] = { 0, 0, 0, 0 };
+        for (int k = 1; k < count; k++) {
+            if (contacts[k].penetration > contacts[picked[0]].penetration) picked[0] = k;
+        }
+
+        const glm::vec3 p0 = contacts[picked[0]].point;
+        float best = -1.0f;
+        for (int k = 0; k < count; k++) {
+            glm::vec3 delta = contacts[k].point - p0;
+            float distSq = glm::dot(delta, delta);
+            if (distSq > best) { best = distSq; picked[1] = k; }
+        }
+
+        const glm::vec3 edge = contacts[picked[1]].point - p0;
+        float mostPositive = 0.0f, mostNegative = 0.0f;
+        picked[2] = picked[0];
+        picked[3] = picked[1];
+        for (int k = 0; k < count; k++) {
+            float area = glm::dot(glm::cross(edge, contacts[k].point - p0), normal);
+            if (area > mostPositive) { mostPositive = area; picked[2] = k; }
+            if (area < mostNegative) { mostNegative = area; picked[3] = k; }
+        }
+
+        Contact reduced[MAX_MANIFOLD];
+        int reducedCount = 0;
+        for (int k = 0; k < MAX_MANIFOLD; k++) {
+            bool duplicate = false;
+            for (int m = 0; m < k; m++) duplicate |= picked[m] == picked[k];
+            if (!duplicate) reduced[reducedCount++] = contacts[picked[k]];
+        }
+        for (int k = 0; k < reducedCount; k++) contacts[k] = reduced[k];
+        return reducedCount;
+    }
+
+    bool sphereSphere(const glm::vec3& posA, float radiusA, const glm::vec3& posB, float radiusB, Contact& out)
+    {
+        glm::vec3 delta = posB - posA;
+        float distSq = glm::dot(delta, delta);
+        float radiusSum = radiusA + radiusB;
+
+        if (distSq >= radiusSum * radiusSum) return false;
+
+        float dist = std::sqrt(distSq);
+        //dead center on top of each other, any direction works, up at least separates them sensibly
+        out.normal = dist > 1e-6f ? delta / dist : glm::vec3(0.0f, 1.0f, 0.0f);
+        out.penetration = radiusSum - dist;
+        out.point = posA + out.normal * (radiusA - out.penetration * 0.5f);
+        return true;
+    }
+
+    bool sphereAABB(const glm::vec3& spherePos, float radius, const glm::vec3& boxPos, const glm::vec3& halfExtents, Contact& out)
+    {
+        glm::vec3 local = spherePos - boxPos;
+        glm::vec3 closest = glm::clamp(local, -halfExtents, halfExtents);
+
+        if (closest != local) {
+            //center outside the box, normal runs from the sphere center to the closest point on the box
+            glm::vec3 delta = closest - local;
+            float distSq = glm::dot(delta, delta);
+            if (distSq >= radius * radius) return false;
+
+            float dist = std::sqrt(distSq);
+            out.normal = delta / dist;
+            out.penetration = radius - dist;
+            out.point = boxPos + closest;
+            return true;
+        }
+
+        //center inside the box, push out through the nearest face
+        glm::vec3 faceDist = halfExtents - glm::abs(local);
+        int axis = 0;
+        if (faceDist.y < faceDist[axis]) axis = 1;
+        if (faceDist.z < faceDist[axis]) axis = 2;
+
+        glm::vec3 faceDir(0.0f);
+        faceDir[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+
+        out.normal = -faceDir;
+        out.penetration = radius + faceDist[axis];
+        out.point = spherePos;
+        return true;
+    }
+
+    bool aabbAABB(const glm::vec3& posA, const glm::vec3& halfA, const glm::vec3& posB, const glm::vec3& halfB, Contact& out)
+    {
+        glm::vec3 delta = posB - posA;
+        glm::vec3 overlap = (halfA + halfB) - glm::abs(delta);
+
+        if (overlap.x <= 0.0f || overlap.y <= 0.0f || overlap.z <= 0.0f) return false;
+
+        //separate along whichever axis needs the least push
+        int axis = 0;
+        if (overlap.y < overlap[axis]) axis = 1;
+        if (overlap.z < overlap[axis]) axis = 2;
+
+        out.normal = glm::vec3(0.0f);
+        out.normal[axis] = delta[axis] < 0.0f ? -1.0f : 1.0f;
+        out.penetration = overlap[axis];
+
+        //middle of the overlapping region
+        glm::vec3 lower = glm::max(posA - halfA, posB - halfB);
+        glm::vec3 upper = glm::min(posA + halfA, posB + halfB);
+        out.point = (lower + upper) * 0.5f;
+        return true;
+    }
+
+    bool raySphere(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& center, float radius, float maxT, float& t)
+    {
+        glm::vec3 m = origin - center;
+        float b = glm::dot(m, dir);
+        float c = glm::dot(m, m) - radius * radius;
+
+        //starting inside
+        if (c <= 0.0f) {
+            t = 0.0f;
+            return true;
+        }
+        //outside and pointing away
+        if (b > 0.0f) return false;
+
+        float discriminant = b * b - c;
+        if (discriminant < 0.0f) return false;
+
+        t = -b - std::sqrt(discriminant);
+        return t <= maxT;
+    }
+
+    bool rayAABB(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& lower, const glm::vec3& upper, float maxT, float& t)
+    {
+        //slab test, clip [0, maxT] against the three pairs of planes
+        float tMin = 0.0f;
+        float tMax = maxT;
+
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::abs(dir[axis]) < 1e-8f) {
+                //parallel to this slab, has to already be between its planes
+                if (origin[axis] < lower[axis] || origin[axis] > upper[axis]) return false;
+                continue;
+            }
+
+            float inverse = 1.0f / dir[axis];
+            float t1 = (lower[axis] - origin[axis]) * inverse;
+            float t2 = (upper[axis] - origin[axis]) * inverse;
+            if (t1 > t2) std::swap(t1, t2);
+
+            tMin = glm::max(tMin, t1);
+            tMax = glm::min(tMax, t2);
+            if (tMin > tMax) return false;
+        }
+
+        t = tMin;
+        return true;
+    }
+
+    bool sweepSphereAABB(const glm::vec3& start, const glm::vec3& motion, float radius, const glm::vec3& boxPos,
+                         const glm::vec3& halfExtents, float& toi, glm::vec3& normal)
+    {
+        float length = glm::length(motion);
+        if (length < 1e-6f) return false;
+
+        //the box grown by the radius contains the rounded shape the sphere center can not enter, missing
+        //it means missing for sure and entering it is the earliest the real hit can be
+        glm::vec3 grown = halfExtents + glm::vec3(radius);
+        float t;
+        if (!rayAABB(start, motion / length, boxPos - grown, boxPos + grown, length, t)) return false;
+
+        glm::vec3 lower = boxPos - halfExtents;
+        glm::vec3 upper = boxPos + halfExtents;
+        {
+            glm::vec3 closest = glm::clamp(start, lower, upper);
+            if (glm::dot(start - closest, start - closest) < radius * radius) return false;
+        }
+
+        //face hits are exact already, edges and corners are rounded so walk forward from there
+        //(conservative advancement, never steps further than the gap to the box)
+        const float tolerance = 1e-3f;
+        for (int iteration = 0; iteration < 16; iteration++) {
+            glm::vec3 center = start + motion * (t / length);
+            glm::vec3 delta = center - glm::clamp(center, lower, upper);
+            float dist = glm::length(delta);
+            float gap = dist - radius;
+
+            if (gap < tolerance) {
+                toi = t / length;
+                normal = dist > 1e-6f ? delta / dist : -motion / length;
+                return true;
+            }
+
+            t += gap;
+            if (t > length) return false;
+        }
+        return false;
+    }
+
+    bool sphereOBB(const glm::vec3& spherePos, float radius, const glm::vec3& boxPos, const glm::mat3& rotation,
+                   const glm::vec3& halfExtents, Contact& out)
+    {
+        //rotation is orthonormal, the transpose takes world directions into the box frame
+        glm::vec3 local = glm::transpose(rotation) * (spherePos - boxPos);
+        if (!sphereAABB(local, radius, glm::vec3(0.0f), halfExtents, out)) return false;
+
+        out.normal = rotation * out.normal;
+        out.point = boxPos + rotation * out.point;
+        return true;
+    }
+
+    int boxBox(const glm::vec3& posA, const glm::mat3& rotationA, const glm::vec3& halfA,
+               const glm::vec3& posB, const glm::mat3& rotationB, const glm::vec3& halfB, Contact* out)
+    {
+        const glm::vec3 delta = posB - posA;
+
+        //separation along an axis, positive means a gap so the boxes can not touch at all
+        auto separation = [&](const glm::vec3& axis) {
+            float radiusA = halfA.x * std::fabs(glm::dot(axis, rotationA[0])) + halfA.y * std::fabs(glm::dot(axis, rotationA[1])) +
+                            halfA.z * std::fabs(glm::dot(axis, rotationA[2]));
+            float radiusB = halfB.x * std::fabs(glm::dot(axis, rotationB[0])) + halfB.y * std::fabs(glm::dot(axis, rotationB[1])) +
+                            halfB.z * std::fabs(glm::dot(axis, rotationB[2]));
+            return std::fabs(glm::dot(delta, axis)) - (radiusA + radiusB);
+        };
+
+        float faceSeparationA = -FLT_MAX, faceSeparationB = -FLT_MAX, edgeSeparation = -FLT_MAX;
+        int faceA = 0, faceB = 0, edgeA = 0, edgeB = 0;
+
+        for (int k = 0; k < 3; k++) {
+            float sepA = separation(rotationA[k]);
+            if (sepA > 0.0f) return 0;
+            if (sepA > faceSeparationA) { faceSeparationA = sepA; faceA = k; }
+
+            float sepB = separation(rotationB[k]);
+            if (sepB > 0.0f) return 0;
+            if (sepB > faceSeparationB) { faceSeparationB = sepB; faceB = k; }
+        }
+
+        glm::vec3 edgeAxis(0.0f);
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++) {
+                glm::vec3 axis = glm::cross(rotationA[i], rotationB[j]);
+                float lengthSq = glm::dot(axis, axis);
+                //parallel edges, the face axes already cover that direction
+                if (lengthSq < 1e-6f) continue;
+
+                axis /= std::sqrt(lengthSq);
+                float sep = separation(axis);
+                if (sep > 0.0f) return 0;
+                if (sep > edgeSeparation) { edgeSeparation = sep; edgeA = i; edgeB = j; edgeAxis = axis; }
+            }
+
+        bool referenceIsA = true;
+        float faceSeparation = faceSeparationA;
+        if (faceSeparationB > AXIS_RELATIVE_TOLERANCE * faceSeparationA + AXIS_ABSOLUTE_TOLERANCE) {
+            referenceIsA = false;
+            faceSeparation = faceSeparationB;
+        }
+
+        if (edgeSeparation > AXIS_RELATIVE_TOLERANCE * faceSeparation + AXIS_ABSOLUTE_TOLERANCE) {
+            //two edges crossing, one point halfway between their closest points
+            glm::vec3 normal = glm::dot(delta, edgeAxis) < 0.0f ? -edgeAxis : edgeAxis;
+
+            glm::vec3 pointA = posA;
+            glm::vec3 pointB = posB;
+            for (int k = 0; k < 3; k++) {
+                if (k != edgeA) pointA += rotationA[k] * (glm::dot(normal, rotationA[k]) > 0.0f ? halfA[k] : -halfA[k]);
+                if (k != edgeB) pointB += rotationB[k] * (glm::dot(normal, rotationB[k]) > 0.0f ? -halfB[k] : halfB[k]);
+            }
+
+            const glm::vec3& dirA = rotationA[edgeA];
+            const glm::vec3& dirB = rotationB[edgeB];
+            glm::vec3 r = pointA - pointB;
+            float b = glm::dot(dirA, dirB);
+            float c = glm::dot(dirA, r);
+            float f = glm::dot(dirB, r);
+            float denominator = 1.0f - b * b;
+            float s = denominator > 1e-6f ? (b * f - c) / denominator : 0.0f;
+            s = glm::clamp(s, -halfA[edgeA], halfA[edgeA]);
+            float t = glm::clamp(b * s + f, -halfB[edgeB], halfB[edgeB]);
+
+            out[0].normal = normal;
+            out[0].penetration = -edgeSeparation;
+            out[0].point = ((pointA + dirA * s) + (pointB + dirB * t)) * 0.5f;
+            out[0].feature = (6 + edgeA * 3 + edgeB) << 8;
+            return 1;
+        }
+
+        //face contact, the incident box's face that points most against the reference face gets
+        //clipped to the reference face's sides
+        const glm::vec3& refPos = referenceIsA ? posA : posB;
+        const glm::mat3& refRotation = referenceIsA ? rotationA : rotationB;
+        const glm::vec3& refHalf = referenceIsA ? halfA : halfB;
+        const glm::vec3& incPos = referenceIsA ? posB : posA;
+        const glm::mat3& incRotation = referenceIsA ? rotationB : rotationA;
+        const glm::vec3& incHalf = referenceIsA ? halfB : halfA;
+        const int refAxis = referenceIsA ? faceA : faceB;
+
+        //reference -> incident
+        glm::vec3 normal = refRotation[refAxis];
+        if (glm::dot(incPos - refPos, normal) < 0.0f) normal = -normal;
+
+        int incAxis = 0;
+        float mostAligned = -1.0f;
+        for (int k = 0; k < 3; k++) {
+            float alignment = std::fabs(glm::dot(normal, incRotation[k]));
+            if (alignment > mostAligned) { mostAligned = alignment; incAxis = k; }
+        }
+        glm::vec3 incNormal = incRotation[incAxis] * (glm::dot(normal, incRotation[incAxis]) > 0.0f ? -1.0f : 1.0f);
+        glm::vec3 incCenter = incPos + incNormal * incHalf[incAxis];
+        glm::vec3 u = incRotation[(incAxis + 1) % 3] * incHalf[(incAxis + 1) % 3];
+        glm::vec3 v = incRotation[(incAxis + 2) % 3] * incHalf[(incAxis + 2) % 3];
+
+        ClipPoint polygon[8] = {
+            { incCenter + u + v, 0 }, { incCenter - u + v, 1 }, { incCenter - u - v, 2 }, { incCenter + u - v, 3 }
+        };
+        ClipPoint clipped[8];
+        int count = 4;
+        uint32_t planeId = 0;
+        for (int side = 1; side <= 2; side++) {
+            int axis = (refAxis + side) % 3;
+            glm::vec3 sideNormal = refRotation[axis];
+            float center = glm::dot(refPos, sideNormal);
+
+            count = clipPolygon(polygon, count, sideNormal, center + refHalf[axis], planeId++, clipped);
+            if (count == 0) return 0;
+            count = clipPolygon(clipped, count, -sideNormal, -center + refHalf[axis], planeId++, polygon);
+            if (count == 0) return 0;
+        }
+
+        //a quad clipped by 4 planes has at most 8 corners, keep those that sank below the reference face
+        Contact points[8];
+        int pointCount = 0;
+        float faceOffset = glm::dot(refPos, normal) + refHalf[refAxis];
+        uint32_t faceId = static_cast<uint32_t>((referenceIsA ? 0 : 3) + refAxis);
+        for (int k = 0; k < count; k++) {
+            float sep = glm::dot(polygon[k].position, normal) - faceOffset;
+            if (sep > 0.0f) continue;
+
+            Contact& contact = points[pointCount++];
+            contact.normal = referenceIsA ? normal : -normal;
+            contact.penetration = -sep;
+            contact.point = polygon[k].position - normal * (sep * 0.5f);
+            contact.feature = (faceId << 8) | polygon[k].id;
+        }
+
+        pointCount = reduceManifold(points, pointCount, normal);
+        for (int k = 0; k < pointCount; k++) out[k] = points[k];
+        return pointCount;
+    }
+
+    bool sphereCapsule(const glm::vec3& spherePos, float radiusA, const glm::vec3& capsuleA, const glm::vec3& capsuleB, float radiusB,
+                       Contact& out)
+    {
+        return sphereSphere(spherePos, radiusA, closestOnSegment(spherePos, capsuleA, capsuleB), radiusB, out);
+    }
+
+    int capsuleCapsule(const glm::vec3& a0, const glm::vec3& a1, float radiusA, const glm::vec3& b0, const glm::vec3& b1, float radiusB,
+                       Contact* out)
+    {
+        glm::vec3 dirA = a1 - a0;
+        glm::vec3 dirB = b1 - b0;
+        glm::vec3 crossed = glm::cross(dirA, dirB);
+        float lengthSqA = glm::dot(dirA, dirA);
+
+        //lying (nearly) along each other, one contact at each end of the stretch they share so the top
+        //one does not see-saw on a single point
+        if (lengthSqA > 1e-12f && glm::dot(crossed, crossed) < 1e-3f * lengthSqA * glm::dot(dirB, dirB)) {
+            float t0 = glm::dot(b0 - a0, dirA) / lengthSqA;
+            float t1 = glm::dot(b1 - a0, dirA) / lengthSqA;
+            float lower = glm::max(glm::min(t0, t1), 0.0f);
+            float upper = glm::min(glm::max(t0, t1), 1.0f);
+
+            if (lower < upper) {
+                int count = 0;
+                for (int end = 0; end < 2; end++) {
+                    glm::vec3 pointA = a0 + dirA * (end == 0 ? lower : upper);
+                    if (!sphereSphere(pointA, radiusA, closestOnSegment(pointA, b0, b1), radiusB, out[count])) continue;
+                    out[count++].feature = 1 + end;
+                }
+                return count;
+            }
+        }
+
+        float s, t;
+        closestSegmentSegment(a0, a1, b0, b1, s, t);
+        if (!sphereSphere(a0 + dirA * s, radiusA, b0 + dirB * t, radiusB, out[0])) return 0;
+        out[0].feature = 0;
+        return 1;
+    }
+
+    bool rayCapsule(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& a, const glm::vec3& b, float radius, float maxT, float& t)
+    {
+        glm::vec3 toOrigin = origin - closestOnSegment(origin, a, b);
+        if (glm::dot(toOrigin, toOrigin) <= radius * radius) {
+            t = 0.0f;
+            return true;
+        }
+
+        //the two end caps, then the side of the cylinder between them
+        bool hit = false;
+        float capT;
+        if (raySphere(origin, dir, a, radius, maxT, capT)) { t = capT; maxT = capT; hit = true; }
+        if (raySphere(origin, dir, b, radius, maxT, capT)) { t = capT; maxT = capT; hit = true; }
+
+        glm::vec3 axis = b - a;
+        float length = glm::length(axis);
+        if (length < 1e-6f) return hit;
+        axis /= length;
+
+        glm::vec3 m = origin - a;
+        glm::vec3 dirSide = dir - axis * glm::dot(dir, axis);
+        glm::vec3 mSide = m - axis * glm::dot(m, axis);
+        float qa = glm::dot(dirSide, dirSide);
+        float qb = glm::dot(mSide, dirSide);
+        float qc = glm::dot(mSide, mSide) - radius * radius;
+        float discriminant = qb * qb - qa * qc;
+        if (qa < 1e-12f || discriminant < 0.0f) return hit;
+
+        float sideT = (-qb - std::sqrt(discriminant)) / qa;
+        float along = glm::dot(m + dir * sideT, axis);
+        if (sideT < 0.0f || sideT > maxT || along < 0.0f || along > length) return hit;
+
+        t = sideT;
+        return true;
+    }
+
+    bool rayConvexHull(const glm::vec3& origin, const glm::vec3& dir, const ConvexHull& hull, float maxT, float& t)
+    {
+        if (hull.planes.empty()) return false;
+
+        //same clipping as the box slabs, just with one plane at a time
+        float tMin = 0.0f;
+        float tMax = maxT;
+        for (const glm::vec4& plane : hull.planes) {
+            glm::vec3 normal(plane);
+            float denominator = glm::dot(normal, dir);
+            float gap = plane.w - glm::dot(normal, origin);
+
+            if (std::fabs(denominator) < 1e-8f) {
+                if (gap < 0.0f) return false;
+                continue;
+            }
+
+            float planeT = gap / denominator;
+            if (denominator < 0.0f) tMin = glm::max(tMin, planeT);
+            else tMax = glm::min(tMax, planeT);
+            if (tMin > tMax) return false;
+        }
+
+        t = tMin;
+        return true;
+    }
+}
@@ -0,0 +1,400 @@
+#include "Determinism.h"
+#include "CollisionDispatch.h"
+#include "Gjk.h"
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+
+namespace {
+    //a face is only used for a contact patch when its normal is this close to the GJK/EPA normal,
+    //anything steeper is an edge or corner touching and gets the single deepest point
+    const float FACE_ALIGNMENT = 0.9f;
+    //pushes side planes out a little before clipping, see CLIP_TOLERANCE in boxBox
+    const float CLIP_TOLERANCE = 1e-3f;
+    //a capsule's middle only adds a contact when it is this much deeper than its ends
+    const float CAPSULE_MIDDLE_MARGIN = 1e-3f;
+    //box or hull faces can have up to this many corners, a clipped face one more per side plane
+    const int MAX_FACE_POINTS = 2 * static_cast<int>(MAX_HULL_VERTICES);
+
+    struct FacePoint {
+        glm::vec3 position;
+        uint32_t id;    //incident corner it came from, or the reference side that cut it and the edge it cut
+    };
+
+    struct Face {
+        glm::vec3 normal;
+        FacePoint points[MAX_FACE_POINTS];
+        int count = 0;
+        uint32_t id = 0;
+    };
+
+    glm::vec3 capsuleEnd(const ShapeInstance& capsule, int end)
+    {
+        glm::vec3 axis = capsule.rotation[1] * capsule.halfHeight;
+        return end == 0 ? capsule.position - axis : capsule.position + axis;
+    }
+
+    //corners of a box or hull in world space, returns how many
+    int shapeCorners(const ShapeInstance& shape, glm::vec3* out)
+    {
+        if (shape.type == ShapeType::CONVEX_HULL) {
+            const std::vector<glm::vec3>& vertices = shape.hull->vertices;
+            for (size_t k = 0; k < vertices.size(); k++) out[k] = shape.position + shape.rotation * vertices[k];
+            return static_cast<int>(vertices.size());
+        }
+
+        const glm::vec3& h = shape.halfExtents;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 local((corner & 1) ? h.x : -h.x, (corner & 2) ? h.y : -h.y, (corner & 4) ? h.z : -h.z);
+            out[corner] = shape.position + shape.rotation * local;
+        }
+        return 8;
+    }
+
+    //face of a box or hull whose normal points most along dir, in world space. returns how well it lines up
+    float bestFace(const ShapeInstance& shape, const glm::vec3& dir, Face& face)
+    {
+        const glm::vec3 local = glm::transpose(shape.rotation) * dir;
+
+        if (shape.type == ShapeType::CONVEX_HULL) {
+            const ConvexHull& hull = *shape.hull;
+            uint32_t best = 0;
+            float bestAlignment = -FLT_MAX;
+            for (uint32_t f = 0; f < hull.planes.size(); f++) {
+                float alignment = glm::dot(glm::vec3(hull.planes[f]), local);
+                if (alignment > bestAlignment) { bestAlignment = alignment; best = f; }
+            }
+
+            face.normal = shape.rotation * glm::vec3(hull.planes[best]);
+            face.count = 0;
+            face.id = best;
+            for (uint32_t k = hull.faceStarts[best]; k < hull.faceStarts[best + 1]; k++) {
+                face.points[face.count] = { shape.position + shape.rotation * hull.vertices[hull.faceVertices[k]], k - hull.faceStarts[best] };
+                face.count++;
+            }
+            return bestAlignment;
+        }
+
+        int axis = 0;
+        if (std::fabs(local.y) > std::fabs(local[axis])) axis = 1;
+        if (std::fabs(local.z) > std::fabs(local[axis])) axis = 2;
+        float sign = local[axis] < 0.0f ? -1.0f : 1.0f;
+
+        const glm::vec3& h = shape.halfExtents;
+        glm::vec3 center = shape.position + shape.rotation[axis] * (sign * h[axis]);
+        glm::vec3 u = shape.rotation[(axis + 1) % 3] * h[(axis + 1) % 3];
+        glm::vec3 v = shape.rotation[(axis + 2) % 3] * h[(axis + 2) % 3];
+        face.normal = shape.rotation[axis] * sign;
+        face.points[0] = { center + u + v, 0 };
+        face.points[1] = { center - u + v, 1 };
+        face.points[2] = { center - u - v, 2 };
+        face.points[3] = { center + u - v, 3 };
+        face.count = 4;
+        face.id = static_cast<uint32_t>(axis * 2 + (sign > 0.0f ? 1 : 0));
+        return std::fabs(local[axis]);
+    }
+
+    //keeps the part of the polygon where dot(p, normal) <= offset, Sutherland-Hodgman
+    int clipFace(const FacePoint* in, int count, const glm::vec3& normal, float offset, uint32_t sideId, FacePoint* out)
+    {
+        int outCount = 0;
+        for (int k = 0; k < count; k++) {
+            const FacePoint& current = in[k];
+            const FacePoint& next = in[(k + 1) % count];
+            float distCurrent = glm::dot(current.position, normal) - offset - CLIP_TOLERANCE;
+            float distNext = glm::dot(next.position, normal) - offset - CLIP_TOLERANCE;
+
+            if (distCurrent <= 0.0f) out[outCount++] = current;
+            if ((distCurrent <= 0.0f) != (distNext <= 0.0f) && outCount < MAX_FACE_POINTS) {
+                float t = distCurrent / (distCurrent - distNext);
+                out[outCount++] = { current.position + (next.position - current.position) * t, 0x1000u | (sideId << 6) | (current.id & 63u) };
+            }
+        }
+        return outCount;
+    }
+
+    //tests that only ever give one point, the feature is always 0
+    int singlePoint(bool hit, Contact* out)
+    {
+        out[0].feature = 0;
+        return hit ? 1 : 0;
+    }
+
+    int sphereSphere(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return singlePoint(Narrowphase::sphereSphere(a.position, a.radius, b.position, b.radius, out[0]), out);
+    }
+
+    int sphereAABB(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return singlePoint(Narrowphase::sphereAABB(a.position, a.radius, b.position, b.halfExtents, out[0]), out);
+    }
+
+    int sphereOBB(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return singlePoint(Narrowphase::sphereOBB(a.position, a.radius, b.position, b.rotation, b.halfExtents, out[0]), out);
+    }
+
+    int sphereCapsule(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return singlePoint(Narrowphase::sphereCapsule(a.position, a.radius, capsuleEnd(b, 0), capsuleEnd(b, 1), b.radius, out[0]), out);
+    }
+
+    int aabbAABB(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return singlePoint(Narrowphase::aabbAABB(a.position, a.halfExtents, b.position, b.halfExtents, out[0]), out);
+    }
+
+    //an AABB is just a box whose rotation stays identity
+    int boxBox(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return Narrowphase::boxBox(a.position, a.rotation, a.halfExtents, b.position, b.rotation, b.halfExtents, out);
+    }
+
+    int capsuleCapsule(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        return Narrowphase::capsuleCapsule(capsuleEnd(a, 0), capsuleEnd(a, 1), a.radius, capsuleEnd(b, 0), capsuleEnd(b, 1), b.radius, out);
+    }
+
+    //one GJK/EPA query turned into a contact halfway between the two surfaces
+    bool gjkContact(const ShapeInstance& a, const ShapeInstance& b, Contact& out)
+    {
+        Gjk::Result result;
+        if (!Gjk::closestPoints(a, b, result)) return false;
+
+        float radiusA = Gjk::coreRadius(a);
+        float radiusB = Gjk::coreRadius(b);
+        float penetration = radiusA + radiusB - result.separation;
+        if (penetration <= 0.0f) return false;
+
+        out.normal = result.normal;
+        out.penetration = penetration;
+        out.point = ((result.pointA + result.normal * radiusA) + (result.pointB - result.normal * radiusB)) * 0.5f;
+        out.feature = 0;
+        return true;
+    }
+
+    //anything with a hull, and spheres against anything without a test of its own. GJK/EPA finds the
+    //normal and the deepest point. two polytopes lying face on face need more than that one point to not
+    //rock, so then the other one's face is clipped against the better aligned face, as in boxBox
+    int convexConvex(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        if (!gjkContact(a, b, out[0])) return 0;
+        if (Gjk::coreRadius(a) > 0.0f || Gjk::coreRadius(b) > 0.0f) return 1;
+
+        const glm::vec3 n = out[0].normal;
+        Face faceA, faceB;
+        float alignmentA = bestFace(a, n, faceA);
+        float alignmentB = bestFace(b, -n, faceB);
+        if (glm::max(alignmentA, alignmentB) < FACE_ALIGNMENT) return 1;
+
+        bool referenceIsA = alignmentA >= alignmentB;
+        const Face& reference = referenceIsA ? faceA : faceB;
+        const ShapeInstance& incidentShape = referenceIsA ? b : a;
+        Face incident;
+        bestFace(incidentShape, -reference.normal, incident);
+
+        //clip against a side plane through every edge of the reference face, pointing away from its middle
+        glm::vec3 middle(0.0f);
+        for (int k = 0; k < reference.count; k++) middle += reference.points[k].position;
+        middle /= static_cast<float>(reference.count);
+
+        FacePoint buffers[2][MAX_FACE_POINTS];
+        int count = incident.count;
+        for (int k = 0; k < count; k++) buffers[0][k] = incident.points[k];
+        int current = 0;
+        for (int k = 0; k < reference.count && count > 0; k++) {
+            const glm::vec3& start = reference.points[k].position;
+            const glm::vec3& end = reference.points[(k + 1) % reference.count].position;
+            glm::vec3 side = glm::cross(end - start, reference.normal);
+            if (glm::dot(side, middle - start) > 0.0f) side = -side;
+            float length = glm::length(side);
+            if (length < 1e-9f) continue;
+            side /= length;
+
+            count = clipFace(buffers[current], count, side, glm::dot(side, start), static_cast<uint32_t>(k), buffers[1 - current]);
+            current = 1 - current;
+        }
+
+        //whatever is left and below the reference face is touching
+        Contact points[MAX_FACE_POINTS];
+        int pointCount = 0;
+        float faceOffset = glm::dot(reference.normal, reference.points[0].position);
+        uint32_t faceId = (referenceIsA ? 0u : 0x80u) | reference.id;
+        for (int k = 0; k < count; k++) {
+            float separation = glm::dot(buffers[current][k].position, reference.normal) - faceOffset;
+            if (separation > 0.0f) continue;
+
+            Contact& contact = points[pointCount++];
+            contact.normal = referenceIsA ? reference.normal : -reference.normal;
+            contact.penetration = -separation;
+            contact.point = buffers[current][k].position - reference.normal * (separation * 0.5f);
+            contact.feature = (faceId << 24) | (incident.id << 16) | buffers[current][k].id;
+        }
+        if (pointCount == 0) return 1;
+
+        pointCount = Narrowphase::reduceManifold(points, pointCount, reference.normal);
+        for (int k = 0; k < pointCount; k++) out[k] = points[k];
+        return pointCount;
+    }
+
+    //capsule against a box or hull. the closest point alone lets a capsule lying on a face roll around
+    //on it, so both ends get tested as spheres as well
+    int capsuleConvex(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        int count = 0;
+        float deepestEnd = -FLT_MAX;
+        for (int end = 0; end < 2; end++) {
+            ShapeInstance sphere;
+            sphere.type = ShapeType::SPHERE;
+            sphere.position = capsuleEnd(a, end);
+            sphere.radius = a.radius;
+
+            if (!gjkContact(sphere, b, out[count])) continue;
+            out[count].feature = 1 + end;
+            deepestEnd = glm::max(deepestEnd, out[count].penetration);
+            count++;
+        }
+
+        //the middle of the capsule across an edge, only worth a contact when it is deeper than the ends
+        Contact middle;
+        if (gjkContact(a, b, middle) && middle.penetration > deepestEnd + CAPSULE_MIDDLE_MARGIN) out[count++] = middle;
+        return count;
+    }
+
+    //deepest MAX_MANIFOLD corners against the plane, in order of depth
+    int deepestCorners(const ShapeInstance& plane, const glm::vec3* corners, int cornerCount, Contact* out)
+    {
+        int count = 0;
+        for (int corner = 0; corner < cornerCount; corner++) {
+            float separation = glm::dot(corners[corner], plane.normal) - plane.distance;
+
+            //insertion into the deepest MAX_MANIFOLD so far
+            int slot = count < MAX_MANIFOLD ? count++ : MAX_MANIFOLD;
+            while (slot > 0 && -out[slot - 1].penetration > separation) {
+                if (slot < MAX_MANIFOLD) out[slot] = out[slot - 1];
+                slot--;
+            }
+            if (slot < MAX_MANIFOLD) {
+                out[slot] = { INVALID_BODY, INVALID_BODY, plane.normal, corners[corner], -separation, static_cast<uint32_t>(corner) };
+            }
+        }
+        return count;
+    }
+
+    int planeSphere(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        glm::vec3 lowest = b.position - a.normal * b.radius;
+        out[0] = { INVALID_BODY, INVALID_BODY, a.normal, lowest, a.distance - glm::dot(lowest, a.normal), 0 };
+        return 1;
+    }
+
+    //a box that can not turn only ever needs its lowest point
+    int planeAABB(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        glm::vec3 lowest = b.position - a.normal * glm::dot(b.halfExtents, glm::abs(a.normal));
+        out[0] = { INVALID_BODY, INVALID_BODY, a.normal, lowest, a.distance - glm::dot(lowest, a.normal), 0 };
+        return 1;
+    }
+
+    int planeCapsule(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        int count = b.halfHeight > 0.0f ? 2 : 1;
+        for (int end = 0; end < count; end++) {
+            glm::vec3 lowest = capsuleEnd(b, end) - a.normal * b.radius;
+            out[end] = { INVALID_BODY, INVALID_BODY, a.normal, lowest, a.distance - glm::dot(lowest, a.normal), static_cast<uint32_t>(end) };
+        }
+        return count;
+    }
+
+    //boxes that turn and hulls, so they rock and tip over on their edges
+    int planeCorners(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        glm::vec3 corners[MAX_HULL_VERTICES];
+        return deepestCorners(a, corners, shapeCorners(b, corners), out);
+    }
+
+    //b against a, then turned around so the normal runs a -> b again
+    template<CollideFunction Function>
+    int flipped(const ShapeInstance& a, const ShapeInstance& b, Contact* out)
+    {
+        int count = Function(b, a, out);
+        for (int k = 0; k < count; k++) out[k].normal = -out[k].normal;
+        return count;
+    }
+
+    using Table = std::array<CollideFunction, CollisionDispatch::PAIR_TYPE_COUNT>;
+
+    template<CollideFunction Function>
+    void set(Table& table, ShapeType a, ShapeType b)
+    {
+        table[CollisionDispatch::pairType(a, b)] = Function;
+        if (a != b) table[CollisionDispatch::pairType(b, a)] = flipped<Function>;
+    }
+
+    Table buildTable()
+    {
+        Table table{};
+        set<planeSphere>(table, ShapeType::PLANE, ShapeType::SPHERE);
+        set<planeAABB>(table, ShapeType::PLANE, ShapeType::AABB);
+        set<planeCorners>(table, ShapeType::PLANE, ShapeType::OBB);
+        set<planeCapsule>(table, ShapeType::PLANE, ShapeType::CAPSULE);
+        set<planeCorners>(table, ShapeType::PLANE, ShapeType::CONVEX_HULL);
+
+        set<sphereSphere>(table, ShapeType::SPHERE, ShapeType::SPHERE);
+        set<sphereAABB>(table, ShapeType::SPHERE, ShapeType::AABB);
+        set<sphereOBB>(table, ShapeType::SPHERE, ShapeType::OBB);
+        set<sphereCapsule>(table, ShapeType::SPHERE, ShapeType::CAPSULE);
+        set<convexConvex>(table, ShapeType::SPHERE, ShapeType::CONVEX_HULL);
+
+        set<aabbAABB>(table, ShapeType::AABB, ShapeType::AABB);
+        set<boxBox>(table, ShapeType::AABB, ShapeType::OBB);
+        set<capsuleConvex>(table, ShapeType::CAPSULE, ShapeType::AABB);
+        set<convexConvex>(table, ShapeType::AABB, ShapeType::CONVEX_HULL);
+
+        set<boxBox>(table, ShapeType::OBB, ShapeType::OBB);
+        set<capsuleConvex>(table, ShapeType::CAPSULE, ShapeType::OBB);
+        set<convexConvex>(table, ShapeType::OBB, ShapeType::CONVEX_HULL);
+
+        set<capsuleCapsule>(table, ShapeType::CAPSULE, ShapeType::CAPSULE);
+        set<capsuleConvex>(table, ShapeType::CAPSULE, ShapeType::CONVEX_HULL);
+
+        set<convexConvex>(table, ShapeType::CONVEX_HULL, ShapeType::CONVEX_HULL);
+        return table;
+    }
+
+    const Table TABLE = buildTable();
+}
+
+
+namespace CollisionDispatch
+{
+    CollideFunction get(int pairType)
+    {
+        return TABLE[pairType];
+    }
+
+    ShapeInstance bodyShape(const RigidBodyStore& bodies, uint32_t index)
+    {
+        const uint32_t colliderIndex = bodies.colliderIndex[index];
+        ShapeInstance shape;
+        shape.type = bodies.getCollider(colliderIndex).type;
+        shape.position = glm::vec3(bodies.posX[index], bodies.posY[index], bodies.posZ[index]);
+        shape.rotation = bodies.rotationAt(index);
+        shape.radius = bodies.radius[index];
+        shape.halfHeight = bodies.halfY[index];
+        shape.halfExtents = glm::vec3(bodies.halfX[index], bodies.halfY[index], bodies.halfZ[index]);
+        if (shape.type == ShapeType::CONVEX_HULL) shape.hull = &bodies.getHull(colliderIndex);
+        return shape;
+    }
+
+    ShapeInstance planeShape(const glm::vec3& normal, float distance)
+    {
+        ShapeInstance shape;
+        shape.type = ShapeType::PLANE;
+        shape.normal = normal;
+        shape.distance = distance;
+        return shape;
+    }
+}
@@ -0,0 +1,129 @@
+#include "CommandBuffer.h"
+#include <algorithm>
+#include <iostream>
+
+
+Entity CommandBuffer::spawn(uint64_t sortKey)
+{
+    //NULL_ENTITY is the placeholder index with the top generation, so that one is off limits. past it
+    //the generation would wrap and two spawns would share a placeholder. NULL_ENTITY makes playback
+    //skip this spawn and everything recorded for it
+    if (m_placeholders >= ENTITY_GENERATION_MASK) {
+        std::cerr << "ERROR::COMMANDS: more than " << ENTITY_GENERATION_MASK
+                  << " spawns recorded on one thread this frame, dropping the rest" << std::endl;
+        return NULL_ENTITY;
+    }
+    Entity placeholder = makeEntity(MAX_ENTITIES, m_placeholders++);
+    push(sortKey, CommandType::SPAWN, placeholder, nullptr, nullptr);
+    return placeholder;
+}
+
+void CommandBuffer::push(uint64_t sortKey, CommandType type, Entity entity, void* payload, void (*apply)(Registry&, Entity, void*))
+{
+    m_commands.push_back({ sortKey, type, entity, payload, apply, nullptr });
+}
+
+void* CommandBuffer::allocate(size_t size)
+{
+    const size_t alignment = alignof(std::max_align_t);
+    size_t offset = (m_blockUsed + alignment - 1) / alignment * alignment;
+
+    if (size > BLOCK_BYTES) {
+        //rare, it gets a block of its own and the next payload starts a fresh one
+        size_t count = (size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+        m_blocks.push_back(std::make_unique<std::max_align_t[]>(count));
+        m_blockUsed = BLOCK_BYTES;
+        return m_blocks.back().get();
+    }
+
+    if (m_blocks.empty() || offset + size > BLOCK_BYTES) {
+        m_blocks.push_back(std::make_unique<std::max_align_t[]>(BLOCK_BYTES / sizeof(std::max_align_t)));
+        offset = 0;
+    }
+
+    m_blockUsed = offset + size;
+    return reinterpret_cast<std::byte*>(m_blocks.back().get()) + offset;
+}
+
+void CommandBuffer::clear()
+{
+    for (Command& command : m_commands) {
+        if (command.destroyPayload) command.destroyPayload(command.payload);
+    }
+    m_commands.clear();
+    m_blocks.clear();
+    m_blockUsed = BLOCK_BYTES;
+    m_placeholders = 0;
+    m_spawned.clear();
+}
+
+
+CommandQueue::CommandQueue(JobSystem* jobs)
+    : m_jobs(jobs)
+{
+    unsigned count = jobs ? jobs->getThreadCount() : 1;
+    for (unsigned i = 0; i < count; i++) {
+        m_buffers.push_back(std::make_unique<CommandBuffer>());
+    }
+}
+
+CommandRecorder CommandQueue::record(uint64_t sortKey)
+{
+    return CommandRecorder(*m_buffers[m_jobs ? m_jobs->currentThreadIndex() : 0], sortKey);
+}
+
+size_t CommandQueue::size() const
+{
+    size_t total = 0;
+    for (const std::unique_ptr<CommandBuffer>& buffer : m_buffers) total += buffer->size();
+    return total;
+}
+
+void CommandQueue::playback(Registry& registry, const std::function<void(Entity)>& onDestroy)
+{
+    m_order.clear();
+    for (uint32_t b = 0; b < m_buffers.size(); b++) {
+        CommandBuffer& buffer = *m_buffers[b];
+        for (uint32_t c = 0; c < buffer.m_commands.size(); c++) {
+            m_order.push_back({ buffer.m_commands[c].sortKey, b, c });
+        }
+        buffer.m_spawned.assign(buffer.m_placeholders, NULL_ENTITY);
+    }
+
+    //stable, so one recorder's commands (all in one buffer, in recording order) keep their order
+    std::stable_sort(m_order.begin(), m_order.end(), [](const Entry& a, const Entry& b) { return a.sortKey < b.sortKey; });
+
+    for (const Entry& entry : m_order) {
+        CommandBuffer& buffer = *m_buffers[entry.buffer];
+        CommandBuffer::Command& command = buffer.m_commands[entry.command];
+
+        Entity entity = command.entity;
+        if (CommandBuffer::isPlaceholder(entity)) {
+            uint32_t placeholder = entityGeneration(entity);
+            if (command.type == CommandBuffer::CommandType::SPAWN) {
+                buffer.m_spawned[placeholder] = registry.create();
+                continue;
+            }
+            entity = buffer.m_spawned[placeholder];
+        }
+
+        //whatever the command was about may have been destroyed by an earlier one, that is not an error
+        if (!registry.valid(entity)) continue;
+
+        switch (command.type) {
+        case CommandBuffer::CommandType::DESTROY:
+            if (onDestroy) onDestroy(entity);
+            registry.destroy(entity);
+            break;
+        case CommandBuffer::CommandType::ADD:
+        case CommandBuffer::CommandType::SET:
+        case CommandBuffer::CommandType::REMOVE:
+            command.apply(registry, entity, command.payload);
+            break;
+        case CommandBuffer::CommandType::SPAWN:
+            break;
+        }
+    }
+
+    for (const std::unique_ptr<CommandBuffer>& buffer : m_buffers) buffer->clear();
+}
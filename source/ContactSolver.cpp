@@ -0,0 +1,378 @@
+#include "Determinism.h"
+#include "ContactSolver.h"
+#include "CollisionDispatch.h"
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+    const float BAUMGARTE = 0.2f;       //fraction of the penetration removed per step
+    const float SLOP = 0.005f;          //penetration left alone so resting contacts stay touching
+    const float PLANE_MARGIN = 0.01f;   //plane contacts are kept a little before actually touching
+    const float WARM_START_NORMAL = 0.95f; //cached impulses only carry over if the normal barely turned
+
+    //any two directions perpendicular to n and each other
+    void tangentBasis(const glm::vec3& n, glm::vec3& t1, glm::vec3& t2)
+    {
+        if (glm::abs(n.x) >= 0.57735f) t1 = glm::normalize(glm::vec3(n.y, -n.x, 0.0f));
+        else t1 = glm::normalize(glm::vec3(0.0f, n.z, -n.y));
+        t2 = glm::cross(n, t1);
+    }
+}
+
+
+void ContactSolver::begin(const RigidBodyStore& bodies, const IslandBuilder& islands, const glm::vec3& planeNormal, float planeDistance,
+                          const std::vector<float>& planeSeparation)
+{
+    m_planeNormal = planeNormal;
+    m_planeDistance = planeDistance;
+    m_planeSeparation = planeSeparation.data();
+
+    m_solverContacts.resize(islands.getContacts().size() + MAX_MANIFOLD * islands.getBodies().size());
+    m_solverCounts.assign(islands.getIslands().size(), 0);
+    m_solverBegins.resize(islands.getIslands().size());
+    for (size_t k = 0; k < m_solverBegins.size(); k++) {
+        const Island& island = islands.getIslands()[k];
+        m_solverBegins[k] = island.contactBegin + MAX_MANIFOLD * island.bodyBegin;
+    }
+
+    for (std::vector<float>* pseudo : { &m_pseudoX, &m_pseudoY, &m_pseudoZ, &m_pseudoAngX, &m_pseudoAngY, &m_pseudoAngZ }) {
+        pseudo->resize(bodies.size());
+    }
+}
+
+const ContactSolver::CachedImpulse* ContactSolver::findCached(uint64_t key, uint32_t feature) const
+{
+    auto it = std::lower_bound(m_cache.begin(), m_cache.end(), std::make_pair(key, feature),
+        [](const CachedImpulse& entry, const std::pair<uint64_t, uint32_t>& k) {
+            return entry.key != k.first ? entry.key < k.first : entry.feature < k.second;
+        });
+    return it != m_cache.end() && it->key == key && it->feature == feature ? &*it : nullptr;
+}
+
+glm::vec3 ContactSolver::relativeVelocity(const RigidBodyStore& bodies, const SolverContact& c) const
+{
+    glm::vec3 velB = glm::vec3(bodies.velX[c.ib], bodies.velY[c.ib], bodies.velZ[c.ib]) +
+                     glm::cross(glm::vec3(bodies.angVelX[c.ib], bodies.angVelY[c.ib], bodies.angVelZ[c.ib]), c.armB);
+    if (c.ia == PLANE) return velB;
+
+    glm::vec3 velA = glm::vec3(bodies.velX[c.ia], bodies.velY[c.ia], bodies.velZ[c.ia]) +
+                     glm::cross(glm::vec3(bodies.angVelX[c.ia], bodies.angVelY[c.ia], bodies.angVelZ[c.ia]), c.armA);
+    return velB - velA;
+}
+
+void ContactSolver::applyImpulse(RigidBodyStore& bodies, const SolverContact& c, const glm::vec3& impulse) const
+{
+    //static bodies are shared between islands on different threads, only the dynamic side is written
+    if (c.invMassA > 0.0f) {
+        bodies.velX[c.ia] -= impulse.x * c.invMassA;
+        bodies.velY[c.ia] -= impulse.y * c.invMassA;
+        bodies.velZ[c.ia] -= impulse.z * c.invMassA;
+        glm::vec3 spin = bodies.applyInvInertia(c.ia, glm::cross(c.armA, impulse));
+        bodies.angVelX[c.ia] -= spin.x;
+        bodies.angVelY[c.ia] -= spin.y;
+        bodies.angVelZ[c.ia] -= spin.z;
+    }
+    if (c.invMassB > 0.0f) {
+        bodies.velX[c.ib] += impulse.x * c.invMassB;
+        bodies.velY[c.ib] += impulse.y * c.invMassB;
+        bodies.velZ[c.ib] += impulse.z * c.invMassB;
+        glm::vec3 spin = bodies.applyInvInertia(c.ib, glm::cross(c.armB, impulse));
+        bodies.angVelX[c.ib] += spin.x;
+        bodies.angVelY[c.ib] += spin.y;
+        bodies.angVelZ[c.ib] += spin.z;
+    }
+}
+
+float ContactSolver::effectiveMass(const RigidBodyStore& bodies, const SolverContact& c, const glm::vec3& direction) const
+{
+    //how much velocity along direction a unit impulse buys, linear part plus what the spin adds at the point
+    float inverse = c.invMassA + c.invMassB;
+    if (c.invMassA > 0.0f) {
+        glm::vec3 torque = glm::cross(c.armA, direction);
+        inverse += glm::dot(torque, bodies.applyInvInertia(c.ia, torque));
+    }
+    if (c.invMassB > 0.0f) {
+        glm::vec3 torque = glm::cross(c.armB, direction);
+        inverse += glm::dot(torque, bodies.applyInvInertia(c.ib, torque));
+    }
+    return inverse > 0.0f ? 1.0f / inverse : 0.0f;
+}
+
+float ContactSolver::prepare(RigidBodyStore& bodies, SolverContact& c, const glm::vec3& point, float penetration, float restitution,
+                             float restitutionThreshold, float deltaTime) const
+{
+    c.invMassA = c.ia == PLANE ? 0.0f : bodies.inverseMass[c.ia];
+    c.invMassB = bodies.inverseMass[c.ib];
+    c.armA = c.ia == PLANE ? glm::vec3(0.0f) : point - glm::vec3(bodies.posX[c.ia], bodies.posY[c.ia], bodies.posZ[c.ia]);
+    c.armB = point - glm::vec3(bodies.posX[c.ib], bodies.posY[c.ib], bodies.posZ[c.ib]);
+    tangentBasis(c.normal, c.tangent1, c.tangent2);
+    c.normalMass = effectiveMass(bodies, c, c.normal);
+    c.tangentMass1 = effectiveMass(bodies, c, c.tangent1);
+    c.tangentMass2 = effectiveMass(bodies, c, c.tangent2);
+
+    //a contact that is not touching yet only stops the bodies from closing more than the gap this step
+    c.velocityTarget = 0.0f;
+    c.positionBias = 0.0f;
+    if (penetration < 0.0f) {
+        c.velocityTarget = penetration / deltaTime;
+    }
+    else {
+        float correction = BAUMGARTE / deltaTime * glm::max(penetration - SLOP, 0.0f);
+        if (m_settings.positionCorrection == PositionCorrection::BAUMGARTE) c.velocityTarget = correction;
+        else c.positionBias = correction;
+    }
+
+    c.normalImpulse = 0.0f;
+    c.tangentImpulse1 = 0.0f;
+    c.tangentImpulse2 = 0.0f;
+    c.pseudoImpulse = 0.0f;
+
+    if (m_settings.warmStarting) {
+        const CachedImpulse* cached = findCached(c.key, c.feature);
+        if (cached && glm::dot(cached->normal, c.normal) > WARM_START_NORMAL) {
+            c.normalImpulse = cached->normalImpulse;
+            c.tangentImpulse1 = glm::dot(cached->frictionImpulse, c.tangent1);
+            c.tangentImpulse2 = glm::dot(cached->frictionImpulse, c.tangent2);
+        }
+    }
+
+    //bounce off the approach speed from before any impulses, not whatever the iterations leave
+    float approach = -glm::dot(relativeVelocity(bodies, c), c.normal);
+    if (approach <= restitutionThreshold) return 0.0f;
+
+    c.velocityTarget = glm::max(c.velocityTarget, restitution * approach);
+    return approach;
+}
+
+uint32_t ContactSolver::addPlaneContacts(RigidBodyStore& bodies, uint32_t i, float deltaTime, SolverContact* out, float& bounce) const
+{
+    const glm::vec3 n = m_planeNormal;
+    const glm::vec3 position(bodies.posX[i], bodies.posY[i], bodies.posZ[i]);
+    const glm::vec3 velocity(bodies.velX[i], bodies.velY[i], bodies.velZ[i]);
+    const glm::vec3 angularVelocity(bodies.angVelX[i], bodies.angVelY[i], bodies.angVelZ[i]);
+    const glm::vec3 half(bodies.halfX[i], bodies.halfY[i], bodies.halfZ[i]);
+
+    //speculative, anything that can reach the plane within this step gets its contacts now
+    float reach = glm::max(-glm::dot(velocity, n), 0.0f) + glm::length(angularVelocity) * glm::length(half);
+    bounce = 0.0f;
+    if (m_planeSeparation[i] > PLANE_MARGIN + reach * deltaTime) return 0;
+
+    //the deepest points of the shape, spheres have one, capsules one per end, boxes and hulls up to
+    //MAX_MANIFOLD corners so they rock and tip over on their edges
+    CollideFunction collide = CollisionDispatch::get(ShapeType::PLANE, bodies.getCollider(bodies.colliderIndex[i]).type);
+    if (!collide) return 0;
+    Contact points[MAX_MANIFOLD];
+    int pointCount = collide(CollisionDispatch::planeShape(n, m_planeDistance), CollisionDispatch::bodyShape(bodies, i), points);
+
+    uint32_t count = 0;
+    for (int k = 0; k < pointCount; k++) {
+        glm::vec3 arm = points[k].point - position;
+        float approach = glm::max(-glm::dot(velocity + glm::cross(angularVelocity, arm), n), 0.0f);
+        if (-points[k].penetration > PLANE_MARGIN + approach * deltaTime) continue;
+
+        SolverContact& c = out[count++];
+        c.key = pairKey(INVALID_BODY, bodies.idAt(i));
+        c.feature = points[k].feature;
+        c.ia = PLANE;
+        c.ib = i;
+        c.normal = n;
+        bounce = glm::max(bounce, prepare(bodies, c, points[k].point, points[k].penetration, m_settings.planeRestitution,
+                                          m_settings.planeRestitutionThreshold, deltaTime));
+    }
+    return count;
+}
+
+void ContactSolver::solveIsland(RigidBodyStore& bodies, const std::vector<Contact>& contacts, const IslandBuilder& islands,
+                                uint32_t islandIndex, float deltaTime, std::vector<ImpactEvent>& impacts)
+{
+    const Island& island = islands.getIslands()[islandIndex];
+    const uint32_t* members = islands.getBodies().data() + island.bodyBegin;
+    const uint32_t* islandContacts = islands.getContacts().data() + island.contactBegin;
+    SolverContact* solverContacts = m_solverContacts.data() + m_solverBegins[islandIndex];
+
+    uint32_t count = 0;
+    uint64_t lastImpactKey = 0;
+    bool anyImpact = false;
+    for (uint32_t k = 0; k < island.contactCount; k++) {
+        const Contact& contact = contacts[islandContacts[k]];
+        SolverContact& c = solverContacts[count++];
+        c.key = pairKey(contact.a, contact.b);
+        c.feature = contact.feature;
+        c.ia = bodies.indexOf(contact.a);
+        c.ib = bodies.indexOf(contact.b);
+        c.normal = contact.normal;
+        float approach = prepare(bodies, c, contact.point, contact.penetration, m_settings.restitution,
+                                 m_settings.restitutionThreshold, deltaTime);
+
+        //a manifold's points sit next to each other, one event per pair however many points hit
+        if (approach > 0.0f && !(anyImpact && lastImpactKey == c.key)) {
+            if (c.invMassA > 0.0f) impacts.push_back({ contact.a, approach });
+            if (c.invMassB > 0.0f) impacts.push_back({ contact.b, approach });
+            lastImpactKey = c.key;
+            anyImpact = true;
+        }
+    }
+
+    //the plane joins in as a static body under every member
+    for (uint32_t k = 0; k < island.bodyCount; k++) {
+        uint32_t i = members[k];
+        float bounce;
+        count += addPlaneContacts(bodies, i, deltaTime, solverContacts + count, bounce);
+        if (bounce > 0.0f) impacts.push_back({ bodies.idAt(i), bounce });
+    }
+    m_solverCounts[islandIndex] = count;
+    if (count == 0) return;
+
+    //warm start, only once everything has its approach speed from before any impulse
+    for (uint32_t k = 0; k < count; k++) {
+        const SolverContact& c = solverContacts[k];
+        applyImpulse(bodies, c, c.normal * c.normalImpulse + c.tangent1 * c.tangentImpulse1 + c.tangent2 * c.tangentImpulse2);
+    }
+
+    const int iterations = glm::max(m_settings.iterations, 1);
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (uint32_t k = 0; k < count; k++) {
+            SolverContact& c = solverContacts[k];
+
+            //friction first, limited by however hard the contact is pushing right now
+            glm::vec3 dv = relativeVelocity(bodies, c);
+            float maxFriction = m_settings.friction * c.normalImpulse;
+
+            float old1 = c.tangentImpulse1;
+            float old2 = c.tangentImpulse2;
+            c.tangentImpulse1 = glm::clamp(old1 - glm::dot(dv, c.tangent1) * c.tangentMass1, -maxFriction, maxFriction);
+            c.tangentImpulse2 = glm::clamp(old2 - glm::dot(dv, c.tangent2) * c.tangentMass2, -maxFriction, maxFriction);
+            applyImpulse(bodies, c, c.tangent1 * (c.tangentImpulse1 - old1) + c.tangent2 * (c.tangentImpulse2 - old2));
+
+            //normal, the running total is clamped rather than each step so it can take back overshoot
+            float vn = glm::dot(relativeVelocity(bodies, c), c.normal);
+            float old = c.normalImpulse;
+            c.normalImpulse = glm::max(old + c.normalMass * (c.velocityTarget - vn), 0.0f);
+            applyImpulse(bodies, c, c.normal * (c.normalImpulse - old));
+        }
+    }
+
+    if (m_settings.positionCorrection != PositionCorrection::SPLIT_IMPULSE) return;
+
+    //split impulse, same solve again on separate velocities that only ever move positions
+    for (uint32_t k = 0; k < island.bodyCount; k++) {
+        uint32_t i = members[k];
+        m_pseudoX[i] = m_pseudoY[i] = m_pseudoZ[i] = 0.0f;
+        m_pseudoAngX[i] = m_pseudoAngY[i] = m_pseudoAngZ[i] = 0.0f;
+    }
+
+    auto pseudoVelocity = [&](uint32_t i, const glm::vec3& arm) {
+        return glm::vec3(m_pseudoX[i], m_pseudoY[i], m_pseudoZ[i]) +
+               glm::cross(glm::vec3(m_pseudoAngX[i], m_pseudoAngY[i], m_pseudoAngZ[i]), arm);
+    };
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (uint32_t k = 0; k < count; k++) {
+            SolverContact& c = solverContacts[k];
+
+            glm::vec3 pseudoA = c.invMassA > 0.0f ? pseudoVelocity(c.ia, c.armA) : glm::vec3(0.0f);
+            glm::vec3 pseudoB = c.invMassB > 0.0f ? pseudoVelocity(c.ib, c.armB) : glm::vec3(0.0f);
+
+            float vn = glm::dot(pseudoB - pseudoA, c.normal);
+            float old = c.pseudoImpulse;
+            c.pseudoImpulse = glm::max(old + c.normalMass * (c.positionBias - vn), 0.0f);
+            glm::vec3 impulse = c.normal * (c.pseudoImpulse - old);
+
+            if (c.invMassA > 0.0f) {
+                m_pseudoX[c.ia] -= impulse.x * c.invMassA;
+                m_pseudoY[c.ia] -= impulse.y * c.invMassA;
+                m_pseudoZ[c.ia] -= impulse.z * c.invMassA;
+                glm::vec3 spin = bodies.applyInvInertia(c.ia, glm::cross(c.armA, impulse));
+                m_pseudoAngX[c.ia] -= spin.x;
+                m_pseudoAngY[c.ia] -= spin.y;
+                m_pseudoAngZ[c.ia] -= spin.z;
+            }
+            if (c.invMassB > 0.0f) {
+                m_pseudoX[c.ib] += impulse.x * c.invMassB;
+                m_pseudoY[c.ib] += impulse.y * c.invMassB;
+                m_pseudoZ[c.ib] += impulse.z * c.invMassB;
+                glm::vec3 spin = bodies.applyInvInertia(c.ib, glm::cross(c.armB, impulse));
+                m_pseudoAngX[c.ib] += spin.x;
+                m_pseudoAngY[c.ib] += spin.y;
+                m_pseudoAngZ[c.ib] += spin.z;
+            }
+        }
+    }
+
+    const float halfDt = 0.5f * deltaTime;
+    for (uint32_t k = 0; k < island.bodyCount; k++) {
+        uint32_t i = members[k];
+        bodies.posX[i] += m_pseudoX[i] * deltaTime;
+        bodies.posY[i] += m_pseudoY[i] * deltaTime;
+        bodies.posZ[i] += m_pseudoZ[i] * deltaTime;
+
+        glm::vec3 spin(m_pseudoAngX[i], m_pseudoAngY[i], m_pseudoAngZ[i]);
+        if (spin == glm::vec3(0.0f)) continue;
+
+        //turning needs the same quaternion step as the integrator, then fresh world inertia and bounds
+        glm::quat q(bodies.rotW[i], bodies.rotX[i], bodies.rotY[i], bodies.rotZ[i]);
+        q = glm::normalize(q + glm::quat(0.0f, spin.x, spin.y, spin.z) * q * halfDt);
+        bodies.rotW[i] = q.w;
+        bodies.rotX[i] = q.x;
+        bodies.rotY[i] = q.y;
+        bodies.rotZ[i] = q.z;
+        bodies.updateDerived(i);
+    }
+}
+
+void ContactSolver::end(const RigidBodyStore& bodies)
+{
+    m_nextCache.clear();
+
+    for (size_t k = 0; k < m_solverBegins.size(); k++) {
+        const SolverContact* solverContacts = m_solverContacts.data() + m_solverBegins[k];
+        for (uint32_t c = 0; c < m_solverCounts[k]; c++) {
+            const SolverContact& contact = solverContacts[c];
+            glm::vec3 friction = contact.tangent1 * contact.tangentImpulse1 + contact.tangent2 * contact.tangentImpulse2;
+            m_nextCache.push_back({ contact.key, contact.feature, contact.normal, contact.normalImpulse, friction });
+        }
+    }
+
+    //sleeping bodies generate no contacts, keep what they fell asleep with for when they wake up
+    auto sleeping = [&](BodyId id) {
+        return id != INVALID_BODY && bodies.contains(id) && bodies.state[bodies.indexOf(id)] == EquilibriumState::SLEEPING;
+    };
+    for (const CachedImpulse& entry : m_cache) {
+        if (sleeping(static_cast<BodyId>(entry.key >> 32)) || sleeping(static_cast<BodyId>(entry.key))) {
+            m_nextCache.push_back(entry);
+        }
+    }
+
+    //an island that fell asleep this step has both its fresh entries and the old ones, stable sort
+    //keeps the fresh one first so unique drops the old
+    std::stable_sort(m_nextCache.begin(), m_nextCache.end(),
+        [](const CachedImpulse& a, const CachedImpulse& b) { return a.key != b.key ? a.key < b.key : a.feature < b.feature; });
+    m_nextCache.erase(std::unique(m_nextCache.begin(), m_nextCache.end(),
+        [](const CachedImpulse& a, const CachedImpulse& b) { return a.key == b.key && a.feature == b.feature; }), m_nextCache.end());
+    m_cache.swap(m_nextCache);
+}
+
+void ContactSolver::forgetBodies(const std::vector<BodyId>& removed)
+{
+    if (removed.empty() || m_cache.empty()) return;
+
+    std::vector<BodyId> sorted(removed);
+    std::sort(sorted.begin(), sorted.end());
+    auto gone = [&](BodyId id) { return std::binary_search(sorted.begin(), sorted.end(), id); };
+    m_cache.erase(std::remove_if(m_cache.begin(), m_cache.end(), [&](const CachedImpulse& entry) {
+        return gone(static_cast<BodyId>(entry.key >> 32)) || gone(static_cast<BodyId>(entry.key));
+    }), m_cache.end());
+}
+
+void ContactSolver::hashState(StateHasher& hasher) const
+{
+    hasher.add(static_cast<uint32_t>(m_cache.size()));
+    for (const CachedImpulse& entry : m_cache) {
+        hasher.add(entry.key);
+        hasher.add(entry.feature);
+        hasher.add(entry.normal.x); hasher.add(entry.normal.y); hasher.add(entry.normal.z);
+        hasher.add(entry.normalImpulse);
+        hasher.add(entry.frictionImpulse.x); hasher.add(entry.frictionImpulse.y); hasher.add(entry.frictionImpulse.z);
+    }
+}
@@ -0,0 +1,97 @@
+#include "Determinism.h"
+#include "ConvexHull.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+
+ConvexHull buildConvexHull(const std::vector<glm::vec3>& points)
+{
+    assert(points.size() <= MAX_HULL_VERTICES);
+    ConvexHull hull;
+
+    float size = 0.0f;
+    for (const glm::vec3& p : points) size = glm::max(size, glm::max(std::fabs(p.x), glm::max(std::fabs(p.y), std::fabs(p.z))));
+    const float tolerance = 1e-5f * glm::max(size, 1.0f);
+
+    //every plane through three of the points with nothing in front of it is a face. brute force, but
+    //hulls are small and this runs once per collider
+    const size_t count = points.size();
+    for (size_t i = 0; i < count; i++)
+        for (size_t j = i + 1; j < count; j++)
+            for (size_t k = j + 1; k < count; k++) {
+                glm::vec3 normal = glm::cross(points[j] - points[i], points[k] - points[i]);
+                float length = glm::length(normal);
+                if (length < tolerance) continue;
+                normal /= length;
+
+                float offset = glm::dot(normal, points[i]);
+                float highest = -FLT_MAX, lowest = FLT_MAX;
+                for (const glm::vec3& p : points) {
+                    float d = glm::dot(normal, p) - offset;
+                    highest = glm::max(highest, d);
+                    lowest = glm::min(lowest, d);
+                }
+                if (highest > tolerance && lowest < -tolerance) continue;
+                if (highest > tolerance) {
+                    normal = -normal;
+                    offset = -offset;
+                }
+
+                //coplanar triples of a face with more than 3 corners all find the same plane
+                bool known = false;
+                for (const glm::vec4& plane : hull.planes) {
+                    known |= glm::dot(glm::vec3(plane), normal) > 1.0f - 1e-5f && std::fabs(plane.w - offset) < tolerance;
+                }
+                if (!known) hull.planes.push_back(glm::vec4(normal, offset));
+            }
+
+    //flat or degenerate input has no inside
+    if (hull.planes.size() < 4) {
+        hull.planes.clear();
+        return hull;
+    }
+
+    //corners sit on at least three faces, points in the middle of a face or edge on fewer
+    for (const glm::vec3& p : points) {
+        int touching = 0;
+        for (const glm::vec4& plane : hull.planes) {
+            if (std::fabs(glm::dot(glm::vec3(plane), p) - plane.w) <= tolerance) touching++;
+        }
+        if (touching < 3) continue;
+
+        bool duplicate = false;
+        for (const glm::vec3& v : hull.vertices) duplicate |= glm::dot(v - p, v - p) <= tolerance * tolerance;
+        if (duplicate) continue;
+
+        hull.vertices.push_back(p);
+        hull.halfExtents = glm::max(hull.halfExtents, glm::abs(p));
+    }
+
+    //each face's corners sorted by angle around its middle, so they go round the polygon
+    hull.faceStarts.push_back(0);
+    for (const glm::vec4& plane : hull.planes) {
+        const glm::vec3 normal(plane);
+        std::vector<uint32_t> corners;
+        glm::vec3 middle(0.0f);
+        for (uint32_t v = 0; v < hull.vertices.size(); v++) {
+            if (std::fabs(glm::dot(normal, hull.vertices[v]) - plane.w) > tolerance) continue;
+            corners.push_back(v);
+            middle += hull.vertices[v];
+        }
+        middle /= static_cast<float>(corners.size());
+
+        glm::vec3 u = glm::normalize(hull.vertices[corners[0]] - middle);
+        glm::vec3 w = glm::cross(normal, u);
+        auto angle = [&](uint32_t v) {
+            glm::vec3 d = hull.vertices[v] - middle;
+            return std::atan2(glm::dot(d, w), glm::dot(d, u));
+        };
+        std::sort(corners.begin(), corners.end(), [&](uint32_t x, uint32_t y) { return angle(x) < angle(y); });
+
+        hull.faceVertices.insert(hull.faceVertices.end(), corners.begin(), corners.end());
+        hull.faceStarts.push_back(static_cast<uint32_t>(hull.faceVertices.size()));
+    }
+    return hull;
+}
@@ -0,0 +1,325 @@
+#include "Determinism.h"
+#include "DynamicAABBTree.h"
+#include <algorithm>
+
+
+DynamicAABBTree::DynamicAABBTree(float margin) : m_margin(margin) {}
+
+void DynamicAABBTree::clear()
+{
+    m_nodes.clear();
+    m_proxyOf.clear();
+    m_root = NULL_NODE;
+    m_freeList = NULL_NODE;
+}
+
+int DynamicAABBTree::allocateNode()
+{
+    if (m_freeList == NULL_NODE) {
+        m_nodes.emplace_back();
+        return static_cast<int>(m_nodes.size() - 1);
+    }
+
+    int node = m_freeList;
+    m_freeList = m_nodes[node].parent;
+    m_nodes[node] = Node();
+    return node;
+}
+
+void DynamicAABBTree::freeNode(int node)
+{
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_nodes[node].body = INVALID_BODY;
+    m_freeList = node;
+}
+
+int DynamicAABBTree::createProxy(const AABB& bounds, BodyId body)
+{
+    int proxy = allocateNode();
+    Node& node = m_nodes[proxy];
+    node.box.lower = bounds.lower - glm::vec3(m_margin);
+    node.box.upper = bounds.upper + glm::vec3(m_margin);
+    node.body = body;
+    node.height = 0;
+
+    insertLeaf(proxy);
+    return proxy;
+}
+
+void DynamicAABBTree::destroyProxy(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+}
+
+bool DynamicAABBTree::moveProxy(int proxy, const AABB& bounds)
+{
+    //still inside the fat box, nothing to do. this is the common case for anything slow or resting
+    if (m_nodes[proxy].box.contains(bounds)) return false;
+
+    removeLeaf(proxy);
+    m_nodes[proxy].box.lower = bounds.lower - glm::vec3(m_margin);
+    m_nodes[proxy].box.upper = bounds.upper + glm::vec3(m_margin);
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    //walk down picking whichever child grows the least (surface area heuristic), or stop here when
+    //making a new parent at this level is cheaper than descending
+    const AABB leafBox = m_nodes[leaf].box;
+    int index = m_root;
+    while (!m_nodes[index].isLeaf()) {
+        const Node& node = m_nodes[index];
+        float area = node.box.surfaceArea();
+        float combinedArea = AABB::merge(node.box, leafBox).surfaceArea();
+
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child) {
+            const Node& c = m_nodes[child];
+            float merged = AABB::merge(leafBox, c.box).surfaceArea();
+            return c.isLeaf() ? merged + inheritanceCost : (merged - c.box.surfaceArea()) + inheritanceCost;
+        };
+        float cost1 = descendCost(node.child1);
+        float cost2 = descendCost(node.child2);
+
+        if (cost < cost1 && cost < cost2) break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    int sibling = index;
+    int oldParent = m_nodes[sibling].parent;
+    int newParent = allocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].box = AABB::merge(leafBox, m_nodes[sibling].box);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent != NULL_NODE) {
+        if (m_nodes[oldParent].child1 == sibling) m_nodes[oldParent].child1 = newParent;
+        else m_nodes[oldParent].child2 = newParent;
+    }
+    else {
+        m_root = newParent;
+    }
+
+    refitUpwards(m_nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    int parent = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    //the sibling takes the parent's place
+    if (grandParent != NULL_NODE) {
+        if (m_nodes[grandParent].child1 == parent) m_nodes[grandParent].child1 = sibling;
+        else m_nodes[grandParent].child2 = sibling;
+        m_nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpwards(grandParent);
+    }
+    else {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+    }
+}
+
+void DynamicAABBTree::refitUpwards(int index)
+{
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node& node = m_nodes[index];
+        const Node& child1 = m_nodes[node.child1];
+        const Node& child2 = m_nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.box = AABB::merge(child1.box, child2.box);
+
+        index = node.parent;
+    }
+}
+
+int DynamicAABBTree::balance(int iA)
+{
+    //if one side is more than a level taller, rotate its taller grandchild up (avl style), returns
+    //whichever node ends up where iA was
+    Node& A = m_nodes[iA];
+    if (A.isLeaf() || A.height < 2) return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+    Node& B = m_nodes[iB];
+    Node& C = m_nodes[iC];
+
+    int heightDiff = C.height - B.height;
+
+    if (heightDiff > 1) {
+        //C moves up, A becomes its child
+        int iF = C.child1;
+        int iG = C.child2;
+        Node& F = m_nodes[iF];
+        Node& G = m_nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != NULL_NODE) {
+            if (m_nodes[C.parent].child1 == iA) m_nodes[C.parent].child1 = iC;
+            else m_nodes[C.parent].child2 = iC;
+        }
+        else {
+            m_root = iC;
+        }
+
+        //the taller of C's children stays with C, the shorter goes to A
+        if (F.height > G.height) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.box = AABB::merge(B.box, G.box);
+            C.box = AABB::merge(A.box, F.box);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.box = AABB::merge(B.box, F.box);
+            C.box = AABB::merge(A.box, G.box);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    if (heightDiff < -1) {
+        //mirror image, B moves up
+        int iD = B.child1;
+        int iE = B.child2;
+        Node& D = m_nodes[iD];
+        Node& E = m_nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != NULL_NODE) {
+            if (m_nodes[B.parent].child1 == iA) m_nodes[B.parent].child1 = iB;
+            else m_nodes[B.parent].child2 = iB;
+        }
+        else {
+            m_root = iB;
+        }
+
+        if (D.height > E.height) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.box = AABB::merge(C.box, E.box);
+            B.box = AABB::merge(A.box, D.box);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.box = AABB::merge(C.box, D.box);
+            B.box = AABB::merge(A.box, E.box);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+void DynamicAABBTree::update(const RigidBodyStore& bodies)
+{
+    //bodies removed from the store since last time
+    for (BodyId id = 0; id < m_proxyOf.size(); id++) {
+        if (m_proxyOf[id] != NULL_NODE && !bodies.contains(id)) {
+            destroyProxy(m_proxyOf[id]);
+            m_proxyOf[id] = NULL_NODE;
+        }
+    }
+
+    const size_t count = bodies.size();
+    for (uint32_t i = 0; i < count; i++) {
+        BodyId id = bodies.idAt(i);
+        if (id >= m_proxyOf.size()) m_proxyOf.resize(id + 1, NULL_NODE);
+
+        //sleeping bodies get refreshed too, the solver can nudge a body in the same step it falls asleep
+        //and picking and ccd query these. a resting body stays inside its fat box, so it's one compare
+        AABB bounds = bodyBounds(bodies, i);
+        if (m_proxyOf[id] == NULL_NODE) {
+            m_proxyOf[id] = createProxy(bounds, id);
+        }
+        else {
+            moveProxy(m_proxyOf[id], bounds);
+        }
+    }
+}
+
+void DynamicAABBTree::findPairs(const RigidBodyStore& bodies, std::vector<BodyPair>& out, JobSystem* jobs) const
+{
+    out.clear();
+
+    const size_t grain = 512;
+    m_rangePairs.resize(rangeCount(bodies.size(), grain));
+    for (auto& range : m_rangePairs) range.clear();
+
+    parallelFor(jobs, bodies.size(), grain, [&](size_t begin, size_t end) {
+        std::vector<BodyPair>& rangeOut = m_rangePairs[begin / grain];
+
+        for (uint32_t i = static_cast<uint32_t>(begin); i < end; i++) {
+            //static and sleeping bodies never search, whatever is active near them finds them instead.
+            //a resting pile costs nothing here
+            if (!bodies.isActive(i)) continue;
+
+            BodyId id = bodies.idAt(i);
+            AABB bounds = bodyBounds(bodies, i);
+
+            query(bounds, [&](int proxy) {
+                BodyId other = m_nodes[proxy].body;
+                if (other == id) return true;
+
+                //two active bodies find each other, only the lower id reports it
+                uint32_t j = bodies.indexOf(other);
+                if (other < id && bodies.isActive(j)) return true;
+                if (!bounds.overlaps(bodyBounds(bodies, j))) return true;
+
+                rangeOut.push_back({ std::min(id, other), std::max(id, other) });
+                return true;
+            });
+        }
+    });
+
+    for (const auto& range : m_rangePairs) {
+        out.insert(out.end(), range.begin(), range.end());
+    }
+}
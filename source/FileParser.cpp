@@ -1,79 +1,370 @@
 #include "FileParser.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
 
 
+namespace {
+    //below this a chunk isn't worth a job, so small files (all of ours) are one chunk
+    const size_t MIN_CHUNK_BYTES = 256 * 1024;
+    const size_t CHUNKS_PER_THREAD = 4;     //some slack for stealing, lines are not all equally expensive
 
-void parseObj(const std::string& filePath, std::vector<Primitives::Vertex>& out_vertices)
-{
-    std::vector<glm::vec3> temp_positions;
-    std::vector<glm::vec2> temp_tex_coords;
-    std::vector<glm::vec3> temp_normals;
+    enum Attribute { POSITION, TEX_COORD, NORMAL, ATTRIBUTE_COUNT };
 
-    out_vertices.clear();
+    //0 based index into the merged attribute arrays, -1 when the face didn't give one
+    struct Corner {
+        int32_t index[ATTRIBUTE_COUNT];
+    };
 
+    //everything one chunk of lines produced, indices are fixed up to file wide ones when merging
+    struct ObjChunk {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners;                    //three per triangle, polygons already fanned
+        std::vector<uint32_t> relative[ATTRIBUTE_COUNT];//corners whose index was negative, still chunk local
+        size_t badLines = 0;
+        size_t badIndices = 0;
+    };
 
-    std::ifstream fileStream(filePath);
+    const char* skipSpaces(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        return p;
+    }
 
-    if (!fileStream.is_open()) {
-        std::cerr << "file path err: " << filePath << std::endl;
+    bool parseFloat(const char*& p, const char* end, float& value)
+    {
+        p = skipSpaces(p, end);
+        if (p < end && *p == '+') p++; //from_chars takes a minus but no plus
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+
+    bool parseInt(const char*& p, const char* end, int32_t& value)
+    {
+        if (p < end && *p == '+') p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+
+    //"v", "v/vt", "v//vn" or "v/vt/vn" as the raw 1 based (or negative) obj numbers, 0 = not given
+    bool parseCorner(const char*& p, const char* end, int32_t raw[ATTRIBUTE_COUNT])
+    {
+        raw[POSITION] = raw[TEX_COORD] = raw[NORMAL] = 0;
+        if (!parseInt(p, end, raw[POSITION]) || raw[POSITION] == 0) return false;
 
+        for (int attribute = TEX_COORD; attribute < ATTRIBUTE_COUNT; attribute++) {
+            if (p >= end || *p != '/') break;
+            p++;
+            if (p < end && *p != '/' && *p != ' ' && *p != '\t') {
+                if (!parseInt(p, end, raw[attribute]) || raw[attribute] == 0) return false;
+            }
+        }
+        return true;
     }
 
-    std::string line;
-    while (std::getline(fileStream, line)) {
+    bool parseFace(const char* p, const char* end, ObjChunk& chunk)
+    {
+        const size_t localCounts[ATTRIBUTE_COUNT] = { chunk.positions.size(), chunk.texCoords.size(), chunk.normals.size() };
+
+        Corner first{}, previous{};
+        bool firstRelative[ATTRIBUTE_COUNT] = {}, previousRelative[ATTRIBUTE_COUNT] = {};
+        int count = 0;
+        const size_t start = chunk.corners.size();
+
+        while (true) {
+            p = skipSpaces(p, end);
+            if (p >= end || *p == '#') break; //trailing comment
+
+            int32_t raw[ATTRIBUTE_COUNT];
+            if (!parseCorner(p, end, raw)) {
+                chunk.corners.resize(start);
+                for (std::vector<uint32_t>& list : chunk.relative) {
+                    while (!list.empty() && list.back() >= start) list.pop_back();
+                }
+                return false;
+            }
 
+            Corner corner;
+            bool isRelative[ATTRIBUTE_COUNT];
+            for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+                isRelative[attribute] = raw[attribute] < 0;
+                if (raw[attribute] > 0) corner.index[attribute] = raw[attribute] - 1;
+                else if (raw[attribute] < 0) corner.index[attribute] = static_cast<int32_t>(localCounts[attribute]) + raw[attribute];
+                else corner.index[attribute] = -1;
+            }
 
-        if (line.empty()) {
-            continue;
+            //fan: every corner after the second closes a triangle with the first and the one before it
+            auto emit = [&](const Corner& c, const bool relative[ATTRIBUTE_COUNT]) {
+                for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+                    if (relative[attribute]) chunk.relative[attribute].push_back(static_cast<uint32_t>(chunk.corners.size()));
+                }
+                chunk.corners.push_back(c);
+            };
+
+            if (count == 0) {
+                first = corner;
+                std::copy(isRelative, isRelative + ATTRIBUTE_COUNT, firstRelative);
+            }
+            else if (count >= 2) {
+                emit(first, firstRelative);
+                emit(previous, previousRelative);
+                emit(corner, isRelative);
+            }
+            previous = corner;
+            std::copy(isRelative, isRelative + ATTRIBUTE_COUNT, previousRelative);
+            count++;
         }
+        return count >= 3;
+    }
 
-        std::stringstream ss(line);
-        std::string prefix;
-        ss >> prefix;
+    void parseLine(const char* p, const char* end, ObjChunk& chunk)
+    {
+        p = skipSpaces(p, end);
+        if (p >= end || *p == '#') return;
 
-        if (prefix == "v") {
+        bool ok = true;
+        if (p[0] == 'v' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
             glm::vec3 position;
-            ss >> position.x >> position.y >> position.z;
-            temp_positions.push_back(position);
+            p += 1;
+            ok = parseFloat(p, end, position.x) && parseFloat(p, end, position.y) && parseFloat(p, end, position.z);
+            if (ok) chunk.positions.push_back(position);
+        }
+        else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec2 texCoord;
+            p += 2;
+            ok = parseFloat(p, end, texCoord.x);
+            //a lone u is allowed, v defaults to 0
+            if (ok && !parseFloat(p, end, texCoord.y)) texCoord.y = 0.0f;
+            if (ok) chunk.texCoords.push_back(texCoord);
+        }
+        else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec3 normal;
+            p += 2;
+            ok = parseFloat(p, end, normal.x) && parseFloat(p, end, normal.y) && parseFloat(p, end, normal.z);
+            if (ok) chunk.normals.push_back(normal);
         }
-        else if (prefix == "vt") {
-            glm::vec2 tex_coords;
-            ss >> tex_coords.x >> tex_coords.y;
-            temp_tex_coords.push_back(tex_coords);
+        else if (p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+            ok = parseFace(p + 1, end, chunk);
+        }
+        //anything else (o, g, s, usemtl, mtllib, l, p) doesn't matter for a single mesh
+
+        if (!ok) chunk.badLines++;
+    }
+
+    void parseChunk(const char* begin, const char* end, ObjChunk& chunk)
+    {
+        const char* line = begin;
+        while (line < end) {
+            const char* lineEnd = line;
+            while (lineEnd < end && *lineEnd != '\n') lineEnd++;
+
+            const char* contentEnd = lineEnd;
+            if (contentEnd > line && contentEnd[-1] == '\r') contentEnd--;
+            parseLine(line, contentEnd, chunk);
+
+            line = lineEnd + 1;
+        }
+    }
+
+    //chunk boundaries, each one just past a newline so no line is split
+    std::vector<const char*> splitLines(const char* text, size_t size, size_t chunkCount)
+    {
+        std::vector<const char*> bounds{ text };
+        const char* end = text + size;
+        for (size_t i = 1; i < chunkCount; i++) {
+            const char* p = text + size * i / chunkCount;
+            if (p < bounds.back()) p = bounds.back();
+            while (p < end && *p != '\n') p++;
+            if (p < end) p++;
+            bounds.push_back(p);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    struct CornerHash {
+        size_t operator()(const Corner& corner) const
+        {
+            uint64_t h = static_cast<uint32_t>(corner.index[POSITION]);
+            h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner.index[TEX_COORD]);
+            h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner.index[NORMAL]);
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+
+    struct CornerEqual {
+        bool operator()(const Corner& a, const Corner& b) const
+        {
+            return a.index[POSITION] == b.index[POSITION] && a.index[TEX_COORD] == b.index[TEX_COORD] &&
+                   a.index[NORMAL] == b.index[NORMAL];
+        }
+    };
+
+    //the whole file: merged attribute arrays, and the chunks' corners rewritten to valid file wide indices
+    struct ObjData {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<ObjChunk> chunks;
+        std::vector<size_t> firstCorner;    //where each chunk's corners start, one extra entry for the total
+    };
+
+    void parseText(const char* text, size_t size, JobSystem* jobs, ObjData& data)
+    {
+        size_t threads = jobs ? jobs->getThreadCount() : 1;
+        size_t chunkCount = std::max<size_t>(1, std::min(threads * CHUNKS_PER_THREAD, size / MIN_CHUNK_BYTES));
+        std::vector<const char*> bounds = splitLines(text, size, chunkCount);
+
+        std::vector<ObjChunk>& chunks = data.chunks;
+        chunks.resize(chunkCount);
+        parallelFor(jobs, chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) parseChunk(bounds[c], bounds[c + 1], chunks[c]);
+        });
+
+        //where each chunk's attributes and triangles start in the merged arrays
+        std::vector<size_t> firstPosition(chunkCount + 1, 0), firstTexCoord(chunkCount + 1, 0), firstNormal(chunkCount + 1, 0);
+        data.firstCorner.assign(chunkCount + 1, 0);
+        for (size_t c = 0; c < chunkCount; c++) {
+            firstPosition[c + 1] = firstPosition[c] + chunks[c].positions.size();
+            firstTexCoord[c + 1] = firstTexCoord[c] + chunks[c].texCoords.size();
+            firstNormal[c + 1] = firstNormal[c] + chunks[c].normals.size();
+            data.firstCorner[c + 1] = data.firstCorner[c] + chunks[c].corners.size();
         }
-        else if (prefix == "vn") {
-            glm::vec3 normals;
-            ss >> normals.x >> normals.y >> normals.z;
-            temp_normals.push_back(normals);
+
+        data.positions.resize(firstPosition[chunkCount]);
+        data.texCoords.resize(firstTexCoord[chunkCount]);
+        data.normals.resize(firstNormal[chunkCount]);
+        const int64_t counts[ATTRIBUTE_COUNT] = {
+            static_cast<int64_t>(data.positions.size()), static_cast<int64_t>(data.texCoords.size()),
+            static_cast<int64_t>(data.normals.size())
+        };
+
+        parallelFor(jobs, chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                ObjChunk& chunk = chunks[c];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + firstPosition[c]);
+                std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + firstTexCoord[c]);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + firstNormal[c]);
+
+                const size_t offsets[ATTRIBUTE_COUNT] = { firstPosition[c], firstTexCoord[c], firstNormal[c] };
+                for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+                    for (uint32_t corner : chunk.relative[attribute]) {
+                        int32_t& index = chunk.corners[corner].index[attribute];
+                        index += static_cast<int32_t>(offsets[attribute]);
+                        //reaching back past the first one, -1 would otherwise pass for "not given" below
+                        if (index < 0) {
+                            chunk.badIndices++;
+                            index = -1;
+                        }
+                    }
+                }
+
+                //anything pointing outside the file is dropped to "not given" so the outputs can index blindly
+                for (Corner& corner : chunk.corners) {
+                    for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+                        int32_t& index = corner.index[attribute];
+                        if (index >= counts[attribute]) chunk.badIndices++;
+                        if (index >= counts[attribute] || index < 0) index = -1;
+                    }
+                }
+            }
+        });
+
+        size_t badLines = 0, badIndices = 0;
+        for (const ObjChunk& chunk : chunks) {
+            badLines += chunk.badLines;
+            badIndices += chunk.badIndices;
         }
-        else if (prefix == "f") {
-            unsigned int vIndex1, vtIndex1, vnIndex1;
-            unsigned int vIndex2, vtIndex2, vnIndex2;
-            unsigned int vIndex3, vtIndex3, vnIndex3;
-            char slash;
-            Primitives::Vertex vertex1;
-            Primitives::Vertex vertex2;
-            Primitives::Vertex vertex3;
-
-            ss >> vIndex1 >> slash >> vtIndex1 >> slash >> vnIndex1;
-            ss >> vIndex2 >> slash >> vtIndex2 >> slash >> vnIndex2;
-            ss >> vIndex3 >> slash >> vtIndex3 >> slash >> vnIndex3;
-
-            vertex1.position = temp_positions[vIndex1 - 1];
-            vertex1.texCoord = temp_tex_coords[vtIndex1 - 1];
-            vertex1.normal = temp_normals[vnIndex1 - 1];
-            out_vertices.push_back(vertex1);
-            vertex2.position = temp_positions[vIndex2 - 1];
-            vertex2.texCoord = temp_tex_coords[vtIndex2 - 1];
-            vertex2.normal = temp_normals[vnIndex2 - 1];
-            out_vertices.push_back(vertex2);
-            vertex3.position = temp_positions[vIndex3 - 1];
-            vertex3.texCoord = temp_tex_coords[vtIndex3 - 1];
-            vertex3.normal = temp_normals[vnIndex3 - 1];
-            out_vertices.push_back(vertex3);
+        if (badLines > 0 || badIndices > 0) {
+            std::cerr << "WARNING::OBJ: skipped " << badLines << " unreadable lines and " << badIndices
+                      << " out of range indices" << std::endl;
         }
+    }
+
+    Primitives::Vertex fetch(const ObjData& data, const Corner& corner)
+    {
+        Primitives::Vertex vertex{ glm::vec3(0.0f), glm::vec2(0.0f), glm::vec3(0.0f) };
+        if (corner.index[POSITION] >= 0) vertex.position = data.positions[corner.index[POSITION]];
+        if (corner.index[TEX_COORD] >= 0) vertex.texCoord = data.texCoords[corner.index[TEX_COORD]];
+        if (corner.index[NORMAL] >= 0) vertex.normal = data.normals[corner.index[NORMAL]];
+        return vertex;
+    }
+}
+
+
+
+
+bool parseObj(const std::string& filePath, std::vector<Primitives::Vertex>& out_vertices, JobSystem* jobs)
+{
+    out_vertices.clear();
+
+    MappedFile file(filePath);
+    if (!file.isOpen()) {
+        std::cerr << "file path err: " << filePath << std::endl;
+        return false;
+    }
+    return parseObjText(file.data(), file.size(), out_vertices, jobs);
+}
 
+bool parseObj(const std::string& filePath, MeshData& out_mesh, JobSystem* jobs)
+{
+    out_mesh.vertices.clear();
+    out_mesh.indices.clear();
+
+    MappedFile file(filePath);
+    if (!file.isOpen()) {
+        std::cerr << "file path err: " << filePath << std::endl;
+        return false;
     }
+    return parseObjText(file.data(), file.size(), out_mesh, jobs);
+}
+
+bool parseObjText(const char* text, size_t size, std::vector<Primitives::Vertex>& out_vertices, JobSystem* jobs)
+{
+    ObjData data;
+    parseText(text, size, jobs, data);
+
+    out_vertices.resize(data.firstCorner.back());
+    parallelFor(jobs, data.chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            Primitives::Vertex* out = out_vertices.data() + data.firstCorner[c];
+            for (const Corner& corner : data.chunks[c].corners) *out++ = fetch(data, corner);
+        }
+    });
+    return true;
+}
+
+bool parseObjText(const char* text, size_t size, MeshData& out_mesh, JobSystem* jobs)
+{
+    ObjData data;
+    parseText(text, size, jobs, data);
+
+    out_mesh.vertices.clear();
+    out_mesh.indices.resize(data.firstCorner.back());
 
-    fileStream.close();
+    //one vertex per distinct v/vt/vn triple, in first use order. serial: it is a single hash lookup per
+    //corner and the order has to come out the same no matter how the file was chunked
+    std::unordered_map<Corner, uint32_t, CornerHash, CornerEqual> unique;
+    unique.reserve(data.positions.size() + data.positions.size() / 2);
 
-}
\ No newline at end of file
+    uint32_t* out = out_mesh.indices.data();
+    for (const ObjChunk& chunk : data.chunks) {
+        for (const Corner& corner : chunk.corners) {
+            auto inserted = unique.emplace(corner, static_cast<uint32_t>(out_mesh.vertices.size()));
+            if (inserted.second) out_mesh.vertices.push_back(fetch(data, corner));
+            *out++ = inserted.first->second;
+        }
+    }
+    out_mesh.updateBounds();
+    return true;
+}
@@ -0,0 +1,410 @@
+#include "Determinism.h"
+#include "Gjk.h"
+#include <cfloat>
+#include <cmath>
+
+
+namespace {
+    const int MAX_GJK_ITERATIONS = 32;
+    const int MAX_EPA_ITERATIONS = 64;
+    const int MAX_EPA_VERTICES = MAX_EPA_ITERATIONS + 4;
+    const int MAX_EPA_FACES = 2 * MAX_EPA_VERTICES;
+    //relative progress below which both loops call it converged, floats dont get much closer
+    const float TOLERANCE = 1e-4f;
+
+    //a point of the Minkowski difference a - b, along with the two points that made it
+    struct SimplexVertex {
+        glm::vec3 w;
+        glm::vec3 a;
+        glm::vec3 b;
+    };
+
+    SimplexVertex supportDifference(const ShapeInstance& a, const ShapeInstance& b, const glm::vec3& dir)
+    {
+        SimplexVertex v;
+        v.a = Gjk::support(a, dir);
+        v.b = Gjk::support(b, -dir);
+        v.w = v.a - v.b;
+        return v;
+    }
+
+    struct Simplex {
+        SimplexVertex vertices[4];
+        float weights[4];   //barycentric weights of the closest point to the origin
+        int count = 0;
+
+        void keep(int i0, float w0)
+        {
+            vertices[0] = vertices[i0];
+            weights[0] = w0;
+            count = 1;
+        }
+        void keep(int i0, float w0, int i1, float w1)
+        {
+            SimplexVertex v0 = vertices[i0], v1 = vertices[i1];
+            vertices[0] = v0;
+            vertices[1] = v1;
+            weights[0] = w0;
+            weights[1] = w1;
+            count = 2;
+        }
+        void keep(int i0, float w0, int i1, float w1, int i2, float w2)
+        {
+            SimplexVertex v0 = vertices[i0], v1 = vertices[i1], v2 = vertices[i2];
+            vertices[0] = v0;
+            vertices[1] = v1;
+            vertices[2] = v2;
+            weights[0] = w0;
+            weights[1] = w1;
+            weights[2] = w2;
+            count = 3;
+        }
+
+        glm::vec3 closest() const
+        {
+            glm::vec3 v(0.0f);
+            for (int k = 0; k < count; k++) v += vertices[k].w * weights[k];
+            return v;
+        }
+    };
+
+    void solveSegment(Simplex& s)
+    {
+        glm::vec3 edge = s.vertices[1].w - s.vertices[0].w;
+        float lengthSq = glm::dot(edge, edge);
+        float t = lengthSq > 0.0f ? -glm::dot(s.vertices[0].w, edge) / lengthSq : 0.0f;
+        if (t <= 0.0f) s.keep(0, 1.0f);
+        else if (t >= 1.0f) s.keep(1, 1.0f);
+        else s.keep(0, 1.0f - t, 1, t);
+    }
+
+    //closest point of triangle i0 i1 i2 to the origin, reduces the simplex to the feature it lies on
+    //(Ericson 5.1.5)
+    void solveTriangle(Simplex& s, int i0, int i1, int i2)
+    {
+        const glm::vec3 a = s.vertices[i0].w, b = s.vertices[i1].w, c = s.vertices[i2].w;
+        const glm::vec3 ab = b - a, ac = c - a;
+
+        float d1 = glm::dot(ab, -a), d2 = glm::dot(ac, -a);
+        if (d1 <= 0.0f && d2 <= 0.0f) { s.keep(i0, 1.0f); return; }
+
+        float d3 = glm::dot(ab, -b), d4 = glm::dot(ac, -b);
+        if (d3 >= 0.0f && d4 <= d3) { s.keep(i1, 1.0f); return; }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            float v = d1 / (d1 - d3);
+            s.keep(i0, 1.0f - v, i1, v);
+            return;
+        }
+
+        float d5 = glm::dot(ab, -c), d6 = glm::dot(ac, -c);
+        if (d6 >= 0.0f && d5 <= d6) { s.keep(i2, 1.0f); return; }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            float w = d2 / (d2 - d6);
+            s.keep(i0, 1.0f - w, i2, w);
+            return;
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            s.keep(i1, 1.0f - w, i2, w);
+            return;
+        }
+
+        float denominator = 1.0f / (va + vb + vc);
+        float v = vb * denominator;
+        float w = vc * denominator;
+        s.keep(i0, 1.0f - v - w, i1, v, i2, w);
+    }
+
+    //returns true when the origin is inside the tetrahedron, otherwise reduces to the closest face
+    bool solveTetrahedron(Simplex& s)
+    {
+        const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+
+        Simplex best;
+        float bestDistSq = FLT_MAX;
+        bool outsideAny = false;
+        for (const auto& face : faces) {
+            const glm::vec3 a = s.vertices[face[0]].w;
+            glm::vec3 normal = glm::cross(s.vertices[face[1]].w - a, s.vertices[face[2]].w - a);
+            float signOrigin = glm::dot(-a, normal);
+            float signOpposite = glm::dot(s.vertices[face[3]].w - a, normal);
+
+            //a flat tetrahedron has no inside, every face is a candidate then
+            if (signOrigin * signOpposite > 0.0f && std::fabs(signOpposite) > 1e-12f) continue;
+            outsideAny = true;
+
+            Simplex candidate = s;
+            solveTriangle(candidate, face[0], face[1], face[2]);
+            glm::vec3 v = candidate.closest();
+            float distSq = glm::dot(v, v);
+            if (distSq < bestDistSq) {
+                bestDistSq = distSq;
+                best = candidate;
+            }
+        }
+
+        if (!outsideAny) return true;
+        s = best;
+        return false;
+    }
+
+    struct EpaFace {
+        int v[3];
+        glm::vec3 normal;
+        float distance;
+    };
+
+    //normal follows the winding, callers keep every face wound so it points out of the polytope
+    bool makeFace(const SimplexVertex* vertices, int i0, int i1, int i2, EpaFace& face)
+    {
+        glm::vec3 normal = glm::cross(vertices[i1].w - vertices[i0].w, vertices[i2].w - vertices[i0].w);
+        float length = glm::length(normal);
+        if (length < 1e-12f) return false;
+
+        face.v[0] = i0;
+        face.v[1] = i1;
+        face.v[2] = i2;
+        face.normal = normal / length;
+        face.distance = glm::dot(face.normal, vertices[i0].w);
+        return true;
+    }
+
+    //grows a simplex that ended with the origin on its boundary (touching cores) into a tetrahedron
+    bool fillTetrahedron(const ShapeInstance& a, const ShapeInstance& b, Simplex& s)
+    {
+        const glm::vec3 axes[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+        auto isNew = [&](const SimplexVertex& v) {
+            for (int k = 0; k < s.count; k++) {
+                glm::vec3 delta = v.w - s.vertices[k].w;
+                if (glm::dot(delta, delta) < 1e-10f) return false;
+            }
+            if (s.count == 2) {
+                glm::vec3 c = glm::cross(s.vertices[1].w - s.vertices[0].w, v.w - s.vertices[0].w);
+                if (glm::dot(c, c) < 1e-10f) return false;
+            }
+            if (s.count == 3) {
+                glm::vec3 n = glm::cross(s.vertices[1].w - s.vertices[0].w, s.vertices[2].w - s.vertices[0].w);
+                if (std::fabs(glm::dot(n, v.w - s.vertices[0].w)) < 1e-10f) return false;
+            }
+            return true;
+        };
+
+        while (s.count < 4) {
+            bool grown = false;
+            for (const glm::vec3& axis : axes) {
+                glm::vec3 dir = axis;
+                if (s.count == 3) {
+                    //only the face normal can leave the plane of a triangle
+                    glm::vec3 n = glm::cross(s.vertices[1].w - s.vertices[0].w, s.vertices[2].w - s.vertices[0].w);
+                    dir = axis.x + axis.y + axis.z > 0.0f ? n : -n;
+                }
+                SimplexVertex v = supportDifference(a, b, dir);
+                if (!isNew(v)) continue;
+                s.vertices[s.count++] = v;
+                grown = true;
+                break;
+            }
+            if (!grown) return false;
+        }
+        return true;
+    }
+
+    bool expandPolytope(const ShapeInstance& a, const ShapeInstance& b, const Simplex& simplex, Gjk::Result& out)
+    {
+        SimplexVertex vertices[MAX_EPA_VERTICES];
+        EpaFace faces[MAX_EPA_FACES];
+        int vertexCount = 4;
+        int faceCount = 0;
+        for (int k = 0; k < 4; k++) vertices[k] = simplex.vertices[k];
+
+        //the starting faces are wound away from the middle of the tetrahedron, the origin can be right
+        //on one of them so it is no good for telling inside from outside
+        const glm::vec3 middle = (vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w) * 0.25f;
+        const int start[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+        for (const auto& f : start) {
+            glm::vec3 normal = glm::cross(vertices[f[1]].w - vertices[f[0]].w, vertices[f[2]].w - vertices[f[0]].w);
+            bool flip = glm::dot(normal, vertices[f[0]].w - middle) < 0.0f;
+            if (!makeFace(vertices, f[0], flip ? f[2] : f[1], flip ? f[1] : f[2], faces[faceCount])) return false;
+            faceCount++;
+        }
+
+        int closest = 0;
+        for (int iteration = 0; iteration < MAX_EPA_ITERATIONS; iteration++) {
+            closest = 0;
+            for (int f = 1; f < faceCount; f++) {
+                if (faces[f].distance < faces[closest].distance) closest = f;
+            }
+
+            const EpaFace face = faces[closest];
+            SimplexVertex v = supportDifference(a, b, face.normal);
+            float gain = glm::dot(v.w, face.normal) - face.distance;
+            if (gain <= TOLERANCE * glm::max(face.distance, 1.0f) || vertexCount == MAX_EPA_VERTICES) break;
+
+            //every face the new point can see goes, the edges around the hole they leave get joined
+            //to the new point
+            int edges[MAX_EPA_FACES * 3][2];
+            int edgeCount = 0;
+            for (int f = 0; f < faceCount;) {
+                if (glm::dot(faces[f].normal, v.w - vertices[faces[f].v[0]].w) <= 0.0f) {
+                    f++;
+                    continue;
+                }
+                for (int e = 0; e < 3; e++) {
+                    int from = faces[f].v[e];
+                    int to = faces[f].v[(e + 1) % 3];
+                    //an edge shared with another removed face is walked the other way round there
+                    bool shared = false;
+                    for (int k = 0; k < edgeCount; k++) {
+                        if (edges[k][0] == to && edges[k][1] == from) {
+                            edges[k][0] = edges[--edgeCount][0];
+                            edges[k][1] = edges[edgeCount][1];
+                            shared = true;
+                            break;
+                        }
+                    }
+                    if (!shared) {
+                        edges[edgeCount][0] = from;
+                        edges[edgeCount][1] = to;
+                        edgeCount++;
+                    }
+                }
+                faces[f] = faces[--faceCount];
+            }
+
+            if (faceCount + edgeCount > MAX_EPA_FACES) return false;
+            int index = vertexCount++;
+            vertices[index] = v;
+            for (int k = 0; k < edgeCount; k++) {
+                if (!makeFace(vertices, edges[k][0], edges[k][1], index, faces[faceCount])) continue;
+                faceCount++;
+            }
+            if (faceCount == 0) return false;
+        }
+
+        closest = 0;
+        for (int f = 1; f < faceCount; f++) {
+            if (faces[f].distance < faces[closest].distance) closest = f;
+        }
+        const EpaFace& face = faces[closest];
+
+        //barycentric weights of the origin projected onto the face give the points on each shape
+        const glm::vec3 p = face.normal * face.distance;
+        const glm::vec3 a0 = vertices[face.v[0]].w;
+        const glm::vec3 v0 = vertices[face.v[1]].w - a0, v1 = vertices[face.v[2]].w - a0, v2 = p - a0;
+        float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1);
+        float d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+        float denominator = d00 * d11 - d01 * d01;
+        if (std::fabs(denominator) < 1e-20f) return false;
+        float wv = (d11 * d20 - d01 * d21) / denominator;
+        float ww = (d00 * d21 - d01 * d20) / denominator;
+        float wu = 1.0f - wv - ww;
+
+        out.normal = face.normal;
+        out.separation = -face.distance;
+        out.pointA = vertices[face.v[0]].a * wu + vertices[face.v[1]].a * wv + vertices[face.v[2]].a * ww;
+        out.pointB = vertices[face.v[0]].b * wu + vertices[face.v[1]].b * wv + vertices[face.v[2]].b * ww;
+        return true;
+    }
+}
+
+
+namespace Gjk
+{
+    glm::vec3 support(const ShapeInstance& shape, const glm::vec3& dir)
+    {
+        switch (shape.type) {
+        case ShapeType::CAPSULE: {
+            glm::vec3 axis = shape.rotation[1] * shape.halfHeight;
+            return glm::dot(dir, axis) >= 0.0f ? shape.position + axis : shape.position - axis;
+        }
+        case ShapeType::AABB:
+        case ShapeType::OBB: {
+            glm::vec3 local = glm::transpose(shape.rotation) * dir;
+            glm::vec3 corner(local.x >= 0.0f ? shape.halfExtents.x : -shape.halfExtents.x,
+                             local.y >= 0.0f ? shape.halfExtents.y : -shape.halfExtents.y,
+                             local.z >= 0.0f ? shape.halfExtents.z : -shape.halfExtents.z);
+            return shape.position + shape.rotation * corner;
+        }
+        case ShapeType::CONVEX_HULL: {
+            glm::vec3 local = glm::transpose(shape.rotation) * dir;
+            const std::vector<glm::vec3>& vertices = shape.hull->vertices;
+            size_t best = 0;
+            float bestDot = -FLT_MAX;
+            for (size_t k = 0; k < vertices.size(); k++) {
+                float d = glm::dot(vertices[k], local);
+                if (d > bestDot) { bestDot = d; best = k; }
+            }
+            return vertices.empty() ? shape.position : shape.position + shape.rotation * vertices[best];
+        }
+        default:
+            //spheres are all radius around their center
+            return shape.position;
+        }
+    }
+
+    float coreRadius(const ShapeInstance& shape)
+    {
+        return shape.type == ShapeType::SPHERE || shape.type == ShapeType::CAPSULE ? shape.radius : 0.0f;
+    }
+
+    bool closestPoints(const ShapeInstance& a, const ShapeInstance& b, Result& out)
+    {
+        glm::vec3 dir = b.position - a.position;
+        if (glm::dot(dir, dir) < 1e-12f) dir = glm::vec3(0.0f, 1.0f, 0.0f);
+
+        Simplex simplex;
+        simplex.vertices[0] = supportDifference(a, b, -dir);
+        simplex.weights[0] = 1.0f;
+        simplex.count = 1;
+
+        bool overlapping = false;
+        for (int iteration = 0; iteration < MAX_GJK_ITERATIONS; iteration++) {
+            glm::vec3 v = simplex.closest();
+            float distSq = glm::dot(v, v);
+            if (distSq < 1e-12f) { overlapping = true; break; }
+
+            //no support point gets meaningfully closer to the origin than v, that is the distance
+            SimplexVertex w = supportDifference(a, b, -v);
+            if (distSq - glm::dot(v, w.w) <= TOLERANCE * distSq) break;
+
+            bool repeated = false;
+            for (int k = 0; k < simplex.count; k++) {
+                glm::vec3 delta = w.w - simplex.vertices[k].w;
+                repeated |= glm::dot(delta, delta) < 1e-12f;
+            }
+            if (repeated) break;
+
+            simplex.vertices[simplex.count++] = w;
+            if (simplex.count == 2) solveSegment(simplex);
+            else if (simplex.count == 3) solveTriangle(simplex, 0, 1, 2);
+            else if (solveTetrahedron(simplex)) { overlapping = true; break; }
+        }
+
+        if (!overlapping) {
+            glm::vec3 v = simplex.closest();
+            float distance = std::sqrt(glm::dot(v, v));
+            out.pointA = glm::vec3(0.0f);
+            out.pointB = glm::vec3(0.0f);
+            for (int k = 0; k < simplex.count; k++) {
+                out.pointA += simplex.vertices[k].a * simplex.weights[k];
+                out.pointB += simplex.vertices[k].b * simplex.weights[k];
+            }
+            //v runs from b to a in the difference, the normal goes the other way
+            out.normal = -v / distance;
+            out.separation = distance;
+            return true;
+        }
+
+        //a tetrahedron the solve above said holds the origin can go straight into EPA, anything smaller
+        //means the cores only just touch and it has to be grown first
+        if (simplex.count < 4 && !fillTetrahedron(a, b, simplex)) return false;
+        return expandPolytope(a, b, simplex, out);
+    }
+}
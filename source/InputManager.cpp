@@ -37,6 +37,10 @@ void InputManager::process(float deltaTime)
     m_state.resetPosition = (rKeyState == GLFW_PRESS && m_lastRKeyState == GLFW_RELEASE);
     m_lastRKeyState = rKeyState;
 
+    int cKeyState = glfwGetKey(m_window, GLFW_KEY_C);
+    m_state.spawnCube = (cKeyState == GLFW_PRESS && m_lastCKeyState == GLFW_RELEASE);
+    m_lastCKeyState = cKeyState;
+
 
 
 
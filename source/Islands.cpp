@@ -0,0 +1,90 @@
+#include "Determinism.h"
+#include "Islands.h"
+
+
+uint32_t IslandBuilder::find(uint32_t body)
+{
+    //path halving, keeps the trees flat without a second pass
+    while (m_parent[body] != body) {
+        m_parent[body] = m_parent[m_parent[body]];
+        body = m_parent[body];
+    }
+    return body;
+}
+
+void IslandBuilder::unite(uint32_t a, uint32_t b)
+{
+    uint32_t rootA = find(a);
+    uint32_t rootB = find(b);
+    if (rootA == rootB) return;
+
+    //lower index wins so the result does not depend on contact order
+    if (rootA < rootB) m_parent[rootB] = rootA;
+    else m_parent[rootA] = rootB;
+}
+
+void IslandBuilder::build(const RigidBodyStore& bodies, const std::vector<Contact>& contacts)
+{
+    const uint32_t bodyCount = static_cast<uint32_t>(bodies.size());
+
+    m_parent.resize(bodyCount);
+    for (uint32_t i = 0; i < bodyCount; i++) m_parent[i] = i;
+
+    for (const Contact& contact : contacts) {
+        uint32_t a = bodies.indexOf(contact.a);
+        uint32_t b = bodies.indexOf(contact.b);
+        if (bodies.isActive(a) && bodies.isActive(b)) {
+            unite(a, b);
+        }
+    }
+
+    //number the islands in order of their first body, then count sort bodies and contacts into them
+    m_islands.clear();
+    m_islandOf.assign(bodyCount, UINT32_MAX);
+    for (uint32_t i = 0; i < bodyCount; i++) {
+        if (!bodies.isActive(i)) continue;
+
+        uint32_t root = find(i);
+        if (m_islandOf[root] == UINT32_MAX) {
+            m_islandOf[root] = static_cast<uint32_t>(m_islands.size());
+            m_islands.emplace_back();
+        }
+        m_islands[m_islandOf[root]].bodyCount++;
+    }
+
+    auto islandOfContact = [&](const Contact& contact) {
+        uint32_t a = bodies.indexOf(contact.a);
+        uint32_t dynamicBody = bodies.isActive(a) ? a : bodies.indexOf(contact.b);
+        return m_islandOf[find(dynamicBody)];
+    };
+
+    for (const Contact& contact : contacts) {
+        m_islands[islandOfContact(contact)].contactCount++;
+    }
+
+    uint32_t bodyOffset = 0;
+    uint32_t contactOffset = 0;
+    for (Island& island : m_islands) {
+        island.bodyBegin = bodyOffset;
+        island.contactBegin = contactOffset;
+        bodyOffset += island.bodyCount;
+        contactOffset += island.contactCount;
+        //reused as write cursors below
+        island.bodyCount = 0;
+        island.contactCount = 0;
+    }
+
+    m_bodies.resize(bodyOffset);
+    m_contacts.resize(contactOffset);
+
+    for (uint32_t i = 0; i < bodyCount; i++) {
+        if (!bodies.isActive(i)) continue;
+        Island& island = m_islands[m_islandOf[find(i)]];
+        m_bodies[island.bodyBegin + island.bodyCount++] = i;
+    }
+
+    for (uint32_t c = 0; c < contacts.size(); c++) {
+        Island& island = m_islands[islandOfContact(contacts[c])];
+        m_contacts[island.contactBegin + island.contactCount++] = c;
+    }
+}
@@ -0,0 +1,126 @@
+#include "JobSystem.h"
+
+
+namespace {
+    //which job system a worker thread belongs to and which deque is its own
+    thread_local const JobSystem* t_system = nullptr;
+    thread_local unsigned t_queue = 0;
+}
+
+
+unsigned JobSystem::defaultWorkerCount()
+{
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+    for (unsigned i = 0; i < workerCount + 1; i++) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (unsigned i = 1; i <= workerCount; i++) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+unsigned JobSystem::currentQueue() const
+{
+    //any thread that is not one of ours (the owner, or someone else entirely) shares deque 0
+    return t_system == this ? t_queue : 0;
+}
+
+void JobSystem::run(Counter& counter, Job job)
+{
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    WorkQueue& queue = *m_queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({ std::move(job), &counter });
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+
+    {
+        //taking the lock makes sure a worker that is just about to sleep sees the new job
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::wait(Counter& counter)
+{
+    unsigned queue = currentQueue();
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(queue)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::popOwn(unsigned queue, Task& task)
+{
+    WorkQueue& own = *m_queues[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.tasks.empty()) return false;
+
+    //newest first, its data is the most likely to still be in cache
+    task = std::move(own.tasks.back());
+    own.tasks.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(unsigned thief, Task& task)
+{
+    const unsigned count = static_cast<unsigned>(m_queues.size());
+    for (unsigned offset = 1; offset < count; offset++) {
+        WorkQueue& victim = *m_queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+
+        //oldest first, those tend to be the bigger chunks of work
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::runOne(unsigned queue)
+{
+    Task task;
+    if (!popOwn(queue, task) && !steal(queue, task)) return false;
+
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    task.job();
+    task.counter->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::workerLoop(unsigned queue)
+{
+    t_system = this;
+    t_queue = queue;
+
+    while (true) {
+        if (runOne(queue)) continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return !m_running || m_queued.load(std::memory_order_acquire) > 0; });
+        if (!m_running) return;
+    }
+}
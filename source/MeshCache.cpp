@@ -0,0 +1,268 @@
+#include "MeshCache.h"
+#include "FileParser.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace {
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+    const uint32_t MAX_ATTRIBUTE_LOCATION = 16;    //the least GL_MAX_VERTEX_ATTRIBS gl guarantees
+
+    uint64_t alignUp(uint64_t value)
+    {
+        return (value + BAKED_MESH_ALIGNMENT - 1) / BAKED_MESH_ALIGNMENT * BAKED_MESH_ALIGNMENT;
+    }
+
+    bool isAligned(uint64_t value)
+    {
+        return value % BAKED_MESH_ALIGNMENT == 0;
+    }
+}
+
+
+uint64_t hashContent(const char* data, size_t size)
+{
+    uint64_t hash = FNV_OFFSET;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; i < size; i++) hash = (hash ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+    return hash;
+}
+
+std::string bakedMeshPath(const std::string& sourcePath, VertexFormat format)
+{
+    return sourcePath + (format == VertexFormat::COMPACT ? ".packed.mesh" : ".mesh");
+}
+
+std::vector<char> serializeBakedMesh(const MeshData& data, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format)
+{
+    const bool shortIndices = data.fitsShortIndices();
+    const bool compact = format == VertexFormat::COMPACT;
+
+    std::vector<MeshLod> lods = data.getLods();
+    std::vector<PackedVertex> packed;
+    if (compact) packVertices(data, packed);
+    const void* vertices = compact ? static_cast<const void*>(packed.data()) : static_cast<const void*>(data.vertices.data());
+
+    BakedMeshHeader header{};
+    header.magic = BAKED_MESH_MAGIC;
+    header.version = BAKED_MESH_VERSION;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+    header.vertexStride = compact ? sizeof(PackedVertex) : sizeof(Primitives::Vertex);
+    header.indexCount = static_cast<uint32_t>(data.indices.size());
+    header.indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+    header.attributeCount = compact ? PACKED_ATTRIBUTE_COUNT : STANDARD_ATTRIBUTE_COUNT;
+    header.vertexFormat = format;
+    header.lodCount = static_cast<uint32_t>(lods.size());
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = data.boundsMin[axis];
+        header.boundsMax[axis] = data.boundsMax[axis];
+    }
+    header.attributeOffset = alignUp(sizeof(BakedMeshHeader));
+    header.lodOffset = alignUp(header.attributeOffset + header.attributeCount * sizeof(VertexAttribute));
+    header.vertexOffset = alignUp(header.lodOffset + header.lodCount * sizeof(MeshLod));
+    header.indexOffset = alignUp(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride);
+    header.fileSize = header.indexOffset + uint64_t(header.indexCount) * header.indexSize;
+
+    std::vector<char> image(header.fileSize, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + header.attributeOffset, compact ? packedVertexLayout() : standardVertexLayout(),
+                header.attributeCount * sizeof(VertexAttribute));
+    std::memcpy(image.data() + header.lodOffset, lods.data(), lods.size() * sizeof(MeshLod));
+    std::memcpy(image.data() + header.vertexOffset, vertices, uint64_t(header.vertexCount) * header.vertexStride);
+
+    char* indices = image.data() + header.indexOffset;
+    if (shortIndices) {
+        for (size_t i = 0; i < data.indices.size(); i++) {
+            uint16_t index = static_cast<uint16_t>(data.indices[i]);
+            std::memcpy(indices + i * sizeof(uint16_t), &index, sizeof(index));
+        }
+    }
+    else {
+        std::memcpy(indices, data.indices.data(), data.indices.size() * sizeof(uint32_t));
+    }
+    return image;
+}
+
+bool writeBakedMesh(const std::string& bakePath, const std::vector<char>& image)
+{
+    std::string tempPath = bakePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(image.data(), static_cast<std::streamsize>(image.size()));
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(bakePath.c_str()); //rename won't replace an existing file on windows
+    if (std::rename(tempPath.c_str(), bakePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool BakedMesh::open(const std::string& bakePath, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format)
+{
+    close();
+    if (!m_file.open(bakePath)) return false;
+    if (validate(m_file.data(), m_file.size(), sourceHash, sourceSize, format)) return true;
+
+    close();
+    return false;
+}
+
+bool BakedMesh::adopt(std::vector<char>&& image)
+{
+    close();
+    m_memory = std::move(image);
+    const BakedMeshHeader* header = reinterpret_cast<const BakedMeshHeader*>(m_memory.data());
+    if (m_memory.size() >= sizeof(BakedMeshHeader) &&
+        validate(m_memory.data(), m_memory.size(), header->sourceHash, header->sourceSize, header->vertexFormat)) return true;
+
+    close();
+    return false;
+}
+
+void BakedMesh::close()
+{
+    m_file.close();
+    m_memory.clear();
+    m_header = nullptr;
+}
+
+bool BakedMesh::validate(const char* data, size_t size, uint64_t sourceHash, uint64_t sourceSize, VertexFormat format)
+{
+    if (size < sizeof(BakedMeshHeader)) return false;
+    const BakedMeshHeader* header = reinterpret_cast<const BakedMeshHeader*>(data);
+
+    if (header->magic != BAKED_MESH_MAGIC || header->version != BAKED_MESH_VERSION) return false;
+    if (header->sourceHash != sourceHash || header->sourceSize != sourceSize) return false;
+    if (header->vertexFormat != format) return false;
+    if (header->fileSize != size) return false;
+    if (header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t)) return false;
+    if (header->attributeCount == 0 || header->attributeCount > BAKED_MESH_MAX_ATTRIBUTES) return false;
+    if (header->lodCount == 0 || header->lodCount > BAKED_MESH_MAX_LODS) return false;
+    if (header->indexCount == 0 || header->indexCount % 3 != 0) return false;
+    if (header->vertexCount == 0) return false;
+    if (!isAligned(header->attributeOffset) || !isAligned(header->lodOffset) || !isAligned(header->vertexOffset) ||
+        !isAligned(header->indexOffset)) return false;
+
+    //every blob has to lie inside the file, in order
+    if (header->attributeOffset + header->attributeCount * sizeof(VertexAttribute) > header->lodOffset) return false;
+    if (header->lodOffset + header->lodCount * sizeof(MeshLod) > header->vertexOffset) return false;
+    if (header->vertexOffset + uint64_t(header->vertexCount) * header->vertexStride > header->indexOffset) return false;
+    if (header->indexOffset + uint64_t(header->indexCount) * header->indexSize > size) return false;
+
+    const VertexAttribute* attributes = reinterpret_cast<const VertexAttribute*>(data + header->attributeOffset);
+    for (uint32_t a = 0; a < header->attributeCount; a++) {
+        const VertexAttribute& attribute = attributes[a];
+        uint32_t typeSize = attributeTypeSize(attribute.type);
+        if (typeSize == 0 || attribute.components == 0 || attribute.components > 4) return false;
+        if (attribute.location >= MAX_ATTRIBUTE_LOCATION) return false;
+        if (uint64_t(attribute.offset) + attribute.components * typeSize > header->vertexStride) return false;
+    }
+
+    const MeshLod* lods = reinterpret_cast<const MeshLod*>(data + header->lodOffset);
+    for (uint32_t l = 0; l < header->lodCount; l++) {
+        if (lods[l].indexCount == 0 || lods[l].indexCount % 3 != 0) return false;
+        if (uint64_t(lods[l].indexOffset) + lods[l].indexCount > header->indexCount) return false;
+    }
+
+    //the hash only covers the source, a damaged bake can still point the gpu past the vertex buffer
+    const char* indices = data + header->indexOffset;
+    uint32_t maxIndex = 0;
+    if (header->indexSize == sizeof(uint16_t)) {
+        const uint16_t* shortIndices = reinterpret_cast<const uint16_t*>(indices);
+        for (uint32_t i = 0; i < header->indexCount; i++) maxIndex = std::max<uint32_t>(maxIndex, shortIndices[i]);
+    }
+    else {
+        const uint32_t* longIndices = reinterpret_cast<const uint32_t*>(indices);
+        for (uint32_t i = 0; i < header->indexCount; i++) maxIndex = std::max(maxIndex, longIndices[i]);
+    }
+    if (maxIndex >= header->vertexCount) return false;
+
+    m_header = header;
+    return true;
+}
+
+MeshBlobs BakedMesh::getBlobs() const
+{
+    MeshBlobs blobs;
+    if (!m_header) return blobs;
+
+    const char* base = reinterpret_cast<const char*>(m_header);
+    blobs.vertices = base + m_header->vertexOffset;
+    blobs.vertexCount = m_header->vertexCount;
+    blobs.vertexStride = m_header->vertexStride;
+    blobs.indices = base + m_header->indexOffset;
+    blobs.indexCount = m_header->indexCount;
+    blobs.indexSize = m_header->indexSize;
+    blobs.attributes = reinterpret_cast<const VertexAttribute*>(base + m_header->attributeOffset);
+    blobs.attributeCount = m_header->attributeCount;
+    blobs.lods = reinterpret_cast<const MeshLod*>(base + m_header->lodOffset);
+    blobs.lodCount = m_header->lodCount;
+    blobs.boundsMin = glm::vec3(m_header->boundsMin[0], m_header->boundsMin[1], m_header->boundsMin[2]);
+    blobs.boundsMax = glm::vec3(m_header->boundsMax[0], m_header->boundsMax[1], m_header->boundsMax[2]);
+    blobs.format = m_header->vertexFormat;
+    return blobs;
+}
+
+
+bool loadBakedMesh(const std::string& sourcePath, BakedMesh& out, JobSystem* jobs, VertexFormat format)
+{
+    MappedFile source(sourcePath);
+    if (!source.isOpen()) {
+        std::cerr << "file path err: " << sourcePath << std::endl;
+        return false;
+    }
+    return loadBakedMesh(sourcePath, source, hashContent(source.data(), source.size()), out, jobs, format);
+}
+
+bool loadBakedMesh(const std::string& sourcePath, const MappedFile& source, uint64_t sourceHash, BakedMesh& out,
+                   JobSystem* jobs, VertexFormat format)
+{
+    out.close();
+
+    std::string bakePath = bakedMeshPath(sourcePath, format);
+    if (out.open(bakePath, sourceHash, source.size(), format)) return true;
+
+    MeshData data;
+    parseObjText(source.data(), source.size(), data, jobs);
+    if (data.indices.empty()) return false;
+
+    generateLods(data);
+    MeshOptimizeReport report = optimizeMesh(data);
+    std::cout << "INFO: baked '" << sourcePath << "', " << data.triangleCount() << " triangles, ACMR "
+              << report.before.acmr << " -> " << report.after.acmr << ", ATVR " << report.before.atvr
+              << " -> " << report.after.atvr << std::endl;
+    for (size_t l = 1; l < data.lods.size(); l++) {
+        std::cout << "INFO:   lod " << l << ": " << data.lods[l].indexCount / 3 << " triangles, error "
+                  << data.lods[l].error << std::endl;
+    }
+
+    std::vector<char> image = serializeBakedMesh(data, sourceHash, source.size(), format);
+    if (writeBakedMesh(bakePath, image) && out.open(bakePath, sourceHash, source.size(), format)) return true;
+
+    //read only install or similar, still fine to use the bake from memory this run
+    std::cerr << "WARNING::MESH: could not write " << bakePath << ", using it from memory" << std::endl;
+    return out.adopt(std::move(image));
+}
@@ -0,0 +1,310 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    //forsyth's scoring constants, the cache here is what the score models, not the hardware's size
+    const int SCORE_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    const uint32_t NO_TRIANGLE = UINT32_MAX;
+
+    const uint32_t VALENCE_TABLE_SIZE = 32;
+
+    // the scores only depend on a small cache position and (capped) valence, so they are tabled once
+    // instead of calling pow per vertex per step
+    struct ScoreTables {
+        float cache[SCORE_CACHE_SIZE];
+        float valence[VALENCE_TABLE_SIZE];
+
+        ScoreTables()
+        {
+            for (int position = 0; position < SCORE_CACHE_SIZE; position++) {
+                //the last triangle's vertices get a fixed score so it isn't always the best to redo them
+                if (position < 3) cache[position] = LAST_TRIANGLE_SCORE;
+                else {
+                    float scale = 1.0f / (SCORE_CACHE_SIZE - 3);
+                    cache[position] = std::pow(1.0f - (position - 3) * scale, CACHE_DECAY_POWER);
+                }
+            }
+            //vertices with few triangles left get a boost, finishing them frees the cache
+            valence[0] = 0.0f;
+            for (uint32_t count = 1; count < VALENCE_TABLE_SIZE; count++) {
+                valence[count] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(count), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        float vertexScore(int cachePosition, uint32_t remainingTriangles) const
+        {
+            if (remainingTriangles == 0) return -1.0f; //nothing left to draw with it
+            float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return score + valence[std::min(remainingTriangles, VALENCE_TABLE_SIZE - 1)];
+        }
+    };
+
+    // fifo cache simulated with timestamps: a vertex is cached while fewer than cacheSize misses
+    // happened since it was loaded. reset() empties it in O(1)
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, uint32_t cacheSize)
+            : m_loadedAt(vertexCount, 0), m_cacheSize(cacheSize), m_time(cacheSize + 1) {}
+
+        bool miss(uint32_t vertex)
+        {
+            if (m_time - m_loadedAt[vertex] <= m_cacheSize) return false;
+            m_loadedAt[vertex] = m_time++;
+            return true;
+        }
+
+        void reset() { m_time += m_cacheSize + 1; }
+
+    private:
+        std::vector<uint32_t> m_loadedAt;
+        uint32_t m_cacheSize;
+        uint32_t m_time;
+    };
+
+    struct Cluster {
+        uint32_t firstTriangle;
+        uint32_t triangleCount;
+        float sortKey;
+    };
+}
+
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0) return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (uint32_t index : indices) {
+        if (cache.miss(index)) misses++;
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    //triangles around each vertex, packed. the first remaining[v] of a vertex's slots are the ones not yet drawn
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices) remaining[index]++;
+
+    std::vector<uint32_t> firstAdjacent(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) firstAdjacent[v + 1] = firstAdjacent[v] + remaining[v];
+
+    std::vector<uint32_t> adjacent(indices.size());
+    std::vector<uint32_t> fill(firstAdjacent.begin(), firstAdjacent.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacent[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    static const ScoreTables tables;
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) score[v] = tables.vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    uint32_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best]) best = static_cast<uint32_t>(t);
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    uint32_t cache[SCORE_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUnemitted = 0;   //fallback when nothing around the cache is left
+
+    while (best != NO_TRIANGLE) {
+        emitted[best] = 1;
+        const uint32_t* corners = &indices[best * 3];
+        out.insert(out.end(), corners, corners + 3);
+
+        for (int c = 0; c < 3; c++) {
+            uint32_t vertex = corners[c];
+            uint32_t* begin = &adjacent[firstAdjacent[vertex]];
+            uint32_t* live = std::find(begin, begin + remaining[vertex], best);
+            std::swap(*live, begin[remaining[vertex] - 1]);
+            remaining[vertex]--;
+        }
+
+        //the triangle's vertices move to the front, everything else shifts back and the tail falls out
+        uint32_t newCache[SCORE_CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int c = 0; c < 3; c++) {
+            if (std::find(newCache, newCache + newCount, corners[c]) == newCache + newCount) newCache[newCount++] = corners[c];
+        }
+        for (int i = 0; i < cacheCount; i++) {
+            if (std::find(corners, corners + 3, cache[i]) == corners + 3) newCache[newCount++] = cache[i];
+        }
+
+        for (int i = 0; i < newCount; i++) {
+            uint32_t vertex = newCache[i];
+            cachePosition[vertex] = i < SCORE_CACHE_SIZE ? i : -1;
+            score[vertex] = tables.vertexScore(cachePosition[vertex], remaining[vertex]);
+        }
+
+        //only triangles touching a vertex whose score changed can have changed, the best is among them
+        //nearly always
+        best = NO_TRIANGLE;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++) {
+            uint32_t vertex = newCache[i];
+            const uint32_t* begin = &adjacent[firstAdjacent[vertex]];
+            for (uint32_t a = 0; a < remaining[vertex]; a++) {
+                uint32_t t = begin[a];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = 0;
+        for (int i = 0; i < newCount && i < SCORE_CACHE_SIZE; i++) cache[cacheCount++] = newCache[i];
+
+        if (best == NO_TRIANGLE) {
+            while (nextUnemitted < triangleCount && emitted[nextUnemitted]) nextUnemitted++;
+            if (nextUnemitted < triangleCount) best = static_cast<uint32_t>(nextUnemitted);
+        }
+    }
+
+    indices.swap(out);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Primitives::Vertex>& vertices, float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) return;
+
+    FifoCache cache(vertices.size(), VERTEX_CACHE_SIZE);
+    auto misses = [&](size_t t) {
+        return int(cache.miss(indices[t * 3])) + int(cache.miss(indices[t * 3 + 1])) + int(cache.miss(indices[t * 3 + 2]));
+    };
+
+    //hard boundaries: a triangle missing all three vertices starts over anyway, cutting there is free
+    std::vector<uint32_t> hard;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int missed = misses(t);
+        if (t == 0 || missed == 3) hard.push_back(static_cast<uint32_t>(t));
+    }
+    hard.push_back(static_cast<uint32_t>(triangleCount));
+
+    //soft boundaries: inside a hard run, cut wherever the part since the last cut already does as well
+    //as the whole run (within threshold) would from a cold cache
+    std::vector<Cluster> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        const uint32_t begin = hard[h], end = hard[h + 1];
+
+        cache.reset();
+        int runMisses = 0;
+        for (uint32_t t = begin; t < end; t++) runMisses += misses(t);
+        const float runAcmr = static_cast<float>(runMisses) / (end - begin);
+
+        cache.reset();
+        uint32_t start = begin;
+        int clusterMisses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            clusterMisses += misses(t);
+            bool cut = t + 1 < end && static_cast<float>(clusterMisses) / (t + 1 - start) <= runAcmr * threshold;
+            if (cut || t + 1 == end) {
+                clusters.push_back({ start, t + 1 - start, 0.0f });
+                start = t + 1;
+                clusterMisses = 0;
+                cache.reset();
+            }
+        }
+    }
+
+    //area weighted centroid and normal per cluster, and the mesh centroid
+    std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross);
+            centroid += (a + b + d) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : normal;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    //clusters facing away from the centre are the outside of the model, draw those first
+    for (size_t c = 0; c < clusters.size(); c++) clusters[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    for (const Cluster& cluster : clusters) {
+        out.insert(out.end(), indices.begin() + cluster.firstTriangle * 3,
+                   indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+    }
+    indices.swap(out);
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Primitives::Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+MeshOptimizeReport optimizeMesh(MeshData& mesh)
+{
+    //each lod is its own index range, reordered on its own. the fetch order follows the full detail
+    //level, which is also the one the report is about
+    std::vector<MeshLod> lods = mesh.getLods();
+    auto levelIndices = [&](const MeshLod& lod) {
+        return std::vector<uint32_t>(mesh.indices.begin() + lod.indexOffset, mesh.indices.begin() + lod.indexOffset + lod.indexCount);
+    };
+
+    MeshOptimizeReport report;
+    report.before = analyzeVertexCache(levelIndices(lods[0]), mesh.vertices.size());
+
+    for (const MeshLod& lod : lods) {
+        std::vector<uint32_t> level = levelIndices(lod);
+        optimizeVertexCache(level, mesh.vertices.size());
+        optimizeOverdraw(level, mesh.vertices);
+        std::copy(level.begin(), level.end(), mesh.indices.begin() + lod.indexOffset);
+    }
+    optimizeVertexFetch(mesh);
+    mesh.updateBounds();
+
+    report.after = analyzeVertexCache(levelIndices(lods[0]), mesh.vertices.size());
+    return report;
+}
@@ -0,0 +1,190 @@
+#include "MeshRegistry.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <functional>
+#include <iostream>
+
+
+namespace {
+    //the same spelling for ./sphere.txt, sphere.txt and an absolute path to it. falls back to the path
+    //as given when the filesystem can't resolve it
+    std::string canonicalPath(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(std::filesystem::path(path), error);
+        if (error) return path;
+        return canonical.generic_string();
+    }
+
+    //size and modification time, a cheap stand in for the content until either changes
+    bool fileIdentity(const std::string& path, uint64_t& size, int64_t& time)
+    {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if (error) return false;
+        time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        return !error;
+    }
+}
+
+
+MeshHandle::MeshHandle(const MeshHandle& other)
+    : m_registry(other.m_registry), m_slot(other.m_slot)
+{
+    if (m_registry) m_registry->retain(m_slot);
+}
+
+MeshHandle& MeshHandle::operator=(const MeshHandle& other)
+{
+    if (this == &other) return *this;
+    if (other.m_registry) other.m_registry->retain(other.m_slot); //first, in case both point at the last reference
+    reset();
+    m_registry = other.m_registry;
+    m_slot = other.m_slot;
+    return *this;
+}
+
+MeshHandle::MeshHandle(MeshHandle&& other) noexcept
+    : m_registry(other.m_registry), m_slot(other.m_slot)
+{
+    other.m_registry = nullptr;
+}
+
+MeshHandle& MeshHandle::operator=(MeshHandle&& other) noexcept
+{
+    if (this == &other) return *this;
+    reset();
+    m_registry = other.m_registry;
+    m_slot = other.m_slot;
+    other.m_registry = nullptr;
+    return *this;
+}
+
+void MeshHandle::reset()
+{
+    if (m_registry) m_registry->release(m_slot);
+    m_registry = nullptr;
+}
+
+Mesh* MeshHandle::get() const
+{
+    return m_registry ? m_registry->m_assets[m_slot].mesh.get() : nullptr;
+}
+
+
+size_t MeshRegistry::AssetKeyHash::operator()(const AssetKey& key) const
+{
+    return std::hash<std::string>()(key.path) ^ static_cast<size_t>(key.format);
+}
+
+MeshRegistry::~MeshRegistry()
+{
+    if (getAssetCount() > 0) {
+        std::cerr << "WARNING::MESH: registry destroyed with " << getAssetCount() << " meshes still referenced" << std::endl;
+    }
+}
+
+MeshHandle MeshRegistry::load(const std::string& modelPath, VertexFormat format)
+{
+    uint64_t fileSize;
+    int64_t fileTime;
+    if (!fileIdentity(modelPath, fileSize, fileTime)) {
+        std::cerr << "ERROR::MESH: Failed to load model or model is empty: " << modelPath << std::endl;
+        return MeshHandle();
+    }
+
+    AssetKey key{ canonicalPath(modelPath), format };
+    auto found = m_lookup.find(key);
+    if (found != m_lookup.end()) {
+        Asset& current = m_assets[found->second];
+        if (current.fileSize == fileSize && current.fileTime == fileTime) {
+            retain(found->second);
+            return MeshHandle(this, found->second);
+        }
+    }
+
+    //new to the registry, or touched since it was loaded, only the content can tell which
+    MappedFile source(modelPath);
+    if (!source.isOpen()) {
+        std::cerr << "ERROR::MESH: Failed to load model or model is empty: " << modelPath << std::endl;
+        return MeshHandle();
+    }
+    uint64_t contentHash = hashContent(source.data(), source.size());
+    if (found != m_lookup.end() && m_assets[found->second].info.contentHash == contentHash) {
+        Asset& current = m_assets[found->second];
+        current.fileSize = fileSize;
+        current.fileTime = fileTime;
+        retain(found->second);
+        return MeshHandle(this, found->second);
+    }
+
+    std::unique_ptr<Mesh> mesh;
+    {
+        BakedMesh baked;
+        if (loadBakedMesh(modelPath, source, contentHash, baked, m_jobs, format)) mesh = std::make_unique<Mesh>(baked);
+    }
+    if (!mesh || !mesh->isLoaded()) {
+        std::cerr << "ERROR::MESH: Failed to load model or model is empty: " << modelPath << std::endl;
+        return MeshHandle(); //failures aren't kept, the next load tries again
+    }
+
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(m_assets.size());
+        m_assets.emplace_back();
+    }
+
+    Asset& asset = m_assets[slot];
+    asset.info.path = key.path;
+    asset.info.contentHash = contentHash;
+    asset.info.format = format;
+    asset.info.references = 1;
+    asset.info.vertexBytes = mesh->getVertexBytes();
+    asset.info.indexBytes = mesh->getIndexBytes();
+    asset.fileSize = fileSize;
+    asset.fileTime = fileTime;
+    asset.mesh = std::move(mesh);
+    m_gpuBytes += asset.info.getGpuBytes();
+    m_lookup[std::move(key)] = slot; //an older version stays loaded for its handles, but is never handed out again
+
+    std::cout << "INFO: loaded mesh '" << asset.info.path << "', " << asset.info.getGpuBytes() << " bytes, "
+              << getAssetCount() << " meshes " << m_gpuBytes << " bytes total" << std::endl;
+    return MeshHandle(this, slot);
+}
+
+std::vector<MeshAssetInfo> MeshRegistry::getAssets() const
+{
+    std::vector<MeshAssetInfo> assets;
+    assets.reserve(getAssetCount());
+    for (const Asset& asset : m_assets) {
+        if (asset.mesh) assets.push_back(asset.info);
+    }
+    return assets;
+}
+
+void MeshRegistry::retain(uint32_t slot)
+{
+    m_assets[slot].info.references++;
+}
+
+void MeshRegistry::release(uint32_t slot)
+{
+    Asset& asset = m_assets[slot];
+    if (--asset.info.references > 0) return;
+
+    std::cout << "INFO: unloaded mesh '" << asset.info.path << "', " << asset.info.getGpuBytes() << " bytes" << std::endl;
+    auto found = m_lookup.find(AssetKey{ asset.info.path, asset.info.format });
+    if (found != m_lookup.end() && found->second == slot) m_lookup.erase(found);
+    m_gpuBytes -= asset.info.getGpuBytes();
+    asset.mesh.reset();
+    asset.info = MeshAssetInfo();
+    asset.fileSize = 0;
+    asset.fileTime = 0;
+    m_freeSlots.push_back(slot);
+}
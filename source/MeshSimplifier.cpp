@@ -0,0 +1,414 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+
+namespace {
+    const uint32_t DEAD = UINT32_MAX;
+    const double BORDER_WEIGHT = 10.0;     //border planes count this many times a face of the same size
+    const float MIN_NORMAL_AGREEMENT = 0.2f;//cosine, below it a collapse counts as folding a triangle over
+    const float MIN_LOD_SHRINK = 0.9f;      //a level keeping more than this much of the previous one is skipped
+
+    // sum of squared distances to a set of planes as a symmetric 4x4 matrix, and the total weight so
+    // the error can be turned back into a distance
+    struct Quadric {
+        double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& normal, double distance, double planeWeight)
+        {
+            xx += planeWeight * normal.x * normal.x;
+            xy += planeWeight * normal.x * normal.y;
+            xz += planeWeight * normal.x * normal.z;
+            xw += planeWeight * normal.x * distance;
+            yy += planeWeight * normal.y * normal.y;
+            yz += planeWeight * normal.y * normal.z;
+            yw += planeWeight * normal.y * distance;
+            zz += planeWeight * normal.z * normal.z;
+            zw += planeWeight * normal.z * distance;
+            ww += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+
+        void add(const Quadric& other)
+        {
+            xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+            yy += other.yy; yz += other.yz; yw += other.yw;
+            zz += other.zz; zw += other.zw; ww += other.ww;
+            weight += other.weight;
+        }
+
+        double evaluate(const glm::dvec3& p) const
+        {
+            double result = xx * p.x * p.x + yy * p.y * p.y + zz * p.z * p.z + ww
+                          + 2.0 * (xy * p.x * p.y + xz * p.x * p.z + yz * p.y * p.z + xw * p.x + yw * p.y + zw * p.z);
+            return std::max(result, 0.0);
+        }
+    };
+
+    struct Collapse {
+        float cost;         //rms distance, what the level's error is made of
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    // position welded working copy of the mesh, the simplification itself runs on "points" (distinct
+    // positions) rather than vertices
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<uint32_t>& indices, const std::vector<Primitives::Vertex>& vertices)
+            : m_indices(indices), m_vertices(vertices)
+        {
+            weld();
+            buildTriangles();
+            buildQuadrics();
+            for (uint32_t point = 0; point < m_points.size(); point++) pushEdges(point, true);
+        }
+
+        // can be called again with a lower target to carry on, the error keeps growing from where it was.
+        // quadrics only ever gain planes, so it is always measured against the original surface
+        float run(size_t targetIndexCount)
+        {
+            while (m_liveTriangles * 3 > targetIndexCount && !m_queue.empty()) {
+                Collapse collapse = m_queue.top();
+                m_queue.pop();
+
+                if (m_pointOf[collapse.from] == DEAD || m_pointOf[collapse.to] == DEAD) continue;
+                if (m_version[collapse.from] != collapse.fromVersion || m_version[collapse.to] != collapse.toVersion) continue;
+                if (!canCollapse(collapse.from, collapse.to)) continue;
+
+                apply(collapse.from, collapse.to);
+                m_error = std::max(m_error, collapse.cost);
+            }
+            return m_error;
+        }
+
+        void write(std::vector<uint32_t>& out) const
+        {
+            out.clear();
+            for (uint32_t t = 0; t < m_triangleAlive.size(); t++) {
+                if (!m_triangleAlive[t]) continue;
+
+                uint32_t corners[3];
+                for (int c = 0; c < 3; c++) corners[c] = pickVertex(m_indices[t * 3 + c], m_corners[t * 3 + c]);
+                if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) continue;
+                out.insert(out.end(), corners, corners + 3);
+            }
+        }
+
+    private:
+        void weld()
+        {
+            std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+            m_pointOfVertex.resize(m_vertices.size());
+            for (uint32_t v = 0; v < m_vertices.size(); v++) {
+                glm::vec3 p = m_vertices[v].position + glm::vec3(0.0f); //-0 becomes 0, they compare equal but hash apart
+                uint64_t key = std::hash<float>()(p.x) * 73856093ull ^ std::hash<float>()(p.y) * 19349663ull ^ std::hash<float>()(p.z) * 83492791ull;
+
+                uint32_t point = DEAD;
+                for (uint32_t candidate : buckets[key]) {
+                    if (m_points[candidate] == p) {
+                        point = candidate;
+                        break;
+                    }
+                }
+                if (point == DEAD) {
+                    point = static_cast<uint32_t>(m_points.size());
+                    m_points.push_back(p);
+                    buckets[key].push_back(point);
+                }
+                m_pointOfVertex[v] = point;
+            }
+
+            m_pointOf.resize(m_points.size());
+            for (uint32_t point = 0; point < m_points.size(); point++) m_pointOf[point] = point;
+            m_version.assign(m_points.size(), 0);
+
+            m_vertexFirst.assign(m_points.size() + 1, 0);
+            for (uint32_t point : m_pointOfVertex) m_vertexFirst[point + 1]++;
+            for (size_t p = 0; p < m_points.size(); p++) m_vertexFirst[p + 1] += m_vertexFirst[p];
+            m_vertexList.resize(m_vertices.size());
+            std::vector<uint32_t> fill(m_vertexFirst.begin(), m_vertexFirst.end() - 1);
+            for (uint32_t v = 0; v < m_vertices.size(); v++) m_vertexList[fill[m_pointOfVertex[v]]++] = v;
+        }
+
+        void buildTriangles()
+        {
+            const size_t triangleCount = m_indices.size() / 3;
+            m_corners.resize(m_indices.size());
+            m_triangleAlive.assign(triangleCount, 0);
+            m_trianglesOf.resize(m_points.size());
+
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                uint32_t a = m_pointOfVertex[m_indices[t * 3]];
+                uint32_t b = m_pointOfVertex[m_indices[t * 3 + 1]];
+                uint32_t c = m_pointOfVertex[m_indices[t * 3 + 2]];
+                m_corners[t * 3] = a;
+                m_corners[t * 3 + 1] = b;
+                m_corners[t * 3 + 2] = c;
+                if (a == b || b == c || a == c) continue; //already degenerate, dropped
+
+                m_triangleAlive[t] = 1;
+                m_liveTriangles++;
+                m_trianglesOf[a].push_back(t);
+                m_trianglesOf[b].push_back(t);
+                m_trianglesOf[c].push_back(t);
+            }
+        }
+
+        void buildQuadrics()
+        {
+            m_quadrics.resize(m_points.size());
+
+            //face planes weighted by area, and for every edge only one triangle uses, a plane through it
+            //standing up from the face so the border can't slide inward
+            std::unordered_map<uint64_t, uint32_t> edgeUse;
+            auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+
+            for (uint32_t t = 0; t < m_triangleAlive.size(); t++) {
+                if (!m_triangleAlive[t]) continue;
+                const uint32_t* corners = &m_corners[t * 3];
+                glm::dvec3 p0(m_points[corners[0]]), p1(m_points[corners[1]]), p2(m_points[corners[2]]);
+                glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+                double area = glm::length(cross) * 0.5;
+                if (area <= 0.0) continue;
+
+                glm::dvec3 normal = cross / (area * 2.0);
+                Quadric face;
+                face.addPlane(normal, -glm::dot(normal, p0), area);
+                for (int c = 0; c < 3; c++) m_quadrics[corners[c]].add(face);
+                for (int c = 0; c < 3; c++) edgeUse[edgeKey(corners[c], corners[(c + 1) % 3])]++;
+            }
+
+            for (uint32_t t = 0; t < m_triangleAlive.size(); t++) {
+                if (!m_triangleAlive[t]) continue;
+                const uint32_t* corners = &m_corners[t * 3];
+                glm::dvec3 p0(m_points[corners[0]]), p1(m_points[corners[1]]), p2(m_points[corners[2]]);
+                glm::dvec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+                if (glm::length(faceNormal) <= 0.0) continue;
+                faceNormal = glm::normalize(faceNormal);
+
+                for (int c = 0; c < 3; c++) {
+                    uint32_t a = corners[c], b = corners[(c + 1) % 3];
+                    if (edgeUse[edgeKey(a, b)] != 1) continue;
+
+                    glm::dvec3 pa(m_points[a]), pb(m_points[b]);
+                    glm::dvec3 edge = pb - pa;
+                    double length = glm::length(edge);
+                    if (length <= 0.0) continue;
+
+                    glm::dvec3 normal = glm::normalize(glm::cross(edge, faceNormal));
+                    Quadric border;
+                    border.addPlane(normal, -glm::dot(normal, pa), BORDER_WEIGHT * length * length);
+                    m_quadrics[a].add(border);
+                    m_quadrics[b].add(border);
+                }
+            }
+        }
+
+        // rms distance of point "at" to the planes both ends stand for
+        float cost(uint32_t from, uint32_t to) const
+        {
+            Quadric merged = m_quadrics[from];
+            merged.add(m_quadrics[to]);
+            if (merged.weight <= 0.0) return 0.0f;
+            return static_cast<float>(std::sqrt(merged.evaluate(glm::dvec3(m_points[to])) / merged.weight));
+        }
+
+        void pushEdge(uint32_t a, uint32_t b)
+        {
+            float ab = cost(a, b), ba = cost(b, a);
+            if (ab <= ba) m_queue.push({ ab, a, b, m_version[a], m_version[b] });
+            else m_queue.push({ ba, b, a, m_version[b], m_version[a] });
+        }
+
+        // seeding pushes each edge once, from its lower end
+        void pushEdges(uint32_t point, bool seeding)
+        {
+            for (uint32_t t : m_trianglesOf[point]) {
+                if (!m_triangleAlive[t]) continue;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t other = m_corners[t * 3 + c];
+                    if (other != point && (!seeding || other > point)) pushEdge(point, other);
+                }
+            }
+        }
+
+        void neighbours(uint32_t point, std::vector<uint32_t>& out) const
+        {
+            out.clear();
+            for (uint32_t t : m_trianglesOf[point]) {
+                if (!m_triangleAlive[t]) continue;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t other = m_corners[t * 3 + c];
+                    if (other != point) out.push_back(other);
+                }
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        bool canCollapse(uint32_t from, uint32_t to)
+        {
+            //link condition: the ends may only share the neighbours of the triangles on the edge itself,
+            //anything more and the collapse pinches the surface
+            size_t shared = 0;
+            for (uint32_t t : m_trianglesOf[from]) {
+                if (!m_triangleAlive[t]) continue;
+                const uint32_t* corners = &m_corners[t * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to) shared++;
+            }
+            if (shared == 0) return false;
+
+            neighbours(from, m_scratchA);
+            neighbours(to, m_scratchB);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < m_scratchA.size() && j < m_scratchB.size();) {
+                if (m_scratchA[i] < m_scratchB[j]) i++;
+                else if (m_scratchA[i] > m_scratchB[j]) j++;
+                else { common++; i++; j++; }
+            }
+            if (common != shared) return false;
+
+            //no triangle that stays may turn over or collapse to nothing
+            for (uint32_t t : m_trianglesOf[from]) {
+                if (!m_triangleAlive[t]) continue;
+                const uint32_t* corners = &m_corners[t * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+
+                glm::vec3 before[3], after[3];
+                for (int c = 0; c < 3; c++) {
+                    before[c] = m_points[corners[c]];
+                    after[c] = corners[c] == from ? m_points[to] : before[c];
+                }
+                glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+                float oldLength = glm::length(oldNormal), newLength = glm::length(newNormal);
+                if (newLength <= 0.0f || oldLength <= 0.0f) return false;
+                if (glm::dot(oldNormal, newNormal) < MIN_NORMAL_AGREEMENT * oldLength * newLength) return false;
+            }
+            return true;
+        }
+
+        void apply(uint32_t from, uint32_t to)
+        {
+            for (uint32_t t : m_trianglesOf[from]) {
+                if (!m_triangleAlive[t]) continue;
+                uint32_t* corners = &m_corners[t * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to) {
+                    m_triangleAlive[t] = 0;
+                    m_liveTriangles--;
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    if (corners[c] == from) corners[c] = to;
+                }
+                m_trianglesOf[to].push_back(t);
+            }
+
+            std::vector<uint32_t>& around = m_trianglesOf[to];
+            around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !m_triangleAlive[t]; }), around.end());
+            m_trianglesOf[from].clear();
+            m_trianglesOf[from].shrink_to_fit();
+
+            m_quadrics[to].add(m_quadrics[from]);
+            m_pointOf[from] = DEAD;
+            m_version[to]++;
+            pushEdges(to, false);
+        }
+
+        // the vertex a corner ends up on: its own if its point survived, otherwise whichever vertex of
+        // the surviving point has the closest uv and normal, so seams stay seams
+        uint32_t pickVertex(uint32_t original, uint32_t point) const
+        {
+            if (m_pointOfVertex[original] == point) return original;
+
+            const Primitives::Vertex& want = m_vertices[original];
+            uint32_t best = m_vertexList[m_vertexFirst[point]];
+            float bestDistance = INFINITY;
+            for (uint32_t i = m_vertexFirst[point]; i < m_vertexFirst[point + 1]; i++) {
+                const Primitives::Vertex& candidate = m_vertices[m_vertexList[i]];
+                glm::vec3 normalDelta = candidate.normal - want.normal;
+                glm::vec2 uvDelta = candidate.texCoord - want.texCoord;
+                float distance = glm::dot(normalDelta, normalDelta) + glm::dot(uvDelta, uvDelta);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = m_vertexList[i];
+                }
+            }
+            return best;
+        }
+
+        const std::vector<uint32_t>& m_indices;
+        const std::vector<Primitives::Vertex>& m_vertices;
+
+        std::vector<glm::vec3> m_points;
+        std::vector<uint32_t> m_pointOfVertex;
+        std::vector<uint32_t> m_pointOf;            //itself while alive, DEAD once collapsed
+        std::vector<uint32_t> m_version;            //bumped whenever a point's quadric or triangles change
+        std::vector<uint32_t> m_vertexFirst;        //vertices of each point, packed
+        std::vector<uint32_t> m_vertexList;
+
+        std::vector<uint32_t> m_corners;            //points of each triangle
+        std::vector<uint8_t> m_triangleAlive;
+        std::vector<std::vector<uint32_t>> m_trianglesOf;
+        size_t m_liveTriangles = 0;
+        float m_error = 0.0f;
+
+        std::vector<Quadric> m_quadrics;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+        std::vector<uint32_t> m_scratchA, m_scratchB;
+    };
+}
+
+
+float simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Primitives::Vertex>& vertices,
+                   size_t targetIndexCount, std::vector<uint32_t>& out)
+{
+    Simplifier simplifier(indices, vertices);
+    float error = simplifier.run(targetIndexCount);
+    simplifier.write(out);
+    return error;
+}
+
+void generateLods(MeshData& mesh, const float* ratios, size_t ratioCount)
+{
+    mesh.lods = mesh.getLods();
+    mesh.lods.resize(1);
+    if (mesh.triangleCount() < MIN_LOD_TRIANGLES) return;
+
+    const std::vector<uint32_t> full(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+    Simplifier simplifier(full, mesh.vertices);
+    std::vector<uint32_t> level;
+    for (size_t r = 0; r < ratioCount; r++) {
+        size_t target = static_cast<size_t>(full.size() / 3 * ratios[r]) * 3;
+        float error = simplifier.run(target);
+        simplifier.write(level);
+
+        const MeshLod& previous = mesh.lods.back();
+        if (level.empty() || level.size() > previous.indexCount * MIN_LOD_SHRINK) break;
+
+        mesh.lods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(level.size()), error });
+        mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+    }
+}
+
+size_t selectLod(const MeshLod* lods, size_t lodCount, float distance, float worldScale, float fovY,
+                 int viewportHeight, float maxPixelError)
+{
+    if (lodCount <= 1 || distance <= 0.0f) return 0;
+
+    //pixels per model unit at that distance
+    float pixelsPerUnit = worldScale * viewportHeight / (2.0f * std::tan(fovY * 0.5f) * distance);
+    for (size_t lod = lodCount - 1; lod > 0; lod--) {
+        if (lods[lod].error * pixelsPerUnit <= maxPixelError) return lod;
+    }
+    return 0;
+}
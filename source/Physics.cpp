@@ -1,152 +1,553 @@
+#include "Determinism.h"
 #include "Physics.h"
 #include <glm/glm.hpp>
-#include <algorithm> 
+#include <algorithm>
+#include <array>
+#include <cassert>
 
 
-Physics::Physics() : m_gravityEnabled(false) {}
+namespace {
+    //parallelFor range sizes per stage, big enough that a range is worth a job
+    const size_t BODY_GRAIN = 4096;
+    const size_t PAIR_GRAIN = 1024;
+    const size_t ISLAND_GRAIN = 16;
+
+    //a fast body can bounce off this many things in one step before the rest of its motion is dropped
+    const int MAX_CCD_SUBSTEPS = 4;
+    //how far a fast body is pushed into a moving body it hits so the contact solver sees the overlap
+    const float CCD_SKIN = 0.01f;
+}
+
+
+Physics::Physics() : m_gravityEnabled(false), m_backend(PhysicsKernels::detectBackend()) {}
 
 
-void Physics::update(GlowingOrb& orb, Plane& plane, Cube* cube, const InputState& input, float deltaTime)
+void Physics::applyInput(RigidBodyStore& bodies, const InputState& input)
 {
     if (input.toggleGravity) {
         m_gravityEnabled = !m_gravityEnabled;
 
         if (!m_gravityEnabled) {
-            orb.velocity = glm::vec3(0.0f);
-            if (cube != nullptr) {
-                cube->velocity = glm::vec3(0.0f);
-            }
+            bodies.clearVelocities();
         }
+        //whatever fell asleep under the old gravity isnt at rest under the new one
+        bodies.wakeAll();
     }
+}
 
-    if (input.shouldInteract) {
-        orb.energy += 1.0f * deltaTime;
-        orb.energy = glm::min(orb.energy, 1.0f);
-    }
-    else {
-        orb.energy -= 0.1f * deltaTime;
-        orb.energy = glm::max(orb.energy, 0.0f);
-    }
+void Physics::update(RigidBodyStore& bodies, const Plane& plane, float deltaTime)
+{
+    m_impacts.clear();
+
+    //ids freed since the last step may already belong to new bodies, which must not inherit the old impulses
+    m_solver.forgetBodies(bodies.getRemovedIds());
+    bodies.clearRemovedIds();
+
+    //bodies woken since the last step (teleported, pushed, something removed under them) bring
+    //the rest of their island with them
+    wakeIslands(bodies);
+
+    integrate(bodies, deltaTime);
+    solveContinuous(bodies, plane, deltaTime);
+    solveCollisions(bodies, plane, deltaTime);
+
+    //forces only live for one step, anything added between steps is consumed above
+    bodies.clearForces();
 
-    orb.forceAccumulator = glm::vec3(0.0f);
-    if (cube != nullptr) {
-        cube->forceAccumulator = glm::vec3(0.0f);
+    m_stepCount++;
+    if (m_deterministic) {
+        //a different dt is a different simulation, lockstep only works with the fixed clock step
+        if (m_deterministicStep == 0.0f) m_deterministicStep = deltaTime;
+        assert(deltaTime == m_deterministicStep);
+        m_stateHash = computeStateHash(bodies);
     }
+}
 
-    if (m_gravityEnabled) {
-        const float gravity = -9.8f;
+uint64_t Physics::computeStateHash(const RigidBodyStore& bodies) const
+{
+    StateHasher hasher;
+    hasher.add(static_cast<uint32_t>(m_gravityEnabled));
+    bodies.hashState(hasher);
+    m_solver.hashState(hasher);
+    return hasher.get();
+}
 
-        if (orb.eq_state == EquilibriumState::AWAKE) {
-            glm::vec3 orbGravityForce = glm::vec3(0.0f, gravity * orb.mass, 0.0f);
-            orb.forceAccumulator += orbGravityForce;
+void Physics::decayEnergy(Registry& registry, BodyId interactingBody, float deltaTime)
+{
+    registry.each<GlowingOrb, RigidBody>([&](Entity, GlowingOrb& orb, RigidBody& body) {
+        if (body.body == interactingBody) {
+            orb.energy += 1.0f * deltaTime;
+            orb.energy = glm::min(orb.energy, 1.0f);
         }
-        if (cube != nullptr && cube->state == EquilibriumState::AWAKE) {
-            glm::vec3 cubeGravityForce = glm::vec3(0.0f, gravity * cube->mass, 0.0f);
-            cube->forceAccumulator += cubeGravityForce;
+        else {
+            orb.energy -= 0.1f * deltaTime;
+            orb.energy = glm::max(orb.energy, 0.0f);
         }
-    }
+    });
+}
 
-    if (orb.eq_state == EquilibriumState::AWAKE) {
-        glm::vec3 acceleration = orb.forceAccumulator * orb.inverseMass;
-        orb.velocity += acceleration * deltaTime;
-        orb.position += orb.velocity * deltaTime;
-    }
-    if (cube != nullptr && cube->state == EquilibriumState::AWAKE) {
-        glm::vec3 acceleration = cube->forceAccumulator * cube->inverseMass;
-        cube->velocity += acceleration * deltaTime;
-        cube->position += cube->velocity * deltaTime;
-    }
+void Physics::absorbImpacts(Registry& registry, const std::vector<ImpactEvent>& impacts)
+{
+    if (impacts.empty()) return;
 
-    solveSpherePlaneCollision(orb, plane);
-    if (cube != nullptr) {
-        solveCubePlaneCollision(*cube, plane);
-    }
+    registry.each<GlowingOrb, RigidBody>([&](Entity, GlowingOrb& orb, RigidBody& body) {
+        for (const ImpactEvent& impact : impacts) {
+            if (impact.body == body.body) {
+                float energyGain = impact.speed * 0.1f;
+                orb.energy += energyGain;
+                orb.energy = glm::min(orb.energy, 1.0f);
+            }
+        }
+    });
+}
 
+PhysicsKernels::BodyArrays Physics::bodyArrays(RigidBodyStore& bodies)
+{
+    m_planeSeparation.resize(bodies.size());
+
+    PhysicsKernels::BodyArrays arrays;
+    arrays.posX = bodies.posX.data();
+    arrays.posY = bodies.posY.data();
+    arrays.posZ = bodies.posZ.data();
+    arrays.velX = bodies.velX.data();
+    arrays.velY = bodies.velY.data();
+    arrays.velZ = bodies.velZ.data();
+    arrays.forceX = bodies.forceX.data();
+    arrays.forceY = bodies.forceY.data();
+    arrays.forceZ = bodies.forceZ.data();
+    arrays.inverseMass = bodies.inverseMass.data();
+    arrays.rotW = bodies.rotW.data();
+    arrays.rotX = bodies.rotX.data();
+    arrays.rotY = bodies.rotY.data();
+    arrays.rotZ = bodies.rotZ.data();
+    arrays.angVelX = bodies.angVelX.data();
+    arrays.angVelY = bodies.angVelY.data();
+    arrays.angVelZ = bodies.angVelZ.data();
+    arrays.torqueX = bodies.torqueX.data();
+    arrays.torqueY = bodies.torqueY.data();
+    arrays.torqueZ = bodies.torqueZ.data();
+    arrays.invInertiaX = bodies.invInertiaX.data();
+    arrays.invInertiaY = bodies.invInertiaY.data();
+    arrays.invInertiaZ = bodies.invInertiaZ.data();
+    arrays.invInertiaXX = bodies.invInertiaXX.data();
+    arrays.invInertiaXY = bodies.invInertiaXY.data();
+    arrays.invInertiaXZ = bodies.invInertiaXZ.data();
+    arrays.invInertiaYY = bodies.invInertiaYY.data();
+    arrays.invInertiaYZ = bodies.invInertiaYZ.data();
+    arrays.invInertiaZZ = bodies.invInertiaZZ.data();
+    arrays.radius = bodies.radius.data();
+    arrays.halfX = bodies.halfX.data();
+    arrays.halfY = bodies.halfY.data();
+    arrays.halfZ = bodies.halfZ.data();
+    arrays.extentX = bodies.extentX.data();
+    arrays.extentY = bodies.extentY.data();
+    arrays.extentZ = bodies.extentZ.data();
+    arrays.state = bodies.state.data();
+    arrays.planeSeparation = m_planeSeparation.data();
+    arrays.count = bodies.size();
+    return arrays;
 }
 
-void Physics::solveSpherePlaneCollision(GlowingOrb& orb, Plane& plane)
+void Physics::integrate(RigidBodyStore& bodies, float deltaTime)
 {
-    float radius = orb.collider.radius;
-    glm::vec3 normal = plane.collider.normal;
-    float planeDist = glm::dot(plane.position, normal);
-    float orbDist = glm::dot(orb.position, normal);
-    float penetration = (orbDist - radius) - planeDist;
+    const float gravity = m_gravityEnabled ? -9.8f : 0.0f;
+
+    //semi implicit euler, gravity is an acceleration so it skips the mass multiply/divide round trip
+    PhysicsKernels::BodyArrays arrays = bodyArrays(bodies);
+    parallelFor(m_jobs, arrays.count, BODY_GRAIN, [&](size_t begin, size_t end) {
+        PhysicsKernels::integrate(m_backend, arrays, begin, end, gravity, deltaTime);
+        PhysicsKernels::integrateAngular(m_backend, arrays, begin, end, deltaTime);
+    });
+}
+
+void Physics::solveContinuous(RigidBodyStore& bodies, const Plane& plane, float deltaTime)
+{
+    const glm::vec3 n = plane.collider.normal;
+    const glm::vec3 absN = glm::abs(n);
+    const float planeDistance = glm::dot(plane.position, n);
+    const SolverSettings& solver = m_solver.getSettings();
+
+    const uint32_t count = static_cast<uint32_t>(bodies.size());
+    for (uint32_t i = 0; i < count; i++) {
+        if (!bodies.isActive(i)) continue;
+
+        //only bodies that moved further than their own size this step can have skipped over something,
+        //everything else is caught by the discrete tests
+        glm::vec3 velocity(bodies.velX[i], bodies.velY[i], bodies.velZ[i]);
+        glm::vec3 half(bodies.halfX[i], bodies.halfY[i], bodies.halfZ[i]);
+        float radius = bodies.radius[i];
+        float size = radius + glm::min(half.x, glm::min(half.y, half.z));
+
+        glm::vec3 motion = velocity * deltaTime;
+        if (glm::dot(motion, motion) <= size * size) continue;
+
+        //redo this body's step from where it started, one sub step per thing it bounces off
+        BodyId id = bodies.idAt(i);
+        glm::vec3 position = glm::vec3(bodies.posX[i], bodies.posY[i], bodies.posZ[i]) - motion;
+        float support = glm::dot(glm::vec3(bodies.extentX[i], bodies.extentY[i], bodies.extentZ[i]), absN);
+        float remaining = 1.0f;
+
+        for (int substep = 0; substep < MAX_CCD_SUBSTEPS && remaining > 0.0f; substep++) {
+            glm::vec3 move = velocity * (deltaTime * remaining);
+            float toi = 1.0f;
+            glm::vec3 normal(0.0f);
+            uint32_t hitIndex = INVALID_BODY;
+
+            float startDist = glm::dot(position, n) - support - planeDistance;
+            float endDist = glm::dot(position + move, n) - support - planeDistance;
+            if (startDist >= 0.0f && endDist < 0.0f) {
+                toi = startDist / (startDist - endDist);
+                normal = n;
+            }
 
-    if (penetration < 0.0f)
-    {
-        orb.eq_state = EquilibriumState::AWAKE;
-        orb.sleepTimer = 0.0f;
+            //swept sphere against boxes that never turn, boxes themselves only get the plane
+            if (radius > 0.0f) {
+                AABB swept = AABB::merge({ position - radius, position + radius }, { position + move - radius, position + move + radius });
+                queryAABB(bodies, swept, m_ccdCandidates);
+
+                for (BodyId other : m_ccdCandidates) {
+                    uint32_t j = bodies.indexOf(other);
+                    if (j == i || bodies.getCollider(bodies.colliderIndex[j]).type != ShapeType::AABB) continue;
+
+                    glm::vec3 boxPos(bodies.posX[j], bodies.posY[j], bodies.posZ[j]);
+                    glm::vec3 boxHalf(bodies.halfX[j], bodies.halfY[j], bodies.halfZ[j]);
+                    float t;
+                    glm::vec3 boxNormal;
+                    if (Narrowphase::sweepSphereAABB(position, move, radius, boxPos, boxHalf, t, boxNormal) && t < toi) {
+                        toi = t;
+                        normal = boxNormal;
+                        hitIndex = j;
+                    }
+                }
+            }
+
+            if (toi >= 1.0f) {
+                position += move;
+                break;
+            }
 
-        //resolving penetration(overlap)
-        orb.position -= normal * penetration;
+            position += move * toi;
+            remaining *= 1.0f - toi;
 
-        //resolving vel
-        float velocityAlongNormal = glm::dot(orb.velocity, normal);
+            if (hitIndex != INVALID_BODY && bodies.inverseMass[hitIndex] > 0.0f) {
+                //something that can move, stop just inside it and let the contact solver share the hit out
+                position += glm::normalize(move) * CCD_SKIN;
+                bodies.wake(bodies.idAt(hitIndex));
+                break;
+            }
 
-        if (velocityAlongNormal < 0.0f)
-        {
-            float impactVelocity = glm::abs(velocityAlongNormal);
+            //the plane or a static box, bounce here and spend what is left of the step moving away
+            float approach = -glm::dot(velocity, normal);
+            bool isPlane = hitIndex == INVALID_BODY;
+            float bounce = isPlane ? solver.planeRestitution : solver.restitution;
+            float restThreshold = isPlane ? solver.planeRestitutionThreshold : solver.restitutionThreshold;
 
-            const float restThreshold = 0.1f;
+            if (approach < restThreshold) bounce = 0.0f;
+            else m_impacts.push_back({ id, approach });
+            velocity += normal * (approach * (1.0f + bounce));
+        }
+
+        bodies.posX[i] = position.x;
+        bodies.posY[i] = position.y;
+        bodies.posZ[i] = position.z;
+        bodies.velX[i] = velocity.x;
+        bodies.velY[i] = velocity.y;
+        bodies.velZ[i] = velocity.z;
+    }
+}
+
+void Physics::updatePlaneSeparation(RigidBodyStore& bodies, const Plane& plane)
+{
+    PhysicsKernels::PlaneParams params;
+    params.normal = plane.collider.normal;
+    params.distance = glm::dot(plane.position, plane.collider.normal);
+
+    PhysicsKernels::BodyArrays arrays = bodyArrays(bodies);
+    parallelFor(m_jobs, arrays.count, BODY_GRAIN, [&](size_t begin, size_t end) {
+        PhysicsKernels::planeSeparation(m_backend, arrays, begin, end, params);
+    });
+}
+
+void Physics::setBroadphase(BroadphaseType type)
+{
+    if (type == m_broadphase) return;
+
+    //the one being switched away from goes stale, start it from scratch if it ever comes back
+    m_grid.clear();
+    m_tree.clear();
+    m_broadphase = type;
+}
+
+bool Physics::rayTestBody(const RigidBodyStore& bodies, uint32_t index, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, float& t) const
+{
+    glm::vec3 center(bodies.posX[index], bodies.posY[index], bodies.posZ[index]);
+    ShapeType type = bodies.getCollider(bodies.colliderIndex[index]).type;
+
+    if (type == ShapeType::SPHERE) {
+        return Narrowphase::raySphere(origin, dir, center, bodies.radius[index], maxDistance, t);
+    }
+    glm::vec3 half(bodies.halfX[index], bodies.halfY[index], bodies.halfZ[index]);
+    if (type == ShapeType::AABB) {
+        return Narrowphase::rayAABB(origin, dir, center - half, center + half, maxDistance, t);
+    }
+    if (type == ShapeType::OBB) {
+        //into the box frame, the rotation keeps lengths so t comes back as a world distance
+        glm::mat3 toLocal = glm::transpose(bodies.rotationAt(index));
+        return Narrowphase::rayAABB(toLocal * (origin - center), toLocal * dir, -half, half, maxDistance, t);
+    }
+    if (type == ShapeType::CAPSULE) {
+        glm::vec3 axis = bodies.rotationAt(index)[1] * half.y;
+        return Narrowphase::rayCapsule(origin, dir, center - axis, center + axis, bodies.radius[index], maxDistance, t);
+    }
+    if (type == ShapeType::CONVEX_HULL) {
+        glm::mat3 toLocal = glm::transpose(bodies.rotationAt(index));
+        return Narrowphase::rayConvexHull(toLocal * (origin - center), toLocal * dir, bodies.getHull(bodies.colliderIndex[index]),
+                                          maxDistance, t);
+    }
+    return false;
+}
 
-            if (impactVelocity < restThreshold)
-            {
-                orb.velocity = glm::vec3(0.0f);
-                //avoid micro bounces, just set it to 0
+bool Physics::raycast(const RigidBodyStore& bodies, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, RayHit& hit) const
+{
+    hit.body = INVALID_BODY;
+    float closest = maxDistance;
+
+    //the tree is as of the last step, the exact per body test below uses current positions.
+    //before the first step there is no tree yet so that falls back to the scan
+    if (m_broadphase == BroadphaseType::BVH && !m_tree.empty()) {
+        m_tree.raycast(origin, dir, maxDistance, [&](int proxy, float maxT) {
+            BodyId id = m_tree.getBody(proxy);
+            if (!bodies.contains(id)) return maxT;
+
+            float t;
+            if (!rayTestBody(bodies, bodies.indexOf(id), origin, dir, maxT, t)) return maxT;
+
+            hit.body = id;
+            closest = t;
+            return t; //anything further away than this can be skipped now
+        });
+    }
+    else {
+        for (uint32_t i = 0; i < bodies.size(); i++) {
+            float t;
+            if (rayTestBody(bodies, i, origin, dir, closest, t) && t < closest) {
+                hit.body = bodies.idAt(i);
+                closest = t;
             }
-            else
-            {
-                //if impact is significant, like should bounce under regular
+        }
+    }
 
-                float bounceFactor = 0.6f;
-                glm::vec3 normalVelocity = normal * velocityAlongNormal;
-                glm::vec3 bounceVelocity = -normalVelocity * bounceFactor;
-                orb.velocity = orb.velocity - normalVelocity + bounceVelocity;
+    if (hit.body == INVALID_BODY) return false;
 
-                
-                float energyGain = impactVelocity * 0.1f; 
-                orb.energy += energyGain;
-                orb.energy = glm::min(orb.energy, 1.0f);
+    hit.distance = closest;
+    hit.point = origin + dir * closest;
+    return true;
+}
+
+void Physics::queryAABB(const RigidBodyStore& bodies, const AABB& box, std::vector<BodyId>& out) const
+{
+    out.clear();
+
+    if (m_broadphase == BroadphaseType::BVH && !m_tree.empty()) {
+        m_tree.query(box, [&](int proxy) {
+            BodyId id = m_tree.getBody(proxy);
+            if (bodies.contains(id) && box.overlaps(bodyBounds(bodies, bodies.indexOf(id)))) {
+                out.push_back(id);
             }
+            return true;
+        });
+    }
+    else {
+        for (uint32_t i = 0; i < bodies.size(); i++) {
+            if (box.overlaps(bodyBounds(bodies, i))) out.push_back(bodies.idAt(i));
         }
     }
 }
 
-void Physics::solveCubePlaneCollision(Cube& cube, Plane& plane) {
+void Physics::solveCollisions(RigidBodyStore& bodies, const Plane& plane, float deltaTime)
+{
+    //broadphase structures are updated on this thread, the pair search itself is split up
+    if (m_broadphase == BroadphaseType::BVH) {
+        m_tree.update(bodies);
+        m_tree.findPairs(bodies, m_pairs, m_jobs);
+    }
+    else {
+        m_grid.update(bodies);
+        m_grid.findPairs(bodies, m_pairs, m_jobs);
+    }
 
-    //collider data
-    glm::vec3 halfExtents = cube.collider.baseHalfExtents * cube.scale;
-    glm::vec3 normal = plane.collider.normal;
+    //grid pairs come out in hash map order, which is only stable within one build of one std library.
+    //(a, b) is unique per pair so a plain sort already gives one fixed order
+    if (m_deterministic) {
+        std::sort(m_pairs.begin(), m_pairs.end(), [](const BodyPair& x, const BodyPair& y) {
+            return x.a != y.a ? x.a < y.a : x.b < y.b;
+        });
+    }
+
+    //narrowphase, pairs are independent. grouped by shape pair type first so every batch is one test
+    //run start to end, no per pair dispatch
+    batchPairs(bodies);
+    m_rangeContacts.resize(rangeCount(m_batchedPairs.size(), PAIR_GRAIN));
+    for (auto& range : m_rangeContacts) range.clear();
+
+    parallelFor(m_jobs, m_batchedPairs.size(), PAIR_GRAIN, [&](size_t begin, size_t end) {
+        std::vector<Contact>& rangeOut = m_rangeContacts[begin / PAIR_GRAIN];
+        for (int type = 0; type < CollisionDispatch::PAIR_TYPE_COUNT; type++) {
+            size_t first = std::max(begin, m_batchStarts[type]);
+            size_t last = std::min(end, m_batchStarts[type + 1]);
+            CollideFunction collide = CollisionDispatch::get(type);
+            if (first >= last || !collide) continue;
+
+            Contact manifold[MAX_MANIFOLD];
+            for (size_t p = first; p < last; p++) {
+                const BodyPair& pair = m_batchedPairs[p];
+                int count = collide(CollisionDispatch::bodyShape(bodies, bodies.indexOf(pair.a)),
+                                    CollisionDispatch::bodyShape(bodies, bodies.indexOf(pair.b)), manifold);
+                for (int k = 0; k < count; k++) {
+                    manifold[k].a = pair.a;
+                    manifold[k].b = pair.b;
+                }
+                rangeOut.insert(rangeOut.end(), manifold, manifold + count);
+            }
+        }
+    });
+
+    m_contacts.clear();
+    for (const auto& range : m_rangeContacts) {
+        m_contacts.insert(m_contacts.end(), range.begin(), range.end());
+    }
 
-    float planeDist = glm::dot(plane.position, normal);
-    float cubeCenterDist = glm::dot(cube.position, normal);
+    //sleeping bodies something active ran into wake up, along with their whole island. the rest of
+    //that island only joins in (integration, pairs) from the next step
+    wakeTouched(bodies);
 
-    //calculate cube's proj
-    float radius = halfExtents.x * abs(normal.x) + halfExtents.y * abs(normal.y) + halfExtents.z * abs(normal.z);
+    //islands share no dynamic bodies, so each one can be solved on its own thread
+    m_islands.build(bodies, m_contacts);
+    const std::vector<Island>& islands = m_islands.getIslands();
 
-    //height of bottom face of cube(dist bw it and plane)
-    float cubeBottomDist = cubeCenterDist - radius;
+    m_rangeImpacts.resize(rangeCount(islands.size(), ISLAND_GRAIN));
+    for (auto& range : m_rangeImpacts) range.clear();
 
-    if (cubeBottomDist < planeDist) {
+    //after the wake ups above so bodies that just woke get their plane contacts too
+    updatePlaneSeparation(bodies, plane);
 
-        cube.state = EquilibriumState::AWAKE;
-        cube.sleepTimer = 0.0f;
+    m_solver.begin(bodies, m_islands, plane.collider.normal, glm::dot(plane.position, plane.collider.normal), m_planeSeparation);
+    parallelFor(m_jobs, islands.size(), ISLAND_GRAIN, [&](size_t begin, size_t end) {
+        std::vector<ImpactEvent>& rangeOut = m_rangeImpacts[begin / ISLAND_GRAIN];
+        for (size_t k = begin; k < end; k++) {
+            m_solver.solveIsland(bodies, m_contacts, m_islands, static_cast<uint32_t>(k), deltaTime, rangeOut);
+            updateSleep(bodies, islands[k], deltaTime);
+        }
+    });
+    m_solver.end(bodies);
 
-        float penetrationDepth = planeDist - cubeBottomDist;
-        cube.position += normal * penetrationDepth;
+    for (const auto& range : m_rangeImpacts) {
+        m_impacts.insert(m_impacts.end(), range.begin(), range.end());
+    }
+}
 
-        //vel resolution
-        float velocityAlongNormal = glm::dot(cube.velocity, normal);
+void Physics::wakeTouched(RigidBodyStore& bodies)
+{
+    bool wokeAny = false;
+    for (const Contact& contact : m_contacts) {
+        uint32_t ia = bodies.indexOf(contact.a);
+        uint32_t ib = bodies.indexOf(contact.b);
+
+        //the broadphase only hands out pairs with an active side, so at most one of these is asleep
+        if (bodies.state[ia] == EquilibriumState::SLEEPING) {
+            bodies.wake(contact.a);
+            wokeAny = true;
+        }
+        if (bodies.state[ib] == EquilibriumState::SLEEPING) {
+            bodies.wake(contact.b);
+            wokeAny = true;
+        }
+    }
 
-        if (velocityAlongNormal < 0.0f) //object moving into the plane, like in the plane facing dir ig
-        {
-            
-            float bounceFactor = 0.6f;
+    if (wokeAny) wakeIslands(bodies);
+}
 
-            //apply bounce
-            glm::vec3 normalVelocity = normal * velocityAlongNormal;
-            glm::vec3 bounceVelocity = -normalVelocity * bounceFactor;
-            cube.velocity = cube.velocity - normalVelocity + bounceVelocity;
+void Physics::wakeIslands(RigidBodyStore& bodies)
+{
+    //an awake body still tagged with the island it slept in was woken since, wake that whole island
+    m_wakeIslands.clear();
+    const uint32_t count = static_cast<uint32_t>(bodies.size());
+    for (uint32_t i = 0; i < count; i++) {
+        if (bodies.sleepIsland[i] != INVALID_BODY && bodies.state[i] == EquilibriumState::AWAKE) {
+            m_wakeIslands.push_back(bodies.sleepIsland[i]);
         }
     }
-}
\ No newline at end of file
+    if (m_wakeIslands.empty()) return;
+
+    std::sort(m_wakeIslands.begin(), m_wakeIslands.end());
+    m_wakeIslands.erase(std::unique(m_wakeIslands.begin(), m_wakeIslands.end()), m_wakeIslands.end());
+
+    for (uint32_t i = 0; i < count; i++) {
+        BodyId island = bodies.sleepIsland[i];
+        if (island == INVALID_BODY || !std::binary_search(m_wakeIslands.begin(), m_wakeIslands.end(), island)) continue;
+
+        bodies.state[i] = EquilibriumState::AWAKE;
+        bodies.sleepTimer[i] = 0.0f;
+        bodies.sleepIsland[i] = INVALID_BODY;
+    }
+}
+
+void Physics::updateSleep(RigidBodyStore& bodies, const Island& island, float deltaTime) const
+{
+    const uint32_t* members = m_islands.getBodies().data() + island.bodyBegin;
+    const float sleepSpeedSq = m_sleepSpeed * m_sleepSpeed;
+
+    //each body times how long it has been slow, the island can sleep once its most recently
+    //moving body has been slow long enough
+    float slowest = m_timeToSleep;
+    for (uint32_t k = 0; k < island.bodyCount; k++) {
+        uint32_t i = members[k];
+        float speedSq = bodies.velX[i] * bodies.velX[i] + bodies.velY[i] * bodies.velY[i] + bodies.velZ[i] * bodies.velZ[i];
+        float spinSq = bodies.angVelX[i] * bodies.angVelX[i] + bodies.angVelY[i] * bodies.angVelY[i] + bodies.angVelZ[i] * bodies.angVelZ[i];
+
+        //spin is compared in rad/s against the same number, close enough for bodies around a meter big
+        if (speedSq > sleepSpeedSq || spinSq > sleepSpeedSq) bodies.sleepTimer[i] = 0.0f;
+        else bodies.sleepTimer[i] += deltaTime;
+
+        slowest = glm::min(slowest, bodies.sleepTimer[i]);
+    }
+
+    if (!m_sleepingEnabled || slowest < m_timeToSleep) return;
+
+    //the first body's id names the island so a wake on any member can find the others
+    BodyId name = bodies.idAt(members[0]);
+    for (uint32_t k = 0; k < island.bodyCount; k++) {
+        uint32_t i = members[k];
+        bodies.velX[i] = 0.0f;
+        bodies.velY[i] = 0.0f;
+        bodies.velZ[i] = 0.0f;
+        bodies.angVelX[i] = 0.0f;
+        bodies.angVelY[i] = 0.0f;
+        bodies.angVelZ[i] = 0.0f;
+        bodies.state[i] = EquilibriumState::SLEEPING;
+        bodies.sleepIsland[i] = name;
+    }
+}
+
+void Physics::batchPairs(const RigidBodyStore& bodies)
+{
+    //counting sort on the pair type, stable so pairs keep their (sorted) order inside each batch
+    m_pairTypes.resize(m_pairs.size());
+    std::fill(m_batchStarts.begin(), m_batchStarts.end(), 0);
+    for (size_t p = 0; p < m_pairs.size(); p++) {
+        ShapeType typeA = bodies.getCollider(bodies.colliderIndex[bodies.indexOf(m_pairs[p].a)]).type;
+        ShapeType typeB = bodies.getCollider(bodies.colliderIndex[bodies.indexOf(m_pairs[p].b)]).type;
+        m_pairTypes[p] = static_cast<uint8_t>(CollisionDispatch::pairType(typeA, typeB));
+        m_batchStarts[m_pairTypes[p] + 1]++;
+    }
+    for (int type = 0; type < CollisionDispatch::PAIR_TYPE_COUNT; type++) {
+        m_batchStarts[type + 1] += m_batchStarts[type];
+    }
+
+    m_batchedPairs.resize(m_pairs.size());
+    std::array<size_t, CollisionDispatch::PAIR_TYPE_COUNT> next;
+    std::copy(m_batchStarts.begin(), m_batchStarts.end() - 1, next.begin());
+    for (size_t p = 0; p < m_pairs.size(); p++) {
+        m_batchedPairs[next[m_pairTypes[p]]++] = m_pairs[p];
+    }
+}
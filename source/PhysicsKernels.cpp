@@ -0,0 +1,526 @@
+#include "Determinism.h"
+#include "PhysicsKernels.h"
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PHYSICS_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define PHYSICS_KERNELS_X86 0
+#endif
+
+//msvc lets any function use avx2 intrinsics, gcc/clang need the function itself marked
+#if PHYSICS_KERNELS_X86 && (defined(__GNUC__) || defined(__clang__))
+#define PHYSICS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PHYSICS_TARGET_AVX2
+#endif
+
+static_assert(sizeof(EquilibriumState) == sizeof(int32_t), "kernels load the sleep state as 32 bit lanes");
+static_assert(static_cast<int32_t>(EquilibriumState::AWAKE) == 0, "kernels test awake as state == 0");
+
+
+namespace PhysicsKernels
+{
+    //----------------------------------------------------------------------------------------------
+    // scalar, also used for the tails the vector versions leave over. the vector versions do the exact
+    // same operations in the same order (no fma), so every backend rounds identically
+    //----------------------------------------------------------------------------------------------
+
+    static void integrateScalar(const BodyArrays& b, size_t begin, size_t end, float gravity, float dt)
+    {
+        for (size_t i = begin; i < end; i++) {
+            if (b.state[i] != EquilibriumState::AWAKE) continue;
+
+            float invMass = b.inverseMass[i];
+            float gravityAccel = invMass > 0.0f ? gravity : 0.0f;
+
+            b.velX[i] = b.velX[i] + (b.forceX[i] * invMass) * dt;
+            b.velY[i] = b.velY[i] + (b.forceY[i] * invMass + gravityAccel) * dt;
+            b.velZ[i] = b.velZ[i] + (b.forceZ[i] * invMass) * dt;
+
+            b.posX[i] = b.posX[i] + b.velX[i] * dt;
+            b.posY[i] = b.posY[i] + b.velY[i] * dt;
+            b.posZ[i] = b.posZ[i] + b.velZ[i] * dt;
+        }
+    }
+
+    //rotation matrix, world inverse inertia and bounds extents of body i from its orientation, the
+    //same formulas as RigidBodyStore::updateDerived
+    static void updateDerivedScalar(const BodyArrays& b, size_t i)
+    {
+        float w = b.rotW[i], x = b.rotX[i], y = b.rotY[i], z = b.rotZ[i];
+        float r00 = 1.0f - 2.0f * (y * y + z * z), r01 = 2.0f * (x * y - w * z), r02 = 2.0f * (x * z + w * y);
+        float r10 = 2.0f * (x * y + w * z), r11 = 1.0f - 2.0f * (x * x + z * z), r12 = 2.0f * (y * z - w * x);
+        float r20 = 2.0f * (x * z - w * y), r21 = 2.0f * (y * z + w * x), r22 = 1.0f - 2.0f * (x * x + y * y);
+
+        float lx = b.invInertiaX[i], ly = b.invInertiaY[i], lz = b.invInertiaZ[i];
+        b.invInertiaXX[i] = r00 * r00 * lx + r01 * r01 * ly + r02 * r02 * lz;
+        b.invInertiaXY[i] = r00 * r10 * lx + r01 * r11 * ly + r02 * r12 * lz;
+        b.invInertiaXZ[i] = r00 * r20 * lx + r01 * r21 * ly + r02 * r22 * lz;
+        b.invInertiaYY[i] = r10 * r10 * lx + r11 * r11 * ly + r12 * r12 * lz;
+        b.invInertiaYZ[i] = r10 * r20 * lx + r11 * r21 * ly + r12 * r22 * lz;
+        b.invInertiaZZ[i] = r20 * r20 * lx + r21 * r21 * ly + r22 * r22 * lz;
+
+        float hx = b.halfX[i], hy = b.halfY[i], hz = b.halfZ[i];
+        b.extentX[i] = b.radius[i] + (std::fabs(r00) * hx + std::fabs(r01) * hy + std::fabs(r02) * hz);
+        b.extentY[i] = b.radius[i] + (std::fabs(r10) * hx + std::fabs(r11) * hy + std::fabs(r12) * hz);
+        b.extentZ[i] = b.radius[i] + (std::fabs(r20) * hx + std::fabs(r21) * hy + std::fabs(r22) * hz);
+    }
+
+    static void integrateAngularScalar(const BodyArrays& b, size_t begin, size_t end, float dt)
+    {
+        const float halfDt = 0.5f * dt;
+
+        for (size_t i = begin; i < end; i++) {
+            if (b.inverseMass[i] == 0.0f || b.state[i] != EquilibriumState::AWAKE) continue;
+
+            float tx = b.torqueX[i], ty = b.torqueY[i], tz = b.torqueZ[i];
+            float wx = b.angVelX[i] + (b.invInertiaXX[i] * tx + b.invInertiaXY[i] * ty + b.invInertiaXZ[i] * tz) * dt;
+            float wy = b.angVelY[i] + (b.invInertiaXY[i] * tx + b.invInertiaYY[i] * ty + b.invInertiaYZ[i] * tz) * dt;
+            float wz = b.angVelZ[i] + (b.invInertiaXZ[i] * tx + b.invInertiaYZ[i] * ty + b.invInertiaZZ[i] * tz) * dt;
+            b.angVelX[i] = wx;
+            b.angVelY[i] = wy;
+            b.angVelZ[i] = wz;
+
+            //dq/dt = 0.5 (0, w) * q
+            float qw = b.rotW[i], qx = b.rotX[i], qy = b.rotY[i], qz = b.rotZ[i];
+            float dw = 0.0f - (wx * qx + wy * qy + wz * qz);
+            float dx = wx * qw + (wy * qz - wz * qy);
+            float dy = wy * qw + (wz * qx - wx * qz);
+            float dz = wz * qw + (wx * qy - wy * qx);
+            qw = qw + dw * halfDt;
+            qx = qx + dx * halfDt;
+            qy = qy + dy * halfDt;
+            qz = qz + dz * halfDt;
+
+            float inverseLength = 1.0f / std::sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+            b.rotW[i] = qw * inverseLength;
+            b.rotX[i] = qx * inverseLength;
+            b.rotY[i] = qy * inverseLength;
+            b.rotZ[i] = qz * inverseLength;
+
+            updateDerivedScalar(b, i);
+        }
+    }
+
+    static void planeSeparationScalar(const BodyArrays& b, size_t begin, size_t end, const PlaneParams& plane)
+    {
+        const glm::vec3 n = plane.normal;
+        const glm::vec3 absN = glm::abs(n);
+
+        for (size_t i = begin; i < end; i++) {
+            if (b.inverseMass[i] == 0.0f || b.state[i] != EquilibriumState::AWAKE) {
+                b.planeSeparation[i] = NO_SEPARATION;
+                continue;
+            }
+
+            //how far the bounds reach towards the plane from the center
+            float support = b.extentX[i] * absN.x + b.extentY[i] * absN.y + b.extentZ[i] * absN.z;
+            float dist = b.posX[i] * n.x + b.posY[i] * n.y + b.posZ[i] * n.z;
+            b.planeSeparation[i] = (dist - support) - plane.distance;
+        }
+    }
+
+#if PHYSICS_KERNELS_X86
+
+    //----------------------------------------------------------------------------------------------
+    // sse, 4 bodies per iteration. only sse2 so it runs on anything x64
+    //----------------------------------------------------------------------------------------------
+
+    static inline __m128 selectSSE(__m128 mask, __m128 a, __m128 b)
+    {
+        //mask ? a : b
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    static void integrateSSE(const BodyArrays& b, size_t begin, size_t end, float gravity, float dt)
+    {
+        const __m128 vDt = _mm_set1_ps(dt);
+        const __m128 vGravity = _mm_set1_ps(gravity);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m128i stateBits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.state + i));
+            __m128 awake = _mm_castsi128_ps(_mm_cmpeq_epi32(stateBits, _mm_setzero_si128()));
+
+            __m128 invMass = _mm_loadu_ps(b.inverseMass + i);
+            __m128 gravityAccel = _mm_and_ps(_mm_cmpgt_ps(invMass, zero), vGravity);
+
+            __m128 vx = _mm_loadu_ps(b.velX + i);
+            __m128 vy = _mm_loadu_ps(b.velY + i);
+            __m128 vz = _mm_loadu_ps(b.velZ + i);
+            __m128 nvx = _mm_add_ps(vx, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(b.forceX + i), invMass), vDt));
+            __m128 nvy = _mm_add_ps(vy, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b.forceY + i), invMass), gravityAccel), vDt));
+            __m128 nvz = _mm_add_ps(vz, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(b.forceZ + i), invMass), vDt));
+
+            __m128 px = _mm_loadu_ps(b.posX + i);
+            __m128 py = _mm_loadu_ps(b.posY + i);
+            __m128 pz = _mm_loadu_ps(b.posZ + i);
+
+            _mm_storeu_ps(b.velX + i, selectSSE(awake, nvx, vx));
+            _mm_storeu_ps(b.velY + i, selectSSE(awake, nvy, vy));
+            _mm_storeu_ps(b.velZ + i, selectSSE(awake, nvz, vz));
+            _mm_storeu_ps(b.posX + i, selectSSE(awake, _mm_add_ps(px, _mm_mul_ps(nvx, vDt)), px));
+            _mm_storeu_ps(b.posY + i, selectSSE(awake, _mm_add_ps(py, _mm_mul_ps(nvy, vDt)), py));
+            _mm_storeu_ps(b.posZ + i, selectSSE(awake, _mm_add_ps(pz, _mm_mul_ps(nvz, vDt)), pz));
+        }
+
+        integrateScalar(b, i, end, gravity, dt);
+    }
+
+    static void integrateAngularSSE(const BodyArrays& b, size_t begin, size_t end, float dt)
+    {
+        const __m128 vDt = _mm_set1_ps(dt);
+        const __m128 halfDt = _mm_set1_ps(0.5f * dt);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m128i stateBits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.state + i));
+            __m128 awake = _mm_castsi128_ps(_mm_cmpeq_epi32(stateBits, _mm_setzero_si128()));
+            __m128 active = _mm_and_ps(awake, _mm_cmpneq_ps(_mm_loadu_ps(b.inverseMass + i), zero));
+            //a whole group of static or sleeping bodies, nothing to write
+            if (_mm_movemask_ps(active) == 0) continue;
+
+            __m128 ixx = _mm_loadu_ps(b.invInertiaXX + i), ixy = _mm_loadu_ps(b.invInertiaXY + i), ixz = _mm_loadu_ps(b.invInertiaXZ + i);
+            __m128 iyy = _mm_loadu_ps(b.invInertiaYY + i), iyz = _mm_loadu_ps(b.invInertiaYZ + i), izz = _mm_loadu_ps(b.invInertiaZZ + i);
+            __m128 tx = _mm_loadu_ps(b.torqueX + i), ty = _mm_loadu_ps(b.torqueY + i), tz = _mm_loadu_ps(b.torqueZ + i);
+
+            __m128 wx = _mm_add_ps(_mm_loadu_ps(b.angVelX + i), _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ixx, tx), _mm_mul_ps(ixy, ty)), _mm_mul_ps(ixz, tz)), vDt));
+            __m128 wy = _mm_add_ps(_mm_loadu_ps(b.angVelY + i), _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ixy, tx), _mm_mul_ps(iyy, ty)), _mm_mul_ps(iyz, tz)), vDt));
+            __m128 wz = _mm_add_ps(_mm_loadu_ps(b.angVelZ + i), _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ixz, tx), _mm_mul_ps(iyz, ty)), _mm_mul_ps(izz, tz)), vDt));
+
+            __m128 qw = _mm_loadu_ps(b.rotW + i), qx = _mm_loadu_ps(b.rotX + i), qy = _mm_loadu_ps(b.rotY + i), qz = _mm_loadu_ps(b.rotZ + i);
+            __m128 dw = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, qx), _mm_mul_ps(wy, qy)), _mm_mul_ps(wz, qz)));
+            __m128 dx = _mm_add_ps(_mm_mul_ps(wx, qw), _mm_sub_ps(_mm_mul_ps(wy, qz), _mm_mul_ps(wz, qy)));
+            __m128 dy = _mm_add_ps(_mm_mul_ps(wy, qw), _mm_sub_ps(_mm_mul_ps(wz, qx), _mm_mul_ps(wx, qz)));
+            __m128 dz = _mm_add_ps(_mm_mul_ps(wz, qw), _mm_sub_ps(_mm_mul_ps(wx, qy), _mm_mul_ps(wy, qx)));
+            __m128 nw = _mm_add_ps(qw, _mm_mul_ps(dw, halfDt));
+            __m128 nx = _mm_add_ps(qx, _mm_mul_ps(dx, halfDt));
+            __m128 ny = _mm_add_ps(qy, _mm_mul_ps(dy, halfDt));
+            __m128 nz = _mm_add_ps(qz, _mm_mul_ps(dz, halfDt));
+
+            //real sqrt and divide, the reciprocal sqrt estimate would round differently from scalar
+            __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nw, nw), _mm_mul_ps(nx, nx)), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz))));
+            nw = _mm_mul_ps(nw, inverseLength);
+            nx = _mm_mul_ps(nx, inverseLength);
+            ny = _mm_mul_ps(ny, inverseLength);
+            nz = _mm_mul_ps(nz, inverseLength);
+
+            __m128 r00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(ny, ny), _mm_mul_ps(nz, nz))));
+            __m128 r01 = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(nx, ny), _mm_mul_ps(nw, nz)));
+            __m128 r02 = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(nx, nz), _mm_mul_ps(nw, ny)));
+            __m128 r10 = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(nx, ny), _mm_mul_ps(nw, nz)));
+            __m128 r11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz))));
+            __m128 r12 = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(ny, nz), _mm_mul_ps(nw, nx)));
+            __m128 r20 = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(nx, nz), _mm_mul_ps(nw, ny)));
+            __m128 r21 = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(ny, nz), _mm_mul_ps(nw, nx)));
+            __m128 r22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny))));
+
+            __m128 lx = _mm_loadu_ps(b.invInertiaX + i), ly = _mm_loadu_ps(b.invInertiaY + i), lz = _mm_loadu_ps(b.invInertiaZ + i);
+            __m128 nxx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r00, r00), lx), _mm_mul_ps(_mm_mul_ps(r01, r01), ly)), _mm_mul_ps(_mm_mul_ps(r02, r02), lz));
+            __m128 nxy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r00, r10), lx), _mm_mul_ps(_mm_mul_ps(r01, r11), ly)), _mm_mul_ps(_mm_mul_ps(r02, r12), lz));
+            __m128 nxz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r00, r20), lx), _mm_mul_ps(_mm_mul_ps(r01, r21), ly)), _mm_mul_ps(_mm_mul_ps(r02, r22), lz));
+            __m128 nyy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r10, r10), lx), _mm_mul_ps(_mm_mul_ps(r11, r11), ly)), _mm_mul_ps(_mm_mul_ps(r12, r12), lz));
+            __m128 nyz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r10, r20), lx), _mm_mul_ps(_mm_mul_ps(r11, r21), ly)), _mm_mul_ps(_mm_mul_ps(r12, r22), lz));
+            __m128 nzz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(r20, r20), lx), _mm_mul_ps(_mm_mul_ps(r21, r21), ly)), _mm_mul_ps(_mm_mul_ps(r22, r22), lz));
+
+            __m128 radius = _mm_loadu_ps(b.radius + i);
+            __m128 hx = _mm_loadu_ps(b.halfX + i), hy = _mm_loadu_ps(b.halfY + i), hz = _mm_loadu_ps(b.halfZ + i);
+            __m128 ex = _mm_add_ps(radius, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, r00), hx), _mm_mul_ps(_mm_andnot_ps(signBit, r01), hy)), _mm_mul_ps(_mm_andnot_ps(signBit, r02), hz)));
+            __m128 ey = _mm_add_ps(radius, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, r10), hx), _mm_mul_ps(_mm_andnot_ps(signBit, r11), hy)), _mm_mul_ps(_mm_andnot_ps(signBit, r12), hz)));
+            __m128 ez = _mm_add_ps(radius, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, r20), hx), _mm_mul_ps(_mm_andnot_ps(signBit, r21), hy)), _mm_mul_ps(_mm_andnot_ps(signBit, r22), hz)));
+
+            _mm_storeu_ps(b.angVelX + i, selectSSE(active, wx, _mm_loadu_ps(b.angVelX + i)));
+            _mm_storeu_ps(b.angVelY + i, selectSSE(active, wy, _mm_loadu_ps(b.angVelY + i)));
+            _mm_storeu_ps(b.angVelZ + i, selectSSE(active, wz, _mm_loadu_ps(b.angVelZ + i)));
+            _mm_storeu_ps(b.rotW + i, selectSSE(active, nw, qw));
+            _mm_storeu_ps(b.rotX + i, selectSSE(active, nx, qx));
+            _mm_storeu_ps(b.rotY + i, selectSSE(active, ny, qy));
+            _mm_storeu_ps(b.rotZ + i, selectSSE(active, nz, qz));
+            _mm_storeu_ps(b.invInertiaXX + i, selectSSE(active, nxx, ixx));
+            _mm_storeu_ps(b.invInertiaXY + i, selectSSE(active, nxy, ixy));
+            _mm_storeu_ps(b.invInertiaXZ + i, selectSSE(active, nxz, ixz));
+            _mm_storeu_ps(b.invInertiaYY + i, selectSSE(active, nyy, iyy));
+            _mm_storeu_ps(b.invInertiaYZ + i, selectSSE(active, nyz, iyz));
+            _mm_storeu_ps(b.invInertiaZZ + i, selectSSE(active, nzz, izz));
+            _mm_storeu_ps(b.extentX + i, selectSSE(active, ex, _mm_loadu_ps(b.extentX + i)));
+            _mm_storeu_ps(b.extentY + i, selectSSE(active, ey, _mm_loadu_ps(b.extentY + i)));
+            _mm_storeu_ps(b.extentZ + i, selectSSE(active, ez, _mm_loadu_ps(b.extentZ + i)));
+        }
+
+        integrateAngularScalar(b, i, end, dt);
+    }
+
+    static void planeSeparationSSE(const BodyArrays& b, size_t begin, size_t end, const PlaneParams& plane)
+    {
+        const __m128 nx = _mm_set1_ps(plane.normal.x);
+        const __m128 ny = _mm_set1_ps(plane.normal.y);
+        const __m128 nz = _mm_set1_ps(plane.normal.z);
+        const __m128 anx = _mm_set1_ps(glm::abs(plane.normal.x));
+        const __m128 any = _mm_set1_ps(glm::abs(plane.normal.y));
+        const __m128 anz = _mm_set1_ps(glm::abs(plane.normal.z));
+        const __m128 planeDist = _mm_set1_ps(plane.distance);
+        const __m128 none = _mm_set1_ps(NO_SEPARATION);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m128 support = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b.extentX + i), anx), _mm_mul_ps(_mm_loadu_ps(b.extentY + i), any)), _mm_mul_ps(_mm_loadu_ps(b.extentZ + i), anz));
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b.posX + i), nx), _mm_mul_ps(_mm_loadu_ps(b.posY + i), ny)), _mm_mul_ps(_mm_loadu_ps(b.posZ + i), nz));
+            __m128 separation = _mm_sub_ps(_mm_sub_ps(dist, support), planeDist);
+
+            //sleeping bodies sit exactly where they fell asleep, only awake dynamic ones can touch
+            __m128i stateBits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.state + i));
+            __m128 awake = _mm_castsi128_ps(_mm_cmpeq_epi32(stateBits, _mm_setzero_si128()));
+            __m128 dynamic = _mm_and_ps(awake, _mm_cmpneq_ps(_mm_loadu_ps(b.inverseMass + i), zero));
+            _mm_storeu_ps(b.planeSeparation + i, selectSSE(dynamic, separation, none));
+        }
+
+        planeSeparationScalar(b, i, end, plane);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // avx2, 8 bodies per iteration, same steps as the sse version
+    //----------------------------------------------------------------------------------------------
+
+    PHYSICS_TARGET_AVX2
+    static void integrateAVX2(const BodyArrays& b, size_t begin, size_t end, float gravity, float dt)
+    {
+        const __m256 vDt = _mm256_set1_ps(dt);
+        const __m256 vGravity = _mm256_set1_ps(gravity);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256i stateBits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.state + i));
+            __m256 awake = _mm256_castsi256_ps(_mm256_cmpeq_epi32(stateBits, _mm256_setzero_si256()));
+
+            __m256 invMass = _mm256_loadu_ps(b.inverseMass + i);
+            __m256 gravityAccel = _mm256_and_ps(_mm256_cmp_ps(invMass, zero, _CMP_GT_OQ), vGravity);
+
+            __m256 vx = _mm256_loadu_ps(b.velX + i);
+            __m256 vy = _mm256_loadu_ps(b.velY + i);
+            __m256 vz = _mm256_loadu_ps(b.velZ + i);
+            __m256 nvx = _mm256_add_ps(vx, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(b.forceX + i), invMass), vDt));
+            __m256 nvy = _mm256_add_ps(vy, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b.forceY + i), invMass), gravityAccel), vDt));
+            __m256 nvz = _mm256_add_ps(vz, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(b.forceZ + i), invMass), vDt));
+
+            __m256 px = _mm256_loadu_ps(b.posX + i);
+            __m256 py = _mm256_loadu_ps(b.posY + i);
+            __m256 pz = _mm256_loadu_ps(b.posZ + i);
+
+            _mm256_storeu_ps(b.velX + i, _mm256_blendv_ps(vx, nvx, awake));
+            _mm256_storeu_ps(b.velY + i, _mm256_blendv_ps(vy, nvy, awake));
+            _mm256_storeu_ps(b.velZ + i, _mm256_blendv_ps(vz, nvz, awake));
+            _mm256_storeu_ps(b.posX + i, _mm256_blendv_ps(px, _mm256_add_ps(px, _mm256_mul_ps(nvx, vDt)), awake));
+            _mm256_storeu_ps(b.posY + i, _mm256_blendv_ps(py, _mm256_add_ps(py, _mm256_mul_ps(nvy, vDt)), awake));
+            _mm256_storeu_ps(b.posZ + i, _mm256_blendv_ps(pz, _mm256_add_ps(pz, _mm256_mul_ps(nvz, vDt)), awake));
+        }
+
+        integrateScalar(b, i, end, gravity, dt);
+    }
+
+    PHYSICS_TARGET_AVX2
+    static void integrateAngularAVX2(const BodyArrays& b, size_t begin, size_t end, float dt)
+    {
+        const __m256 vDt = _mm256_set1_ps(dt);
+        const __m256 halfDt = _mm256_set1_ps(0.5f * dt);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256i stateBits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.state + i));
+            __m256 awake = _mm256_castsi256_ps(_mm256_cmpeq_epi32(stateBits, _mm256_setzero_si256()));
+            __m256 active = _mm256_and_ps(awake, _mm256_cmp_ps(_mm256_loadu_ps(b.inverseMass + i), zero, _CMP_NEQ_UQ));
+            //a whole group of static or sleeping bodies, nothing to write
+            if (_mm256_movemask_ps(active) == 0) continue;
+
+            __m256 ixx = _mm256_loadu_ps(b.invInertiaXX + i), ixy = _mm256_loadu_ps(b.invInertiaXY + i), ixz = _mm256_loadu_ps(b.invInertiaXZ + i);
+            __m256 iyy = _mm256_loadu_ps(b.invInertiaYY + i), iyz = _mm256_loadu_ps(b.invInertiaYZ + i), izz = _mm256_loadu_ps(b.invInertiaZZ + i);
+            __m256 tx = _mm256_loadu_ps(b.torqueX + i), ty = _mm256_loadu_ps(b.torqueY + i), tz = _mm256_loadu_ps(b.torqueZ + i);
+
+            __m256 wx = _mm256_add_ps(_mm256_loadu_ps(b.angVelX + i), _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ixx, tx), _mm256_mul_ps(ixy, ty)), _mm256_mul_ps(ixz, tz)), vDt));
+            __m256 wy = _mm256_add_ps(_mm256_loadu_ps(b.angVelY + i), _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ixy, tx), _mm256_mul_ps(iyy, ty)), _mm256_mul_ps(iyz, tz)), vDt));
+            __m256 wz = _mm256_add_ps(_mm256_loadu_ps(b.angVelZ + i), _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ixz, tx), _mm256_mul_ps(iyz, ty)), _mm256_mul_ps(izz, tz)), vDt));
+
+            __m256 qw = _mm256_loadu_ps(b.rotW + i), qx = _mm256_loadu_ps(b.rotX + i), qy = _mm256_loadu_ps(b.rotY + i), qz = _mm256_loadu_ps(b.rotZ + i);
+            __m256 dw = _mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(wx, qx), _mm256_mul_ps(wy, qy)), _mm256_mul_ps(wz, qz)));
+            __m256 dx = _mm256_add_ps(_mm256_mul_ps(wx, qw), _mm256_sub_ps(_mm256_mul_ps(wy, qz), _mm256_mul_ps(wz, qy)));
+            __m256 dy = _mm256_add_ps(_mm256_mul_ps(wy, qw), _mm256_sub_ps(_mm256_mul_ps(wz, qx), _mm256_mul_ps(wx, qz)));
+            __m256 dz = _mm256_add_ps(_mm256_mul_ps(wz, qw), _mm256_sub_ps(_mm256_mul_ps(wx, qy), _mm256_mul_ps(wy, qx)));
+            __m256 nw = _mm256_add_ps(qw, _mm256_mul_ps(dw, halfDt));
+            __m256 nx = _mm256_add_ps(qx, _mm256_mul_ps(dx, halfDt));
+            __m256 ny = _mm256_add_ps(qy, _mm256_mul_ps(dy, halfDt));
+            __m256 nz = _mm256_add_ps(qz, _mm256_mul_ps(dz, halfDt));
+
+            //real sqrt and divide, the reciprocal sqrt estimate would round differently from scalar
+            __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nw, nw), _mm256_mul_ps(nx, nx)), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz))));
+            nw = _mm256_mul_ps(nw, inverseLength);
+            nx = _mm256_mul_ps(nx, inverseLength);
+            ny = _mm256_mul_ps(ny, inverseLength);
+            nz = _mm256_mul_ps(nz, inverseLength);
+
+            __m256 r00 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(ny, ny), _mm256_mul_ps(nz, nz))));
+            __m256 r01 = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(nx, ny), _mm256_mul_ps(nw, nz)));
+            __m256 r02 = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(nx, nz), _mm256_mul_ps(nw, ny)));
+            __m256 r10 = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(nx, ny), _mm256_mul_ps(nw, nz)));
+            __m256 r11 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(nz, nz))));
+            __m256 r12 = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(ny, nz), _mm256_mul_ps(nw, nx)));
+            __m256 r20 = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(nx, nz), _mm256_mul_ps(nw, ny)));
+            __m256 r21 = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(ny, nz), _mm256_mul_ps(nw, nx)));
+            __m256 r22 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny))));
+
+            __m256 lx = _mm256_loadu_ps(b.invInertiaX + i), ly = _mm256_loadu_ps(b.invInertiaY + i), lz = _mm256_loadu_ps(b.invInertiaZ + i);
+            __m256 nxx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r00, r00), lx), _mm256_mul_ps(_mm256_mul_ps(r01, r01), ly)), _mm256_mul_ps(_mm256_mul_ps(r02, r02), lz));
+            __m256 nxy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r00, r10), lx), _mm256_mul_ps(_mm256_mul_ps(r01, r11), ly)), _mm256_mul_ps(_mm256_mul_ps(r02, r12), lz));
+            __m256 nxz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r00, r20), lx), _mm256_mul_ps(_mm256_mul_ps(r01, r21), ly)), _mm256_mul_ps(_mm256_mul_ps(r02, r22), lz));
+            __m256 nyy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r10, r10), lx), _mm256_mul_ps(_mm256_mul_ps(r11, r11), ly)), _mm256_mul_ps(_mm256_mul_ps(r12, r12), lz));
+            __m256 nyz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r10, r20), lx), _mm256_mul_ps(_mm256_mul_ps(r11, r21), ly)), _mm256_mul_ps(_mm256_mul_ps(r12, r22), lz));
+            __m256 nzz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r20, r20), lx), _mm256_mul_ps(_mm256_mul_ps(r21, r21), ly)), _mm256_mul_ps(_mm256_mul_ps(r22, r22), lz));
+
+            __m256 radius = _mm256_loadu_ps(b.radius + i);
+            __m256 hx = _mm256_loadu_ps(b.halfX + i), hy = _mm256_loadu_ps(b.halfY + i), hz = _mm256_loadu_ps(b.halfZ + i);
+            __m256 ex = _mm256_add_ps(radius, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signBit, r00), hx), _mm256_mul_ps(_mm256_andnot_ps(signBit, r01), hy)), _mm256_mul_ps(_mm256_andnot_ps(signBit, r02), hz)));
+            __m256 ey = _mm256_add_ps(radius, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signBit, r10), hx), _mm256_mul_ps(_mm256_andnot_ps(signBit, r11), hy)), _mm256_mul_ps(_mm256_andnot_ps(signBit, r12), hz)));
+            __m256 ez = _mm256_add_ps(radius, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signBit, r20), hx), _mm256_mul_ps(_mm256_andnot_ps(signBit, r21), hy)), _mm256_mul_ps(_mm256_andnot_ps(signBit, r22), hz)));
+
+            _mm256_storeu_ps(b.angVelX + i, _mm256_blendv_ps(_mm256_loadu_ps(b.angVelX + i), wx, active));
+            _mm256_storeu_ps(b.angVelY + i, _mm256_blendv_ps(_mm256_loadu_ps(b.angVelY + i), wy, active));
+            _mm256_storeu_ps(b.angVelZ + i, _mm256_blendv_ps(_mm256_loadu_ps(b.angVelZ + i), wz, active));
+            _mm256_storeu_ps(b.rotW + i, _mm256_blendv_ps(qw, nw, active));
+            _mm256_storeu_ps(b.rotX + i, _mm256_blendv_ps(qx, nx, active));
+            _mm256_storeu_ps(b.rotY + i, _mm256_blendv_ps(qy, ny, active));
+            _mm256_storeu_ps(b.rotZ + i, _mm256_blendv_ps(qz, nz, active));
+            _mm256_storeu_ps(b.invInertiaXX + i, _mm256_blendv_ps(ixx, nxx, active));
+            _mm256_storeu_ps(b.invInertiaXY + i, _mm256_blendv_ps(ixy, nxy, active));
+            _mm256_storeu_ps(b.invInertiaXZ + i, _mm256_blendv_ps(ixz, nxz, active));
+            _mm256_storeu_ps(b.invInertiaYY + i, _mm256_blendv_ps(iyy, nyy, active));
+            _mm256_storeu_ps(b.invInertiaYZ + i, _mm256_blendv_ps(iyz, nyz, active));
+            _mm256_storeu_ps(b.invInertiaZZ + i, _mm256_blendv_ps(izz, nzz, active));
+            _mm256_storeu_ps(b.extentX + i, _mm256_blendv_ps(_mm256_loadu_ps(b.extentX + i), ex, active));
+            _mm256_storeu_ps(b.extentY + i, _mm256_blendv_ps(_mm256_loadu_ps(b.extentY + i), ey, active));
+            _mm256_storeu_ps(b.extentZ + i, _mm256_blendv_ps(_mm256_loadu_ps(b.extentZ + i), ez, active));
+        }
+
+        integrateAngularScalar(b, i, end, dt);
+    }
+
+    PHYSICS_TARGET_AVX2
+    static void planeSeparationAVX2(const BodyArrays& b, size_t begin, size_t end, const PlaneParams& plane)
+    {
+        const __m256 nx = _mm256_set1_ps(plane.normal.x);
+        const __m256 ny = _mm256_set1_ps(plane.normal.y);
+        const __m256 nz = _mm256_set1_ps(plane.normal.z);
+        const __m256 anx = _mm256_set1_ps(glm::abs(plane.normal.x));
+        const __m256 any = _mm256_set1_ps(glm::abs(plane.normal.y));
+        const __m256 anz = _mm256_set1_ps(glm::abs(plane.normal.z));
+        const __m256 planeDist = _mm256_set1_ps(plane.distance);
+        const __m256 none = _mm256_set1_ps(NO_SEPARATION);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256 support = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b.extentX + i), anx), _mm256_mul_ps(_mm256_loadu_ps(b.extentY + i), any)), _mm256_mul_ps(_mm256_loadu_ps(b.extentZ + i), anz));
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b.posX + i), nx), _mm256_mul_ps(_mm256_loadu_ps(b.posY + i), ny)), _mm256_mul_ps(_mm256_loadu_ps(b.posZ + i), nz));
+            __m256 separation = _mm256_sub_ps(_mm256_sub_ps(dist, support), planeDist);
+
+            //sleeping bodies sit exactly where they fell asleep, only awake dynamic ones can touch
+            __m256i stateBits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.state + i));
+            __m256 awake = _mm256_castsi256_ps(_mm256_cmpeq_epi32(stateBits, _mm256_setzero_si256()));
+            __m256 dynamic = _mm256_and_ps(awake, _mm256_cmp_ps(_mm256_loadu_ps(b.inverseMass + i), zero, _CMP_NEQ_UQ));
+            _mm256_storeu_ps(b.planeSeparation + i, _mm256_blendv_ps(none, separation, dynamic));
+        }
+
+        planeSeparationScalar(b, i, end, plane);
+    }
+
+    static bool cpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        //avx needs the os to save the ymm registers too, not just the cpu supporting it
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#endif // PHYSICS_KERNELS_X86
+
+
+    Backend detectBackend()
+    {
+#if PHYSICS_KERNELS_X86
+        static const Backend detected = cpuHasAVX2() ? Backend::AVX2 : Backend::SSE;
+        return detected;
+#else
+        return Backend::SCALAR;
+#endif
+    }
+
+    const char* backendName(Backend backend)
+    {
+        switch (backend) {
+        case Backend::SSE: return "sse";
+        case Backend::AVX2: return "avx2";
+        default: return "scalar";
+        }
+    }
+
+    void integrate(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, float gravity, float deltaTime)
+    {
+        switch (backend) {
+#if PHYSICS_KERNELS_X86
+        case Backend::AVX2: integrateAVX2(bodies, begin, end, gravity, deltaTime); break;
+        case Backend::SSE: integrateSSE(bodies, begin, end, gravity, deltaTime); break;
+#endif
+        default: integrateScalar(bodies, begin, end, gravity, deltaTime); break;
+        }
+    }
+
+    void integrateAngular(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, float deltaTime)
+    {
+        switch (backend) {
+#if PHYSICS_KERNELS_X86
+        case Backend::AVX2: integrateAngularAVX2(bodies, begin, end, deltaTime); break;
+        case Backend::SSE: integrateAngularSSE(bodies, begin, end, deltaTime); break;
+#endif
+        default: integrateAngularScalar(bodies, begin, end, deltaTime); break;
+        }
+    }
+
+    void planeSeparation(Backend backend, const BodyArrays& bodies, size_t begin, size_t end, const PlaneParams& plane)
+    {
+        switch (backend) {
+#if PHYSICS_KERNELS_X86
+        case Backend::AVX2: planeSeparationAVX2(bodies, begin, end, plane); break;
+        case Backend::SSE: planeSeparationSSE(bodies, begin, end, plane); break;
+#endif
+        default: planeSeparationScalar(bodies, begin, end, plane); break;
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#include "Registry.h"
+#include <iostream>
+#include <mutex>
+
+
+namespace {
+    size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+    //component types are process wide, the same type has the same id in every registry
+    std::mutex& typeMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::vector<ComponentInfo>& typeTable()
+    {
+        static std::vector<ComponentInfo> table = [] {
+            std::vector<ComponentInfo> reserved;
+            reserved.reserve(MAX_COMPONENT_TYPES); //info() hands out references, the table must never move
+            return reserved;
+        }();
+        return table;
+    }
+}
+
+
+uint32_t ComponentTypes::registerType(const ComponentInfo& info)
+{
+    assert(info.alignment <= CHUNK_ALIGNMENT);
+
+    std::lock_guard<std::mutex> lock(typeMutex());
+    std::vector<ComponentInfo>& table = typeTable();
+    assert(table.size() < MAX_COMPONENT_TYPES);
+    table.push_back(info);
+    return static_cast<uint32_t>(table.size() - 1);
+}
+
+const ComponentInfo& ComponentTypes::info(uint32_t id)
+{
+    return typeTable()[id];
+}
+
+
+Archetype::Archetype(ComponentMask mask)
+    : m_mask(mask)
+{
+    size_t rowBytes = sizeof(Entity);
+    for (uint32_t id = 0; id < MAX_COMPONENT_TYPES; id++) {
+        if (!has(id)) continue;
+        m_components.push_back(id);
+        rowBytes += ComponentTypes::info(id).size;
+    }
+
+    //as many rows as fit once every column is padded out to a cache line
+    auto layout = [this](uint32_t capacity) {
+        size_t offset = sizeof(Entity) * capacity;
+        for (uint32_t id : m_components) {
+            offset = alignUp(offset, CHUNK_ALIGNMENT);
+            m_offsets[id] = static_cast<uint32_t>(offset);
+            offset += ComponentTypes::info(id).size * capacity;
+        }
+        return offset;
+    };
+
+    m_capacity = static_cast<uint32_t>(CHUNK_BYTES / rowBytes);
+    while (m_capacity > 1 && layout(m_capacity) > CHUNK_BYTES) m_capacity--;
+    assert(m_capacity >= 1 && layout(m_capacity) <= CHUNK_BYTES);
+}
+
+Archetype::~Archetype()
+{
+    for (uint32_t row = 0; row < m_count; row++) {
+        for (uint32_t id : m_components) ComponentTypes::info(id).destroy(at(row, id));
+    }
+    for (std::byte* chunk : m_chunks) {
+        ::operator delete(chunk, std::align_val_t(CHUNK_ALIGNMENT));
+    }
+}
+
+uint32_t Archetype::addRow(Entity entity)
+{
+    if (m_count == m_chunks.size() * m_capacity) {
+        m_chunks.push_back(static_cast<std::byte*>(::operator new(CHUNK_BYTES, std::align_val_t(CHUNK_ALIGNMENT))));
+    }
+
+    uint32_t row = static_cast<uint32_t>(m_count++);
+    entities(row / m_capacity)[row % m_capacity] = entity;
+    return row;
+}
+
+Entity Archetype::removeRow(uint32_t row)
+{
+    uint32_t last = static_cast<uint32_t>(m_count - 1);
+    Entity moved = NULL_ENTITY;
+    if (row != last) {
+        for (uint32_t id : m_components) ComponentTypes::info(id).relocate(at(row, id), at(last, id));
+        moved = entityAt(last);
+        entities(row / m_capacity)[row % m_capacity] = moved;
+    }
+
+    m_count--;
+    //an emptied chunk goes straight back, so an archetype that shrank does not keep its peak size
+    if (m_count == (m_chunks.size() - 1) * m_capacity) {
+        ::operator delete(m_chunks.back(), std::align_val_t(CHUNK_ALIGNMENT));
+        m_chunks.pop_back();
+    }
+    return moved;
+}
+
+
+Registry::Registry()
+{
+    findOrCreateArchetype(0);
+}
+
+Entity Registry::create()
+{
+    assert(m_iterating == 0);
+
+    uint32_t index;
+    if (!m_freeSlots.empty()) {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(m_records.size());
+        //one more would spill into the generation bits and alias another entity's handle
+        if (index >= MAX_ENTITIES) {
+            std::cerr << "ERROR::REGISTRY: out of entity slots (" << MAX_ENTITIES << " alive)" << std::endl;
+            return NULL_ENTITY;
+        }
+        m_records.emplace_back();
+    }
+
+    EntityRecord& record = m_records[index];
+    Entity entity = makeEntity(index, record.generation);
+    record.archetype = 0;
+    record.row = m_archetypes[0]->addRow(entity);
+    return entity;
+}
+
+void Registry::destroy(Entity entity)
+{
+    assert(m_iterating == 0);
+    if (!valid(entity)) return;
+
+    EntityRecord& record = m_records[entityIndex(entity)];
+    Archetype& archetype = *m_archetypes[record.archetype];
+    for (uint32_t id : archetype.components()) ComponentTypes::info(id).destroy(archetype.at(record.row, id));
+
+    Entity moved = archetype.removeRow(record.row);
+    if (moved != NULL_ENTITY) m_records[entityIndex(moved)].row = record.row;
+
+    //bumping the generation is what kills every outstanding copy of the handle
+    record.generation = (record.generation + 1) & ENTITY_GENERATION_MASK;
+    record.archetype = NO_ARCHETYPE;
+    m_freeSlots.push_back(entityIndex(entity));
+}
+
+const std::vector<Archetype*>& Registry::query(ComponentMask mask)
+{
+    std::lock_guard<std::mutex> lock(m_queryMutex);
+    QueryCache& cache = m_queries[mask];
+
+    //archetypes are never removed, so only the ones made since last time can be new matches
+    for (; cache.archetypesSeen < m_archetypes.size(); cache.archetypesSeen++) {
+        Archetype* archetype = m_archetypes[cache.archetypesSeen].get();
+        if ((archetype->mask() & mask) == mask) cache.archetypes.push_back(archetype);
+    }
+    return cache.archetypes;
+}
+
+uint32_t Registry::findOrCreateArchetype(ComponentMask mask)
+{
+    auto it = m_archetypeOf.find(mask);
+    if (it != m_archetypeOf.end()) return it->second;
+
+    uint32_t index = static_cast<uint32_t>(m_archetypes.size());
+    m_archetypes.push_back(std::make_unique<Archetype>(mask));
+    m_archetypeOf.emplace(mask, index);
+    return index;
+}
+
+void Registry::moveEntity(Entity entity, uint32_t target)
+{
+    assert(m_iterating == 0);
+
+    EntityRecord& record = m_records[entityIndex(entity)];
+    Archetype& from = *m_archetypes[record.archetype];
+    Archetype& to = *m_archetypes[target];
+
+    uint32_t row = to.addRow(entity);
+    for (uint32_t id : from.components()) {
+        void* component = from.at(record.row, id);
+        if (to.has(id)) ComponentTypes::info(id).relocate(to.at(row, id), component);
+        else ComponentTypes::info(id).destroy(component);
+    }
+
+    Entity moved = from.removeRow(record.row);
+    if (moved != NULL_ENTITY) m_records[entityIndex(moved)].row = record.row;
+
+    record.archetype = target;
+    record.row = row;
+}
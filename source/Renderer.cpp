@@ -14,6 +14,33 @@ void Renderer::beginFrame(const Camera& camera, int screenWidth, int screenHeigh
     m_projection = glm::perspective(glm::radians(camera.Zoom), aspectRatio, 0.1f, 100.0f);
     m_view = camera.GetViewMatrix();
     m_viewPos = camera.Position;
+    m_camera = &camera;
+    m_viewportHeight = screenHeight;
+}
+
+void Renderer::extract(Registry& registry, std::vector<DrawItem>& out)
+{
+    out.clear();
+    registry.each<Renderable, Transform>([&](Entity entity, Renderable& renderable, Transform& transform) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+        model = model * glm::mat4_cast(transform.rotation);
+        model = glm::scale(model, transform.scale);
+
+        const GlowingOrb* glowing = registry.tryGet<GlowingOrb>(entity);
+        out.push_back({ renderable.mesh, renderable.shader, model, renderable.color, glowing ? glowing->energy : 0.0f, glowing != nullptr });
+    });
+}
+
+void Renderer::submit(const std::vector<DrawItem>& items)
+{
+    for (const DrawItem& item : items) {
+        draw(item.mesh, item.shader, item.model,
+            [&](Shader& shader) {
+                if (item.glows) shader.setFloat("energy", item.energy);
+                else shader.setVec3("objectColor", item.color);
+            }
+        );
+    }
 }
 
 void Renderer::endFrame()
@@ -0,0 +1,384 @@
+#include "Determinism.h"
+#include "RigidBodyStore.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+namespace {
+    //moves element "from" into "to" and drops the tail, same thing for every per body array
+    template<typename T>
+    void swapRemove(std::vector<T>& array, uint32_t to, uint32_t from)
+    {
+        array[to] = array[from];
+        array.pop_back();
+    }
+}
+
+
+uint32_t RigidBodyStore::addCollider(const Collider& collider)
+{
+    m_colliders.push_back(collider);
+    m_hulls.push_back(collider.type == ShapeType::CONVEX_HULL ? buildConvexHull(collider.hullVertices) : ConvexHull());
+    return static_cast<uint32_t>(m_colliders.size() - 1);
+}
+
+BodyId RigidBodyStore::add(const BodyDesc& desc)
+{
+    assert(desc.collider < m_colliders.size());
+    //planes are world geometry handed to Physics::update, not something with a position and bounds
+    assert(m_colliders[desc.collider].type != ShapeType::PLANE);
+
+    BodyId id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else {
+        id = static_cast<BodyId>(m_indexOf.size());
+        m_indexOf.push_back(INVALID_BODY);
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_ids.size());
+    m_indexOf[id] = index;
+    m_ids.push_back(id);
+
+    //everything starts at 0, the parts that dont are filled in below
+    forEachFloatArray([](std::vector<float>& array) { array.push_back(0.0f); });
+    colliderIndex.push_back(desc.collider);
+    state.push_back(EquilibriumState::AWAKE);
+    sleepIsland.push_back(INVALID_BODY);
+
+    posX[index] = prevX[index] = desc.position.x;
+    posY[index] = prevY[index] = desc.position.y;
+    posZ[index] = prevZ[index] = desc.position.z;
+    velX[index] = desc.velocity.x;
+    velY[index] = desc.velocity.y;
+    velZ[index] = desc.velocity.z;
+    float invMass = desc.mass > 0.0f ? 1.0f / desc.mass : 0.0f;
+    inverseMass[index] = invMass;
+
+    const Collider& collider = m_colliders[desc.collider];
+    bool rotates = collider.type != ShapeType::AABB;
+    glm::quat orientation = rotates ? glm::normalize(desc.orientation) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    rotW[index] = prevRotW[index] = orientation.w;
+    rotX[index] = prevRotX[index] = orientation.x;
+    rotY[index] = prevRotY[index] = orientation.y;
+    rotZ[index] = prevRotZ[index] = orientation.z;
+
+    if (collider.type == ShapeType::SPHERE) {
+        radius[index] = collider.radius;
+        //solid sphere, I = 2/5 m r^2 on every axis
+        float inertia = invMass * 2.5f / (collider.radius * collider.radius);
+        invInertiaX[index] = invInertiaY[index] = invInertiaZ[index] = inertia;
+    }
+    else if (collider.type == ShapeType::AABB || collider.type == ShapeType::OBB) {
+        glm::vec3 h = collider.baseHalfExtents;
+        halfX[index] = h.x;
+        halfY[index] = h.y;
+        halfZ[index] = h.z;
+        if (collider.type == ShapeType::OBB) {
+            //solid box, I = m/3 (hy^2 + hz^2) around x with half extents, same pattern on the others
+            invInertiaX[index] = invMass * 3.0f / (h.y * h.y + h.z * h.z);
+            invInertiaY[index] = invMass * 3.0f / (h.x * h.x + h.z * h.z);
+            invInertiaZ[index] = invMass * 3.0f / (h.x * h.x + h.y * h.y);
+        }
+    }
+    else if (collider.type == ShapeType::CAPSULE) {
+        float r = collider.radius;
+        float h = collider.halfHeight;
+        radius[index] = r;
+        halfY[index] = h;
+        if (invMass > 0.0f) {
+            //cylinder plus two half spheres, mass split by volume. around the long axis they add up like
+            //a cylinder and a sphere, across it the half spheres also sit h (and 3r/8 more) off center
+            float cylinderVolume = 2.0f * h * r * r;
+            float sphereVolume = 4.0f / 3.0f * r * r * r;
+            float cylinderMass = desc.mass * cylinderVolume / (cylinderVolume + sphereVolume);
+            float sphereMass = desc.mass - cylinderMass;
+            float along = cylinderMass * r * r * 0.5f + sphereMass * r * r * 0.4f;
+            float across = cylinderMass * (r * r * 0.25f + h * h / 3.0f) + sphereMass * (r * r * 0.4f + h * h + 0.75f * h * r);
+            invInertiaX[index] = invInertiaZ[index] = 1.0f / across;
+            invInertiaY[index] = 1.0f / along;
+        }
+    }
+    else if (collider.type == ShapeType::CONVEX_HULL) {
+        glm::vec3 h = m_hulls[desc.collider].halfExtents;
+        halfX[index] = h.x;
+        halfY[index] = h.y;
+        halfZ[index] = h.z;
+        //the box around it, close enough for the rocks and crates hulls get used for
+        invInertiaX[index] = invMass * 3.0f / (h.y * h.y + h.z * h.z);
+        invInertiaY[index] = invMass * 3.0f / (h.x * h.x + h.z * h.z);
+        invInertiaZ[index] = invMass * 3.0f / (h.x * h.x + h.y * h.y);
+    }
+
+    //a body that can not turn ignores any spin it was given
+    if (invInertiaX[index] > 0.0f) {
+        angVelX[index] = desc.angularVelocity.x;
+        angVelY[index] = desc.angularVelocity.y;
+        angVelZ[index] = desc.angularVelocity.z;
+    }
+
+    updateDerived(index);
+    return id;
+}
+
+void RigidBodyStore::remove(BodyId id)
+{
+    if (!contains(id)) return;
+
+    uint32_t index = m_indexOf[id];
+    uint32_t last = static_cast<uint32_t>(m_ids.size() - 1);
+    BodyId island = sleepIsland[index];
+
+    forEachFloatArray([&](std::vector<float>& array) { swapRemove(array, index, last); });
+    swapRemove(colliderIndex, index, last);
+    swapRemove(state, index, last);
+    swapRemove(sleepIsland, index, last);
+
+    BodyId movedId = m_ids[last];
+    swapRemove(m_ids, index, last);
+    if (movedId != id) {
+        m_indexOf[movedId] = index;
+    }
+
+    m_indexOf[id] = INVALID_BODY;
+    m_freeIds.push_back(id);
+    m_removedIds.push_back(id);
+
+    //anything that was resting on it has to notice it is gone
+    if (island != INVALID_BODY) {
+        for (uint32_t i = 0; i < m_ids.size(); i++) {
+            if (sleepIsland[i] == island) wakeIndex(i);
+        }
+    }
+}
+
+void RigidBodyStore::clear()
+{
+    forEachFloatArray([](std::vector<float>& array) { array.clear(); });
+    colliderIndex.clear();
+    state.clear();
+    sleepIsland.clear();
+
+    m_removedIds.insert(m_removedIds.end(), m_ids.begin(), m_ids.end());
+    m_ids.clear();
+    m_indexOf.clear();
+    m_freeIds.clear();
+}
+
+void RigidBodyStore::reserve(size_t count)
+{
+    forEachFloatArray([count](std::vector<float>& array) { array.reserve(count); });
+    colliderIndex.reserve(count);
+    state.reserve(count);
+    sleepIsland.reserve(count);
+    m_ids.reserve(count);
+    m_indexOf.reserve(count);
+}
+
+glm::vec3 RigidBodyStore::getPosition(BodyId id) const
+{
+    uint32_t i = m_indexOf[id];
+    return glm::vec3(posX[i], posY[i], posZ[i]);
+}
+
+glm::vec3 RigidBodyStore::getVelocity(BodyId id) const
+{
+    uint32_t i = m_indexOf[id];
+    return glm::vec3(velX[i], velY[i], velZ[i]);
+}
+
+void RigidBodyStore::setVelocity(BodyId id, const glm::vec3& velocity)
+{
+    uint32_t i = m_indexOf[id];
+    velX[i] = velocity.x;
+    velY[i] = velocity.y;
+    velZ[i] = velocity.z;
+    wakeIndex(i);
+}
+
+void RigidBodyStore::applyImpulse(BodyId id, const glm::vec3& impulse)
+{
+    uint32_t i = m_indexOf[id];
+    if (inverseMass[i] == 0.0f) return;
+
+    velX[i] += impulse.x * inverseMass[i];
+    velY[i] += impulse.y * inverseMass[i];
+    velZ[i] += impulse.z * inverseMass[i];
+    wakeIndex(i);
+}
+
+void RigidBodyStore::applyImpulse(BodyId id, const glm::vec3& impulse, const glm::vec3& point)
+{
+    uint32_t i = m_indexOf[id];
+    if (inverseMass[i] == 0.0f) return;
+
+    applyImpulse(id, impulse);
+    glm::vec3 arm = point - glm::vec3(posX[i], posY[i], posZ[i]);
+    glm::vec3 spin = applyInvInertia(i, glm::cross(arm, impulse));
+    angVelX[i] += spin.x;
+    angVelY[i] += spin.y;
+    angVelZ[i] += spin.z;
+}
+
+glm::quat RigidBodyStore::getOrientation(BodyId id) const
+{
+    uint32_t i = m_indexOf[id];
+    return glm::quat(rotW[i], rotX[i], rotY[i], rotZ[i]);
+}
+
+void RigidBodyStore::setOrientation(BodyId id, const glm::quat& orientation)
+{
+    uint32_t i = m_indexOf[id];
+    if (m_colliders[colliderIndex[i]].type == ShapeType::AABB) return;
+
+    glm::quat q = glm::normalize(orientation);
+    rotW[i] = prevRotW[i] = q.w;
+    rotX[i] = prevRotX[i] = q.x;
+    rotY[i] = prevRotY[i] = q.y;
+    rotZ[i] = prevRotZ[i] = q.z;
+    updateDerived(i);
+    wakeIndex(i);
+}
+
+glm::vec3 RigidBodyStore::getAngularVelocity(BodyId id) const
+{
+    uint32_t i = m_indexOf[id];
+    return glm::vec3(angVelX[i], angVelY[i], angVelZ[i]);
+}
+
+void RigidBodyStore::setAngularVelocity(BodyId id, const glm::vec3& angularVelocity)
+{
+    uint32_t i = m_indexOf[id];
+    if (invInertiaX[i] == 0.0f) return;
+
+    angVelX[i] = angularVelocity.x;
+    angVelY[i] = angularVelocity.y;
+    angVelZ[i] = angularVelocity.z;
+    wakeIndex(i);
+}
+
+void RigidBodyStore::teleport(BodyId id, const glm::vec3& position)
+{
+    uint32_t i = m_indexOf[id];
+    posX[i] = prevX[i] = position.x;
+    posY[i] = prevY[i] = position.y;
+    posZ[i] = prevZ[i] = position.z;
+    wakeIndex(i);
+}
+
+void RigidBodyStore::wake(BodyId id)
+{
+    wakeIndex(m_indexOf[id]);
+}
+
+void RigidBodyStore::wakeIndex(uint32_t index)
+{
+    //sleepIsland is left alone on purpose, Physics sees an awake body that still has one and wakes
+    //the rest of that island too
+    state[index] = EquilibriumState::AWAKE;
+    sleepTimer[index] = 0.0f;
+}
+
+void RigidBodyStore::wakeAll()
+{
+    std::fill(state.begin(), state.end(), EquilibriumState::AWAKE);
+    std::fill(sleepTimer.begin(), sleepTimer.end(), 0.0f);
+    std::fill(sleepIsland.begin(), sleepIsland.end(), INVALID_BODY);
+}
+
+void RigidBodyStore::storePrevious()
+{
+    std::copy(posX.begin(), posX.end(), prevX.begin());
+    std::copy(posY.begin(), posY.end(), prevY.begin());
+    std::copy(posZ.begin(), posZ.end(), prevZ.begin());
+    std::copy(rotW.begin(), rotW.end(), prevRotW.begin());
+    std::copy(rotX.begin(), rotX.end(), prevRotX.begin());
+    std::copy(rotY.begin(), rotY.end(), prevRotY.begin());
+    std::copy(rotZ.begin(), rotZ.end(), prevRotZ.begin());
+}
+
+glm::vec3 RigidBodyStore::getInterpolatedPosition(BodyId id, float alpha) const
+{
+    uint32_t i = m_indexOf[id];
+    glm::vec3 previous(prevX[i], prevY[i], prevZ[i]);
+    glm::vec3 current(posX[i], posY[i], posZ[i]);
+    return glm::mix(previous, current, alpha);
+}
+
+glm::quat RigidBodyStore::getInterpolatedOrientation(BodyId id, float alpha) const
+{
+    uint32_t i = m_indexOf[id];
+    glm::quat previous(prevRotW[i], prevRotX[i], prevRotY[i], prevRotZ[i]);
+    glm::quat current(rotW[i], rotX[i], rotY[i], rotZ[i]);
+    return glm::slerp(previous, current, alpha);
+}
+
+glm::mat3 RigidBodyStore::rotationAt(uint32_t index) const
+{
+    return glm::mat3_cast(glm::quat(rotW[index], rotX[index], rotY[index], rotZ[index]));
+}
+
+void RigidBodyStore::updateDerived(uint32_t i)
+{
+    //same math as the integrateAngular kernels, written out so the two agree
+    float w = rotW[i], x = rotX[i], y = rotY[i], z = rotZ[i];
+    float r00 = 1.0f - 2.0f * (y * y + z * z), r01 = 2.0f * (x * y - w * z), r02 = 2.0f * (x * z + w * y);
+    float r10 = 2.0f * (x * y + w * z), r11 = 1.0f - 2.0f * (x * x + z * z), r12 = 2.0f * (y * z - w * x);
+    float r20 = 2.0f * (x * z - w * y), r21 = 2.0f * (y * z + w * x), r22 = 1.0f - 2.0f * (x * x + y * y);
+
+    //R diag(l) R^T
+    float lx = invInertiaX[i], ly = invInertiaY[i], lz = invInertiaZ[i];
+    invInertiaXX[i] = r00 * r00 * lx + r01 * r01 * ly + r02 * r02 * lz;
+    invInertiaXY[i] = r00 * r10 * lx + r01 * r11 * ly + r02 * r12 * lz;
+    invInertiaXZ[i] = r00 * r20 * lx + r01 * r21 * ly + r02 * r22 * lz;
+    invInertiaYY[i] = r10 * r10 * lx + r11 * r11 * ly + r12 * r12 * lz;
+    invInertiaYZ[i] = r10 * r20 * lx + r11 * r21 * ly + r12 * r22 * lz;
+    invInertiaZZ[i] = r20 * r20 * lx + r21 * r21 * ly + r22 * r22 * lz;
+
+    float hx = halfX[i], hy = halfY[i], hz = halfZ[i];
+    extentX[i] = radius[i] + (std::fabs(r00) * hx + std::fabs(r01) * hy + std::fabs(r02) * hz);
+    extentY[i] = radius[i] + (std::fabs(r10) * hx + std::fabs(r11) * hy + std::fabs(r12) * hz);
+    extentZ[i] = radius[i] + (std::fabs(r20) * hx + std::fabs(r21) * hy + std::fabs(r22) * hz);
+}
+
+void RigidBodyStore::clearVelocities()
+{
+    std::fill(velX.begin(), velX.end(), 0.0f);
+    std::fill(velY.begin(), velY.end(), 0.0f);
+    std::fill(velZ.begin(), velZ.end(), 0.0f);
+    std::fill(angVelX.begin(), angVelX.end(), 0.0f);
+    std::fill(angVelY.begin(), angVelY.end(), 0.0f);
+    std::fill(angVelZ.begin(), angVelZ.end(), 0.0f);
+}
+
+void RigidBodyStore::hashState(StateHasher& hasher) const
+{
+    hasher.add(m_ids);
+    hasher.add(posX); hasher.add(posY); hasher.add(posZ);
+    hasher.add(rotW); hasher.add(rotX); hasher.add(rotY); hasher.add(rotZ);
+    hasher.add(velX); hasher.add(velY); hasher.add(velZ);
+    hasher.add(angVelX); hasher.add(angVelY); hasher.add(angVelZ);
+    hasher.add(forceX); hasher.add(forceY); hasher.add(forceZ);
+    hasher.add(torqueX); hasher.add(torqueY); hasher.add(torqueZ);
+    hasher.add(inverseMass);
+    hasher.add(invInertiaX); hasher.add(invInertiaY); hasher.add(invInertiaZ);
+    hasher.add(sleepTimer);
+    hasher.add(colliderIndex);
+    for (EquilibriumState s : state) hasher.add(static_cast<uint32_t>(s));
+    hasher.add(sleepIsland);
+    hasher.add(radius);
+    hasher.add(halfX); hasher.add(halfY); hasher.add(halfZ);
+}
+
+void RigidBodyStore::clearForces()
+{
+    std::fill(forceX.begin(), forceX.end(), 0.0f);
+    std::fill(forceY.begin(), forceY.end(), 0.0f);
+    std::fill(forceZ.begin(), forceZ.end(), 0.0f);
+    std::fill(torqueX.begin(), torqueX.end(), 0.0f);
+    std::fill(torqueY.begin(), torqueY.end(), 0.0f);
+    std::fill(torqueZ.begin(), torqueZ.end(), 0.0f);
+}
@@ -13,14 +13,16 @@ float cleanFloat(float value) {
     return value;
 }
 
-GlowingOrb Serializer::loadState(const std::string& filePath) {
-    GlowingOrb orb;
+SavedState Serializer::loadState(const std::string& filePath, StringTable& strings) {
+    SavedState saved;
+    GlowingOrb& orb = saved.orb;
+    saved.info.id = strings.intern("entity_01");
+    saved.info.state = strings.intern("active");
     std::ifstream f(filePath);
-    orb.init();
 
     if (!f.is_open()) {
         std::cout << "INFO: No '" << filePath << "' found. Starting new simulation." << std::endl;
-        return orb;
+        return saved;
     }
 
     try {
@@ -28,7 +30,7 @@ GlowingOrb Serializer::loadState(const std::string& filePath) {
         f >> j;
         f.close();
 
-        orb.id = j.at("id").get<std::string>();
+        StringId id = strings.intern(j.at("id").get<std::string>());
 
         json pos_j = j.at("position");
         orb.position = glm::vec3(pos_j[0].get<float>(), pos_j[1].get<float>(), pos_j[2].get<float>());
@@ -37,9 +39,14 @@ GlowingOrb Serializer::loadState(const std::string& filePath) {
         orb.velocity = glm::vec3(vel_j[0].get<float>(), vel_j[1].get<float>(), vel_j[2].get<float>());
 
         orb.energy = j.at("energy").get<float>();
-        orb.state = j.at("state").get<std::string>();
+        StringId state = strings.intern(j.at("state").get<std::string>());
 
-        orb.isGravityOn = j.at("isGravityOn").get<bool>();
+        bool isGravityOn = j.at("isGravityOn").get<bool>();
+
+        //only take any of it once the whole file parsed
+        saved.info.id = id;
+        saved.info.state = state;
+        saved.isGravityOn = isGravityOn;
 
         std::cout << "SUCCESS: Loaded previous state from '" << filePath << "'." << std::endl;
 
@@ -47,11 +54,26 @@ GlowingOrb Serializer::loadState(const std::string& filePath) {
     catch (json::exception& e) {
         std::cerr << "ERROR: Failed to parse '" << filePath << "'. " << e.what() << std::endl;
         std::cerr << "Starting new simulation with default values." << std::endl;
+        saved.orb = GlowingOrb();
     }
-    return orb;
+    return saved;
 }
 
-void Serializer::saveState(const GlowingOrb& orb, const std::string& filePath) {
+void Serializer::saveState(Registry& registry, const StringTable& strings, bool isGravityOn, const std::string& filePath) {
+    const GlowingOrb* found = nullptr;
+    const EntityInfo* foundInfo = nullptr;
+    registry.each<GlowingOrb, EntityInfo>([&](Entity, GlowingOrb& orb, EntityInfo& info) {
+        if (!found) {
+            found = &orb;
+            foundInfo = &info;
+        }
+    });
+    if (!found) {
+        std::cerr << "ERROR: No orb to save to " << filePath << std::endl;
+        return;
+    }
+    const GlowingOrb& orb = *found;
+
     json j;
 
 
@@ -71,12 +93,12 @@ void Serializer::saveState(const GlowingOrb& orb, const std::string& filePath) {
     glm::vec3 savedPosition = orb.position;
 
 
-    j["id"] = orb.id;
+    j["id"] = strings.lookup(foundInfo->id);
     j["position"] = { cleanPosition.x, cleanPosition.y, cleanPosition.z }; 
     j["velocity"] = { cleanVelocity.x, cleanVelocity.y, cleanVelocity.z }; 
     j["energy"] = orb.energy;
-    j["state"] = orb.state;
-    j["isGravityOn"] = orb.isGravityOn;
+    j["state"] = strings.lookup(foundInfo->state);
+    j["isGravityOn"] = isGravityOn;
 
     try {
         std::ofstream o(filePath);
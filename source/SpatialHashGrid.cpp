@@ -0,0 +1,154 @@
+#include "Determinism.h"
+#include "SpatialHashGrid.h"
+#include <algorithm>
+#include <cmath>
+
+
+SpatialHashGrid::SpatialHashGrid(float cellSize)
+    : m_cellSize(cellSize), m_inverseCellSize(1.0f / cellSize) {}
+
+void SpatialHashGrid::setCellSize(float cellSize)
+{
+    m_cellSize = cellSize;
+    m_inverseCellSize = 1.0f / cellSize;
+    clear();
+}
+
+void SpatialHashGrid::clear()
+{
+    m_cells.clear();
+    m_entries.clear();
+}
+
+glm::ivec3 SpatialHashGrid::cellOf(const glm::vec3& point) const
+{
+    return glm::ivec3(glm::floor(point * m_inverseCellSize));
+}
+
+uint64_t SpatialHashGrid::cellKey(int x, int y, int z)
+{
+    //21 bits per axis, +-1M cells in every direction before keys wrap around
+    const uint64_t mask = 0x1FFFFF;
+    return ((uint64_t(x) & mask) << 42) | ((uint64_t(y) & mask) << 21) | (uint64_t(z) & mask);
+}
+
+void SpatialHashGrid::insert(BodyId id, const BodyEntry& entry)
+{
+    for (int x = entry.minCell.x; x <= entry.maxCell.x; x++)
+        for (int y = entry.minCell.y; y <= entry.maxCell.y; y++)
+            for (int z = entry.minCell.z; z <= entry.maxCell.z; z++) {
+                Cell& cell = m_cells[cellKey(x, y, z)];
+                cell.coord = glm::ivec3(x, y, z);
+                cell.bodies.push_back(id);
+            }
+}
+
+void SpatialHashGrid::erase(BodyId id, const BodyEntry& entry)
+{
+    for (int x = entry.minCell.x; x <= entry.maxCell.x; x++)
+        for (int y = entry.minCell.y; y <= entry.maxCell.y; y++)
+            for (int z = entry.minCell.z; z <= entry.maxCell.z; z++) {
+                auto it = m_cells.find(cellKey(x, y, z));
+                if (it == m_cells.end()) continue;
+
+                std::vector<BodyId>& list = it->second.bodies;
+                auto found = std::find(list.begin(), list.end(), id);
+                if (found != list.end()) {
+                    *found = list.back();
+                    list.pop_back();
+                }
+                //drop empty cells so the map only ever holds occupied space
+                if (list.empty()) m_cells.erase(it);
+            }
+}
+
+void SpatialHashGrid::update(const RigidBodyStore& bodies)
+{
+    //bodies removed from the store since last time
+    for (BodyId id = 0; id < m_entries.size(); id++) {
+        if (m_entries[id].inGrid && !bodies.contains(id)) {
+            erase(id, m_entries[id]);
+            m_entries[id].inGrid = false;
+        }
+    }
+
+    const size_t count = bodies.size();
+    for (uint32_t i = 0; i < count; i++) {
+        BodyId id = bodies.idAt(i);
+        if (id >= m_entries.size()) m_entries.resize(id + 1);
+
+        //sleeping bodies still get their bounds refreshed, the solver can nudge a body in the same step
+        //it falls asleep and findPairsInCell reads these. they almost never change cells though
+        AABB bounds = bodyBounds(bodies, i);
+
+        BodyEntry& entry = m_entries[id];
+        entry.lower = bounds.lower;
+        entry.upper = bounds.upper;
+
+        glm::ivec3 minCell = cellOf(entry.lower);
+        glm::ivec3 maxCell = cellOf(entry.upper);
+
+        //only bodies that crossed into different cells touch the cell lists
+        if (entry.inGrid && minCell == entry.minCell && maxCell == entry.maxCell) continue;
+
+        if (entry.inGrid) erase(id, entry);
+        entry.minCell = minCell;
+        entry.maxCell = maxCell;
+        entry.inGrid = true;
+        insert(id, entry);
+    }
+}
+
+void SpatialHashGrid::findPairsInCell(const RigidBodyStore& bodies, const Cell& cell, std::vector<BodyPair>& out) const
+{
+    const std::vector<BodyId>& list = cell.bodies;
+
+    for (size_t i = 0; i < list.size(); i++) {
+        const BodyEntry& a = m_entries[list[i]];
+
+        for (size_t j = i + 1; j < list.size(); j++) {
+            const BodyEntry& b = m_entries[list[j]];
+
+            //two bodies can share several cells, only the first shared cell reports them
+            glm::ivec3 firstShared = glm::max(a.minCell, b.minCell);
+            if (firstShared != cell.coord) continue;
+
+            if (a.upper.x < b.lower.x || b.upper.x < a.lower.x ||
+                a.upper.y < b.lower.y || b.upper.y < a.lower.y ||
+                a.upper.z < b.lower.z || b.upper.z < a.lower.z) continue;
+
+            //static or sleeping on both sides never needs resolving
+            if (!bodies.isActive(bodies.indexOf(list[i])) && !bodies.isActive(bodies.indexOf(list[j]))) continue;
+
+            BodyId idA = std::min(list[i], list[j]);
+            BodyId idB = std::max(list[i], list[j]);
+            out.push_back({ idA, idB });
+        }
+    }
+}
+
+void SpatialHashGrid::findPairs(const RigidBodyStore& bodies, std::vector<BodyPair>& out, JobSystem* jobs) const
+{
+    out.clear();
+
+    m_cellList.clear();
+    for (const auto& item : m_cells) {
+        //a lone body has nobody to pair with
+        if (item.second.bodies.size() > 1) m_cellList.push_back(&item.second);
+    }
+
+    const size_t grain = 256;
+    m_rangePairs.resize(rangeCount(m_cellList.size(), grain));
+    for (auto& range : m_rangePairs) range.clear();
+
+    parallelFor(jobs, m_cellList.size(), grain, [&](size_t begin, size_t end) {
+        std::vector<BodyPair>& rangeOut = m_rangePairs[begin / grain];
+        for (size_t c = begin; c < end; c++) {
+            findPairsInCell(bodies, *m_cellList[c], rangeOut);
+        }
+    });
+
+    for (const auto& range : m_rangePairs) {
+        out.insert(out.end(), range.begin(), range.end());
+    }
+}
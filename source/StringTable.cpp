@@ -0,0 +1,44 @@
+#include "StringTable.h"
+#include <cassert>
+
+
+StringTable::StringTable()
+{
+    intern("");
+}
+
+StringId StringTable::intern(std::string_view text)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_ids.find(text);
+    if (it != m_ids.end()) return it->second;
+
+    StringId id = static_cast<StringId>(m_strings.size());
+    m_strings.emplace_back(text);
+    m_ids.emplace(std::string_view(m_strings.back()), id);
+    return id;
+}
+
+bool StringTable::find(std::string_view text, StringId& id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_ids.find(text);
+    if (it == m_ids.end()) return false;
+    id = it->second;
+    return true;
+}
+
+const std::string& StringTable::lookup(StringId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    assert(id < m_strings.size());
+    return m_strings[id];
+}
+
+size_t StringTable::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_strings.size();
+}
@@ -0,0 +1,117 @@
+#include "SystemScheduler.h"
+#include <cassert>
+#include <thread>
+
+
+uint32_t SystemAccess::registerKey()
+{
+    static std::atomic<uint32_t> counter{ 0 };
+    uint32_t id = counter.fetch_add(1, std::memory_order_relaxed);
+    assert(id < 64);
+    return id;
+}
+
+
+SystemScheduler::SystemBuilder SystemScheduler::add(const char* name, SystemFunction function)
+{
+    System system;
+    system.name = name;
+    system.function = std::move(function);
+    m_systems.push_back(std::move(system));
+    m_dirty = true;
+    return SystemBuilder(*this, static_cast<uint32_t>(m_systems.size() - 1));
+}
+
+std::vector<uint32_t> SystemScheduler::getDependencies(uint32_t system)
+{
+    if (m_dirty) buildGraph();
+
+    std::vector<uint32_t> dependencies;
+    for (uint32_t i = 0; i < system; i++) {
+        for (uint32_t dependent : m_systems[i].dependents) {
+            if (dependent == system) dependencies.push_back(i);
+        }
+    }
+    return dependencies;
+}
+
+void SystemScheduler::buildGraph()
+{
+    //edges only ever point from an earlier system to a later one, so the graph can't have cycles and
+    //add order is always a valid order to run it in
+    for (System& system : m_systems) {
+        system.dependents.clear();
+        system.dependencyCount = 0;
+    }
+
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        for (uint32_t j = i + 1; j < m_systems.size(); j++) {
+            const System& first = m_systems[i];
+            const System& second = m_systems[j];
+            bool conflict = (first.writes & (second.reads | second.writes)) || (first.reads & second.writes);
+            if (!conflict) continue;
+
+            m_systems[i].dependents.push_back(j);
+            m_systems[j].dependencyCount++;
+        }
+    }
+
+    m_remaining = std::make_unique<std::atomic<int>[]>(m_systems.size());
+    m_dirty = false;
+}
+
+void SystemScheduler::run(JobSystem* jobs)
+{
+    if (m_dirty) buildGraph();
+
+    if (!jobs || jobs->getThreadCount() <= 1) {
+        for (System& system : m_systems) system.function();
+        return;
+    }
+
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        m_remaining[i].store(m_systems[i].dependencyCount, std::memory_order_relaxed);
+    }
+    m_finished.store(0, std::memory_order_relaxed);
+
+    JobSystem::Counter counter;
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        if (m_systems[i].dependencyCount == 0) dispatch(i, *jobs, counter);
+    }
+
+    //the calling thread picks up main thread systems as they become ready and helps with the rest
+    while (m_finished.load(std::memory_order_acquire) < m_systems.size()) {
+        uint32_t ready = UINT32_MAX;
+        {
+            std::lock_guard<std::mutex> lock(m_mainMutex);
+            if (!m_mainReady.empty()) {
+                ready = m_mainReady.back();
+                m_mainReady.pop_back();
+            }
+        }
+
+        if (ready != UINT32_MAX) execute(ready, *jobs, counter);
+        else if (!jobs->tryRunOne()) std::this_thread::yield();
+    }
+    jobs->wait(counter);
+}
+
+void SystemScheduler::dispatch(uint32_t system, JobSystem& jobs, JobSystem::Counter& counter)
+{
+    if (m_systems[system].mainThread) {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        m_mainReady.push_back(system);
+        return;
+    }
+    jobs.run(counter, [this, system, &jobs, &counter]() { execute(system, jobs, counter); });
+}
+
+void SystemScheduler::execute(uint32_t system, JobSystem& jobs, JobSystem::Counter& counter)
+{
+    m_systems[system].function();
+
+    for (uint32_t dependent : m_systems[system].dependents) {
+        if (m_remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) dispatch(dependent, jobs, counter);
+    }
+    m_finished.fetch_add(1, std::memory_order_release);
+}
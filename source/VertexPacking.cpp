@@ -0,0 +1,84 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <glm/gtc/packing.hpp>
+
+
+namespace {
+    const float SNORM16_MAX = 32767.0f;
+    const float UNORM16_MAX = 65535.0f;
+
+    float signNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    //unit vector onto the octahedron, then the lower half folded out over the corners of the square
+    glm::vec2 octahedralEncode(const glm::vec3& normal)
+    {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.0f) return glm::vec2(0.0f); //missing normals stay missing (decode to +z)
+
+        glm::vec3 n = normal / sum;
+        if (n.z >= 0.0f) return glm::vec2(n.x, n.y);
+        return glm::vec2((1.0f - std::abs(n.y)) * signNotZero(n.x), (1.0f - std::abs(n.x)) * signNotZero(n.y));
+    }
+
+    //the same as octDecode in the vertex shaders
+    glm::vec3 octahedralDecode(const glm::vec2& encoded)
+    {
+        glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+}
+
+
+const VertexAttribute* packedVertexLayout()
+{
+    static const VertexAttribute layout[PACKED_ATTRIBUTE_COUNT] = {
+        { 0, 3, AttributeType::UINT16, 1, static_cast<uint32_t>(offsetof(PackedVertex, position)) },
+        { 1, 2, AttributeType::FLOAT16, 0, static_cast<uint32_t>(offsetof(PackedVertex, texCoord)) },
+        { 2, 2, AttributeType::INT16, 0, static_cast<uint32_t>(offsetof(PackedVertex, normal)) },
+    };
+    return layout;
+}
+
+PackedVertex packVertex(const Primitives::Vertex& vertex, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    PackedVertex packed{};
+
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (int axis = 0; axis < 3; axis++) {
+        //a flat axis (the plane's y) has nothing to encode, it decodes to boundsMin
+        float t = extent[axis] > 0.0f ? (vertex.position[axis] - boundsMin[axis]) / extent[axis] : 0.0f;
+        packed.position[axis] = static_cast<uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * UNORM16_MAX));
+    }
+
+    packed.texCoord[0] = static_cast<uint16_t>(glm::packHalf1x16(vertex.texCoord.x));
+    packed.texCoord[1] = static_cast<uint16_t>(glm::packHalf1x16(vertex.texCoord.y));
+
+    glm::vec2 octahedral = octahedralEncode(vertex.normal);
+    packed.normal[0] = static_cast<int16_t>(std::lround(std::clamp(octahedral.x, -1.0f, 1.0f) * SNORM16_MAX));
+    packed.normal[1] = static_cast<int16_t>(std::lround(std::clamp(octahedral.y, -1.0f, 1.0f) * SNORM16_MAX));
+    return packed;
+}
+
+Primitives::Vertex unpackVertex(const PackedVertex& packed, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    Primitives::Vertex vertex;
+    glm::vec3 unorm(packed.position[0], packed.position[1], packed.position[2]);
+    vertex.position = boundsMin + unorm / UNORM16_MAX * (boundsMax - boundsMin);
+    vertex.texCoord = glm::vec2(glm::unpackHalf1x16(packed.texCoord[0]), glm::unpackHalf1x16(packed.texCoord[1]));
+    vertex.normal = octahedralDecode(glm::clamp(glm::vec2(packed.normal[0], packed.normal[1]) / SNORM16_MAX, -1.0f, 1.0f));
+    return vertex;
+}
+
+void packVertices(const MeshData& mesh, std::vector<PackedVertex>& out)
+{
+    out.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) out[i] = packVertex(mesh.vertices[i], mesh.boundsMin, mesh.boundsMax);
+}